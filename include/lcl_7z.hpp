@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Extracts a 7z archive in-process. The header (compressed or not) is read once, then every
+// folder (a solid block) is decoded on a pool of threads, so archives made without solid mode
+// unpack in parallel. LZMA, LZMA2, Delta and the branch filters go through liblzma, Deflate
+// through zlib and BCJ2 is decoded here. Files are checked against their CRC-32 and written
+// straight to their final path, flattened like lcl_zip_extractor does it.
+// Encrypted archives and PPMd/BZip2 folders fail the extraction.
+class lcl_7z_extractor {
+public:
+	lcl_7z_extractor(std::filesystem::path archive, std::filesystem::path target);
+
+	bool run();
+
+	const std::string& error() const { return _error; }
+
+private:
+	static constexpr unsigned MAX_THREADS = 8;
+	static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+	struct _coder {
+		std::vector<unsigned char> method;
+		std::vector<unsigned char> properties;
+		uint64_t in_streams;
+		uint64_t out_streams;
+	};
+
+	struct _folder {
+		std::vector<_coder> coders;
+		std::vector<std::pair<uint64_t, uint64_t>> bind_pairs;
+		std::vector<uint64_t> packed_streams;
+		std::vector<uint64_t> pack_offsets;
+		std::vector<uint64_t> pack_sizes;
+		std::vector<uint64_t> unpack_sizes;
+		bool crc_defined;
+		uint32_t crc;
+		uint64_t substreams;
+		std::vector<size_t> files;
+	};
+
+	struct _file {
+		std::string name;
+		std::filesystem::path path;
+		std::string link_target;
+		uint64_t size;
+		uint32_t crc;
+		bool crc_defined;
+		bool has_stream;
+		bool directory;
+		uint32_t mode;
+	};
+
+	struct _reader;
+	struct _streams;
+	struct _decoder;
+
+	bool read_archive(std::ifstream& in);
+	bool read_streams_info(_reader& reader, _streams& streams);
+	bool place_pack_streams(_streams& streams, uint64_t archive_size);
+	bool read_folder(_reader& reader, _folder& folder);
+	bool read_files_info(_reader& reader, _streams& streams);
+	bool decode_to_memory(std::ifstream& in, const _folder& folder, std::vector<char>& output);
+	bool extract_folder(std::ifstream& in, const _folder& folder);
+	bool plan();
+	bool fail(std::string error);
+
+	std::filesystem::path _archive;
+	std::filesystem::path _target;
+	std::vector<_folder> _folders;
+	std::vector<_file> _files;
+	std::atomic<bool> _failed;
+	std::atomic<uint64_t> _extracted_files;
+	std::atomic<uint64_t> _bytes;
+	std::mutex _error_lock;
+	std::string _error;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "lcl_lock.hpp"
+
+// Archive cache shared by every core, in system/LCL.cache. Archives are stored as
+// <root>/<sha256> with an index.json holding size and last use of each one, the download
+// urls they were fetched from and the hit/miss counters. Assets without a published
+// digest are hashed when stored and found again through their url.
+// Once the total size passes the cap the least recently used archives are evicted.
+// Every core updates the index, each read, change and write of it holds <root>/.lock.
+class lcl_archive_cache {
+public:
+	lcl_archive_cache(std::filesystem::path root, unsigned long long max_bytes);
+
+	bool enabled() const { return _max_bytes > 0; }
+
+	// Puts a verified copy at target (hard link when possible) and counts a hit, or counts a miss.
+	bool fetch(const std::string& digest, const std::string& url, const std::filesystem::path& target);
+
+	// Adds an archive that was just downloaded, file itself stays where it is.
+	bool store(const std::filesystem::path& file, const std::string& digest, const std::string& url);
+
+private:
+	static constexpr std::chrono::seconds LOCK_WAIT{ 60 };
+
+	bool lock(lcl_file_lock& lock);
+	bool load();
+	void adopt_objects();
+	bool save();
+	void evict(const std::string& keep);
+	std::string lookup(const std::string& digest, const std::string& url) const;
+	void forget(const std::string& hash);
+
+	std::filesystem::path _root;
+	std::filesystem::path _index_path;
+	unsigned long long _max_bytes;
+	nlohmann::json _index;
+};
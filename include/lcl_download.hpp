@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "curl/curl.h"
+#include "lcl_net.hpp"
+#include "lcl_sha256.hpp"
+
+struct lcl_download_options {
+	int segments = 1;
+	int retries = 5;
+	long low_speed_limit = 1024;  // bytes per second
+	long low_speed_time = 30;     // seconds below the limit before the transfer counts as stalled
+};
+
+// Connect timeout, stall detection and cancellation, shared by every asset transfer.
+void lcl_apply_transfer_limits(CURL* curl, const lcl_download_options& options, const std::atomic<bool>& cancel);
+
+// fseek for offsets past 2 GiB.
+bool lcl_seek_file(FILE* file, uint64_t offset);
+
+// Fetches byte ranges of one remote file into the same offsets of a local one, one request per
+// range over the caller's curl handle. Only a 206 answer carrying exactly the range asked for is
+// written, a server ignoring Range fails the request instead of sending the whole file. Later
+// requests go straight to the url the first one was redirected to.
+class lcl_range_fetcher {
+public:
+	lcl_range_fetcher(std::string url, FILE* file, const lcl_download_options& options, const std::atomic<bool>& cancel);
+
+	// Answers for a file of another size are refused. Unknown until set here or by fetch_tail().
+	void expect_size(uint64_t size);
+
+	// Bytes [first, last).
+	bool fetch(CURL* curl, CURLcode& res, uint64_t first, uint64_t last);
+
+	// The last size bytes, or all of a smaller file. Learns the file size, first is where the tail starts.
+	bool fetch_tail(CURL* curl, CURLcode& res, uint64_t size, uint64_t& first);
+
+	uint64_t total_size() const { return _total_size; }
+	uint64_t received() const { return _received; }
+	unsigned requests() const { return _requests; }
+
+private:
+	static size_t write_range(char* data, size_t size, size_t nmemb, void* userdata);
+
+	bool start_range();
+	bool request(CURL* curl, CURLcode& res, const std::string& range);
+
+	std::string _url;
+	FILE* _file;
+	lcl_download_options _options;
+	const std::atomic<bool>& _cancel;
+	CURL* _curl;
+	lcl_http_headers _headers;
+	bool _started;
+	uint64_t _first;
+	uint64_t _last;
+	uint64_t _position;
+	uint64_t _total_size;
+	uint64_t _received;
+	unsigned _requests;
+};
+
+// Resumable download of one asset.
+// Data goes to <target>.part and progress to <target>.part.json, the file is renamed to target
+// once complete. A "bytes=0-0" probe tells the size, the ETag and whether ranges work: with
+// ranges the file is preallocated and split in segments fetched over parallel connections
+// through one curl multi handle, each written at its offset. Stalled or failed transfers are
+// retried with exponential backoff and continue where they stopped, also across launches.
+// With an expected digest the bytes are hashed while they arrive, in file order, so the
+// check at the end only has to finish the last block.
+class lcl_downloader {
+public:
+	lcl_downloader(std::string url, std::string target, const lcl_download_options& options, const std::atomic<bool>& cancel);
+
+	// curl is used for the probe and single stream transfers and stays owned by the caller.
+	bool run(CURL* curl, CURLcode& res);
+
+	// "sha256:<hex>" as published by the host, anything else leaves verification off.
+	void expect_sha256(const std::string& digest);
+
+private:
+	static constexpr curl_off_t MIN_SEGMENT_SIZE = 4 * 1024 * 1024;
+	static constexpr int MAX_SEGMENTS = 16;
+
+	enum class _attempt {
+		DONE,
+		RETRY,
+		FATAL
+	};
+
+	struct _segment {
+		curl_off_t first = 0;
+		curl_off_t last = 0;
+		curl_off_t written = 0;
+		FILE* file = nullptr;
+		CURL* curl = nullptr;
+		struct curl_slist* headers = nullptr;
+		lcl_downloader* owner = nullptr;
+	};
+
+	static constexpr curl_off_t HASH_CATCH_UP = 16 * 1024 * 1024;
+
+	static size_t write_segment(char* data, size_t size, size_t nmemb, void* userdata);
+	static size_t write_single(char* data, size_t size, size_t nmemb, void* userdata);
+
+	_attempt probe(CURL* curl, CURLcode& res);
+	_attempt download_segments(CURLcode& res);
+	_attempt download_single(CURL* curl, CURLcode& res);
+	void apply_limits(CURL* curl);
+	void plan_segments();
+	bool preallocate();
+	bool start_segment(_segment& segment);
+	void close_segment(_segment& segment);
+	bool load_progress();
+	void save_progress();
+	void discard_progress();
+	bool wait_backoff(int attempt);
+	void reset_hash();
+	bool hash_from_disk(curl_off_t until);
+	void advance_hash(curl_off_t budget);
+	bool verify();
+
+	std::string _url;
+	std::string _target;
+	std::string _part_path;
+	std::string _meta_path;
+	std::string _effective_url;
+	std::string _etag;
+	lcl_download_options _options;
+	const std::atomic<bool>& _cancel;
+	curl_off_t _total_size;
+	bool _ranges;
+	std::vector<_segment> _parts;
+
+	// Everything before _hashed has gone through _hash.
+	std::string _expected_sha256;
+	lcl_sha256 _hash;
+	curl_off_t _hashed;
+	FILE* _output;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "curl/curl.h"
+#include "lcl_download.hpp"
+#include "lcl_sha256.hpp"
+
+// Bounded byte queue between one writer (the download) and one reader (the extractor).
+// The writer blocks while it is full, so memory use stays fixed whatever the archive size.
+class lcl_ring_buffer {
+public:
+	explicit lcl_ring_buffer(size_t capacity);
+
+	// False once the reader gave up.
+	bool write(const char* data, size_t size);
+
+	// Blocks until data is available, 0 at the end of the stream or after abort().
+	size_t read(char* data, size_t size);
+
+	// Writer side: no more data will come.
+	void close();
+
+	// Reader side: failed, the writer is told to stop.
+	void abort();
+
+	// Reader side: done early, whatever the writer still sends is dropped.
+	void drain();
+
+private:
+	std::vector<char> _data;
+	size_t _head;
+	size_t _size;
+	bool _closed;
+	bool _aborted;
+	bool _draining;
+	std::mutex _lock;
+	std::condition_variable _readable;
+	std::condition_variable _writable;
+};
+
+// Extracts a ZIP archive read front to back, from the local file headers alone, so it can run
+// while the archive is still downloading. Entries are inflated with zlib and checked against
+// their CRC-32. Encrypted entries, methods other than store/deflate and non-empty stored
+// entries with a trailing data descriptor can't be streamed and fail the extraction.
+// Unix modes and symlinks are only in the central directory, they are applied once it arrived.
+class lcl_zip_stream {
+public:
+	lcl_zip_stream(lcl_ring_buffer& input, std::filesystem::path destination);
+
+	bool run();
+
+	const std::string& error() const { return _error; }
+	uint64_t files() const { return _files; }
+	uint64_t bytes() const { return _bytes; }
+
+private:
+	static constexpr size_t BUFFER_SIZE = 256 * 1024;
+
+	bool fill();
+	bool ensure(size_t size);
+	bool read_exact(void* data, size_t size);
+	bool skip(uint64_t size);
+	bool extract_entry();
+	bool read_central_entry();
+	bool apply_attributes();
+	bool fail(std::string error);
+
+	lcl_ring_buffer& _input;
+	std::filesystem::path _destination;
+	std::vector<char> _buffer;
+	std::vector<char> _output;
+	size_t _pos;
+	size_t _end;
+	uint64_t _files;
+	uint64_t _bytes;
+	std::vector<std::pair<std::filesystem::path, uint32_t>> _modes;  // relative path, unix mode
+	std::string _error;
+};
+
+// Downloads a ZIP archive straight into lcl_zip_stream, the archive itself never touches the disk.
+// One connection without resume: on any failure the destination is removed and the caller
+// falls back to lcl_downloader and the regular extractor.
+class lcl_stream_installer {
+public:
+	lcl_stream_installer(std::string url, std::filesystem::path destination, const lcl_download_options& options, const std::atomic<bool>& cancel);
+
+	// "sha256:<hex>", checked once the last byte arrived.
+	void expect_sha256(const std::string& digest);
+
+	// Also writes the raw archive to path, for the archive cache. Removed again on failure.
+	void keep_copy(std::filesystem::path path);
+
+	// curl stays owned by the caller and is left reusable.
+	bool run(CURL* curl, CURLcode& res);
+
+private:
+	static constexpr size_t RING_SIZE = 8 * 1024 * 1024;
+
+	static size_t write_ring(char* data, size_t size, size_t nmemb, void* userdata);
+
+	std::string _url;
+	std::filesystem::path _destination;
+	lcl_download_options _options;
+	const std::atomic<bool>& _cancel;
+	std::string _expected_sha256;
+	lcl_sha256 _hash;
+	lcl_ring_buffer* _ring;
+	curl_off_t _received;
+	std::filesystem::path _copy_path;
+	FILE* _copy;
+	bool _copy_failed;
+};
+
+struct lcl_manifest_entry {
+	uint32_t crc;
+	uint64_t size;
+	long long written;
+};
+
+// Files an install put under its target, by generic path relative to it, with the CRC-32 and
+// size they had in the archive and the write time they got on disk.
+class lcl_install_manifest {
+public:
+	bool load(const std::filesystem::path& path);
+	bool save(const std::filesystem::path& path) const;
+
+	std::map<std::string, lcl_manifest_entry> files;
+};
+
+// Extracts a ZIP archive on disk in one pass over its central directory. Entries are spread
+// over a pool of threads, each inflating with libdeflate (zlib for entries too large to hold in
+// memory) and checking the CRC-32, and are written straight to their final path: a single top
+// level folder is flattened the way lcl_move_extracted() does it, without a temporary tree.
+class lcl_zip_extractor {
+public:
+	lcl_zip_extractor(std::filesystem::path archive, std::filesystem::path target);
+
+	// Update over an existing install: files whose content already matches the archive are left
+	// alone, files installed listed in installed but gone from the archive are deleted. A file
+	// still carrying the size and write time recorded for it is trusted, any other is read back
+	// and compared by CRC-32.
+	void delta(lcl_install_manifest installed);
+
+	// Reads the central directory and lays the entries out, run() does it unless done before.
+	bool prepare();
+
+	// File ranges [first, last) of the local records run() will read, every entry in delta mode
+	// that differs from the install. Each range runs up to the next record. Needs prepare().
+	std::vector<std::pair<uint64_t, uint64_t>> needed_ranges();
+
+	bool run();
+
+	const std::string& error() const { return _error; }
+
+	// What the archive installed, valid after run() succeeded.
+	const lcl_install_manifest& manifest() const { return _manifest; }
+
+private:
+	static constexpr unsigned MAX_THREADS = 8;
+	static constexpr uint64_t WHOLE_ENTRY_LIMIT = 16 * 1024 * 1024;
+	static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+	struct _entry {
+		std::string name;
+		std::filesystem::path path;
+		std::string key;
+		std::string link_target;
+		long long written;
+		uint64_t offset;
+		uint64_t compressed_size;
+		uint64_t size;
+		uint32_t crc;
+		uint16_t method;
+		uint32_t mode;
+		bool directory;
+		bool keep;
+	};
+
+	struct _worker;
+
+	bool read_central_directory(std::ifstream& in);
+	bool plan();
+	bool unchanged(_entry& entry, _worker& worker);
+	bool extract_entry(_entry& entry, _worker& worker);
+	bool extract_in_memory(_entry& entry, _worker& worker, bool link);
+	bool extract_streamed(const _entry& entry, _worker& worker);
+	void remove_stale();
+	bool fail(std::string error);
+
+	std::filesystem::path _archive;
+	std::filesystem::path _target;
+	std::vector<_entry> _entries;
+	uint64_t _directory_offset;
+	bool _prepared;
+	bool _compared;
+	bool _delta;
+	lcl_install_manifest _installed;
+	lcl_install_manifest _manifest;
+	std::atomic<bool> _failed;
+	std::atomic<uint64_t> _files;
+	std::atomic<uint64_t> _unchanged;
+	uint64_t _removed;
+	std::atomic<uint64_t> _bytes;
+	std::mutex _error_lock;
+	std::string _error;
+};
+
+// Updates an install from a remote ZIP without downloading all of it. The tail of the archive
+// comes first, then the central directory when it starts before the tail, then with HTTP
+// ranges only the local records of the entries that differ from the install. Everything lands at
+// its own offset in a sparse copy of the archive which lcl_zip_extractor unpacks in delta mode.
+// A server ignoring ranges fails the run before the target is touched, the caller then
+// downloads the whole archive.
+class lcl_partial_installer {
+public:
+	lcl_partial_installer(std::string url, std::filesystem::path archive, std::filesystem::path target,
+		const lcl_download_options& options, const std::atomic<bool>& cancel);
+
+	// curl stays owned by the caller and is left reusable. The sparse archive is removed either way.
+	bool run(CURL* curl, CURLcode& res, lcl_install_manifest installed);
+
+	// What the archive installed, valid after run() succeeded.
+	const lcl_install_manifest& manifest() const { return _manifest; }
+
+private:
+	// Holds the end record with the longest comment, and usually the whole central directory.
+	static constexpr uint64_t TAIL_SIZE = 256 * 1024;
+	// Changed records closer than this are fetched in one request, the gap costs less than a round trip.
+	static constexpr uint64_t MERGE_GAP = 256 * 1024;
+
+	bool fetch_directory(lcl_range_fetcher& fetcher, CURL* curl, CURLcode& res);
+	bool read_at(uint64_t position, void* data, size_t size);
+
+	std::string _url;
+	std::filesystem::path _archive;
+	std::filesystem::path _target;
+	lcl_download_options _options;
+	const std::atomic<bool>& _cancel;
+	lcl_install_manifest _manifest;
+	FILE* _file;
+	uint64_t _tail_first;
+};
+
+// Archive entry names are untrusted, only plain relative paths below the destination pass.
+bool lcl_safe_entry_path(std::string name, std::filesystem::path& relative);
+
+// Symlink targets are untrusted as well. link is the path of the link below the destination, the
+// target is resolved from its folder and passes while it stays below the destination:
+// "bin/foo -> ../lib/foo" does, "bin/foo -> ../../etc" does not. relative is the target to create.
+bool lcl_safe_link_target(std::string target, const std::filesystem::path& link, std::filesystem::path& relative);
+
+// True when a folder on the way from root to root/relative is a symlink on disk.
+bool lcl_passes_symlink(const std::filesystem::path& root, const std::filesystem::path& relative);
+
+// Creates the symlink of an archive entry at root/link, once every file of the archive is written.
+// Checked lexically first, then on disk: neither the link nor what it points to may lie behind
+// another symlink, a chain of links that each look fine could leave root once resolved.
+bool lcl_create_entry_link(const std::filesystem::path& root, const std::filesystem::path& link,
+	const std::string& target, std::string& error);
+
+// Final paths of archive entries under target, with the folders they need created. Names go
+// through lcl_safe_entry_path() and a single top level folder is dropped like lcl_move_extracted()
+// does, that folder's own entry gets an empty path.
+bool lcl_layout_entries(const std::vector<std::string>& names, const std::vector<bool>& directories,
+	const std::filesystem::path& target, std::vector<std::filesystem::path>& paths, std::string& error);
+
+// Moves an extracted tree into place the way the archive tools did it: a single top level folder
+// is flattened, existing files are overwritten and everything else in target is left alone.
+bool lcl_move_extracted(const std::filesystem::path& from, const std::filesystem::path& target, std::string& error);
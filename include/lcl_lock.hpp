@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+
+// Advisory exclusive lock on a file (flock / LockFileEx), held until release() or destruction.
+// The OS drops it when the process exits, so a crashed update never blocks the next launch.
+class lcl_file_lock {
+public:
+	lcl_file_lock() = default;
+	~lcl_file_lock();
+
+	lcl_file_lock(const lcl_file_lock&) = delete;
+	lcl_file_lock& operator=(const lcl_file_lock&) = delete;
+
+	// Waits up to wait for the lock, with a zero wait it is tried once.
+	bool acquire(const std::filesystem::path& path, std::chrono::milliseconds wait);
+	void release();
+	bool held() const;
+
+private:
+	bool try_acquire();
+
+#ifdef _WIN32
+	void* _handle = nullptr;
+#else
+	int _fd = -1;
+#endif
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// One upstream release feed served by the mirror, taken from a core section of LCL.cfg.
+struct lcl_mirror_source {
+	std::string section;
+	std::string api_url;
+	long long ttl = 3600;
+};
+
+// LAN caching mirror, run by one LCL install for a fleet of others.
+// Serves /<core>/release.json in the GitHub schema, with asset urls rewritten to point back at
+// the mirror, and /<core>/<asset id>/<name> from system/LCL.mirror/. Every upstream asset is
+// downloaded once, verified against the size announced by the release and then kept. Clients
+// use PROVIDER=index with API_URL=http://<mirror>:<port>/<core>/release.json.
+class lcl_mirror {
+public:
+	static lcl_mirror& instance();
+
+	bool start(const std::filesystem::path& root, const std::string& bind_address, int port,
+		const std::string& api_token, const std::vector<lcl_mirror_source>& sources);
+	void stop();
+
+private:
+	lcl_mirror();
+
+	struct _release {
+		std::mutex lock;
+		lcl_mirror_source source;
+		nlohmann::json document;
+		std::string etag;
+		long long checked_at = 0;
+	};
+
+	struct _asset_fetch {
+		std::mutex lock;
+		std::condition_variable done;
+		bool busy = false;
+	};
+
+	struct _request {
+		std::string method;
+		std::string path;
+		std::string host;
+		std::string range;
+		std::string if_none_match;
+	};
+
+	void accept_loop();
+	void handle_client(long long client);
+	void serve_release(long long client, const _request& request, _release& release);
+	void serve_asset(long long client, const _request& request, _release& release, const std::string& asset_id);
+	bool refresh_release(_release& release);
+	bool fetch_asset(const nlohmann::json& asset, const std::filesystem::path& target);
+	std::shared_ptr<_asset_fetch> asset_fetch_state(const std::string& key);
+
+	std::filesystem::path _root;
+	std::string _api_token;
+	std::map<std::string, std::unique_ptr<_release>> _releases;
+	std::map<std::string, std::shared_ptr<_asset_fetch>> _fetches;
+	std::mutex _fetches_lock;
+	std::mutex _clients_lock;
+	std::condition_variable _clients_done;
+	int _active_clients;
+	std::thread _accept_thread;
+	std::atomic<bool> _stopping;
+	long long _listener;
+	bool _running;
+};
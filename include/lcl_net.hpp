@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "curl/curl.h"
+
+// Response headers of the last transfer, names in lowercase.
+using lcl_http_headers = std::unordered_map<std::string, std::string>;
+
+// libcurl header callback filling a lcl_http_headers passed as CURLOPT_HEADERDATA.
+size_t lcl_header_callback(char* buffer, size_t size, size_t nitems, void* userdata);
+
+// Process wide network state shared by every curl handle of the core.
+// A curl share object keeps DNS results, TLS sessions and open connections across the
+// metadata and download handles, resolved addresses and TLS session tickets are
+// persisted under system/ so the next core load starts with a resumed handshake.
+class lcl_net {
+public:
+	static lcl_net& instance();
+
+	// Imports the persisted caches once per process, request timings are appended to stats_path.
+	void load(const std::filesystem::path& system_dir, const std::filesystem::path& stats_path, long long dns_ttl, bool verbose);
+	void save();
+	void cleanup();
+
+	// New easy handle attached to the share object.
+	CURL* easy();
+
+	// curl_easy_perform with the persisted addresses applied, retried once with a fresh
+	// lookup when a cached address does not answer. kind labels the request in the stats.
+	CURLcode perform(CURL* curl, const char* kind);
+
+	// Same bookkeeping as perform() for a transfer driven elsewhere, e.g. by a curl multi handle.
+	void finished(CURL* curl, const char* kind, CURLcode res);
+
+	// Sends a HEAD to url on a background thread, the caller picks one that costs no API quota.
+	// The address, the TLS session and the open connection are left in the share for the first
+	// real request to the same host to reuse.
+	void prewarm(const std::string& url);
+	void wait_prewarm();
+	void cancel_prewarm();
+
+	// GitHub rate limit bookkeeping per API resource ("core", "graphql"), shared by every core
+	// through system/LCL.RateLimit.json. allows() returns false while a request would only fail,
+	// wait_seconds then tells how long until the next attempt makes sense. A transfer that got
+	// no answer (http_code 0) leaves the state as it is.
+	bool rate_limit_allows(const std::string& resource, long long& wait_seconds);
+	void rate_limit_update(const std::string& resource, long http_code, const lcl_http_headers& headers);
+
+private:
+	lcl_net();
+	void init_share();
+
+	struct _dns_entry {
+		std::string address;
+		long long expires = 0;
+	};
+
+	struct _rate_limit {
+		long long remaining = -1;
+		long long reset = 0;
+		long long next_allowed = 0;
+		int failures = 0;
+	};
+
+	struct _tls_session {
+		std::string session_key;
+		std::string shmac;
+		std::string sdata;
+		long long valid_until = 0;
+	};
+
+	static void lock_callback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+	static void unlock_callback(CURL* handle, curl_lock_data data, void* userptr);
+	static int prewarm_progress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
+	static CURLcode export_callback(CURL* handle, void* userptr, const char* session_key,
+		const unsigned char* shmac, size_t shmac_len, const unsigned char* sdata, size_t sdata_len,
+		curl_off_t valid_until, int ietf_tls_id, const char* alpn, size_t earlydata_max);
+
+	void remember_address(CURL* curl);
+	void report(CURL* curl, const char* kind, CURLcode res);
+	void load_dns_cache();
+	void load_tls_sessions();
+	void save_dns_cache();
+	void save_tls_sessions();
+	void load_rate_limits();
+	void save_rate_limits();
+
+	CURLSH* _share;
+	std::mutex _locks[CURL_LOCK_DATA_LAST];
+	std::mutex _state_lock;
+	std::mutex _save_lock;  // save() runs on the main and the background update thread
+	std::thread _prewarm_thread;
+	std::atomic<bool> _prewarm_cancel;
+
+	std::filesystem::path _dns_cache_path;
+	std::filesystem::path _tls_cache_path;
+	std::filesystem::path _stats_path;
+	std::filesystem::path _rate_limit_path;
+	std::map<std::string, _dns_entry> _dns_cache;  // "host:port" -> address
+	std::vector<_tls_session> _tls_sessions;
+	std::map<std::string, _rate_limit> _rate_limits;
+	long long _dns_ttl;
+	bool _verbose;
+	bool _loaded;
+};
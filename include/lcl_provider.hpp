@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "curl/curl.h"
+#include "lcl_release.hpp"
+
+// What a provider needs to know to look up the latest release of a core.
+struct lcl_release_request {
+	std::string url;           // API_URL of the core section
+	std::string search_token;
+	std::string api_token;     // only sent to api.github.com
+};
+
+enum class lcl_fetch_result {
+	UPDATED,
+	NOT_MODIFIED,
+	FAILED
+};
+
+// Release discovery backend selected with PROVIDER= in LCL.cfg.
+// On entry cache holds the last known release (empty on first boot), its validators are used for
+// conditional requests. On UPDATED it is replaced with the new release, on FAILED error says why.
+class lcl_release_provider {
+public:
+	virtual ~lcl_release_provider() = default;
+
+	virtual const char* name() const = 0;
+	virtual lcl_fetch_result fetch(CURL* curl, CURLcode& res, const lcl_release_request& request,
+		lcl_release_cache& cache, std::string& error) = 0;
+};
+
+// "github", "gitea" (also Forgejo), "index" (a GitHub shaped release.json over http(s) or file://)
+// or "file" (a plain directory of archives). Returns nullptr for an unknown name.
+std::unique_ptr<lcl_release_provider> lcl_make_release_provider(const std::string& name);
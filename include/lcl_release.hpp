@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct lcl_release_asset {
+	long long id = 0;
+	std::string name;
+	std::string download_url;
+	std::string digest;  // "sha256:<hex>" when the host publishes one
+	std::string zsync_url;  // "<name>.zsync" published next to the asset, for delta updates
+};
+
+// Control files of zsync delta updates are never the asset themselves.
+bool lcl_is_zsync_name(const std::string& name);
+
+// Last known release of a core, persisted as system/<core>/3.ReleaseCache.json. save() replaces
+// the file in one rename, a reader never sees half of it.
+struct lcl_release_cache {
+	std::string search_token;
+	std::string tag;
+	lcl_release_asset asset;
+	std::string etag;
+	std::string last_modified;
+	long long checked_at = 0;
+
+	bool load(const std::string& path);
+	bool save(const std::string& path) const;
+};
+
+// One core taking part in a batched release query.
+struct lcl_release_target {
+	std::string section;
+	std::string owner;
+	std::string repo;
+	std::string search_token;
+};
+
+// Extracts owner and repository from an api.github.com ".../repos/<owner>/<repo>/releases/..." url.
+bool lcl_parse_repo_url(const std::string& api_url, std::string& owner, std::string& repo);
+
+// Builds the GraphQL request body asking for the latest release of every target at once.
+std::string lcl_build_graphql_query(const std::vector<lcl_release_target>& targets);
+
+// Reads a GraphQL response, one cache entry is produced for each target with a matching asset.
+bool lcl_parse_graphql_releases(const std::string& response, const std::vector<lcl_release_target>& targets,
+	std::vector<std::pair<std::string, lcl_release_cache>>& releases, std::string& error);
+
+// Incremental parser for a GitHub "releases/latest" document.
+// Bytes are fed as they arrive from curl, only tag_name and the fields of the asset matching
+// the search token are kept, everything else (release notes, other assets) is skipped
+// without being buffered, so memory stays bounded regardless of the response size.
+class lcl_release_parser {
+public:
+	explicit lcl_release_parser(std::string search_token);
+
+	// Returns false once the input is not valid JSON.
+	bool feed(const char* data, size_t size);
+
+	// True as soon as the tag and the matching asset have been seen and the asset list is over,
+	// the zsync file of the asset may come after it.
+	bool complete() const;
+	bool failed() const;
+	size_t bytes_parsed() const;
+
+	const std::string& tag() const;
+	const lcl_release_asset& asset() const;
+	bool has_asset() const;
+
+private:
+	enum class _state {
+		VALUE,
+		ARRAY_VALUE_OR_END,
+		OBJECT_KEY_OR_END,
+		OBJECT_KEY,
+		COLON,
+		AFTER_VALUE,
+		STRING,
+		STRING_ESCAPE,
+		STRING_UNICODE,
+		LITERAL,
+		FAILED
+	};
+
+	enum class _capture {
+		NONE,
+		KEY,
+		TAG,
+		ASSET_NAME,
+		ASSET_URL,
+		ASSET_DIGEST
+	};
+
+	static constexpr size_t MAX_DEPTH = 128;
+	static constexpr size_t MAX_CAPTURE = 4096;
+	static constexpr size_t MAX_LITERAL = 32;
+
+	bool step(char c);
+	void begin_value_string();
+	void end_string();
+	bool end_literal();
+	bool open_container(bool is_object);
+	bool close_container(bool is_object);
+	void append_captured(const std::string& utf8);
+	void append_codepoint(unsigned codepoint);
+
+	std::string _search_token;
+	std::string _tag;
+	lcl_release_asset _asset;
+	lcl_release_asset _candidate;
+	bool _has_asset;
+	bool _assets_done;
+	std::vector<std::pair<std::string, std::string>> _zsync_assets;  // name, download url
+
+	_state _state_id;
+	_capture _capture_id;
+	std::vector<bool> _stack;  // true = object, false = array
+	std::string _root_key;
+	std::string _asset_key;
+	std::string _buffer;
+	std::string _literal;
+	bool _in_assets;
+	bool _string_is_key;
+	unsigned _unicode_value;
+	unsigned _unicode_digits;
+	unsigned _high_surrogate;
+	size_t _bytes;
+};
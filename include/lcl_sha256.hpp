@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Incremental SHA-256. Blocks are compressed with the x86 SHA extensions when the CPU has
+// them (checked once at runtime), the portable implementation is used otherwise.
+class lcl_sha256 {
+public:
+	lcl_sha256();
+
+	void update(const void* data, size_t size);
+
+	// Lowercase hex digest, the object must be reset() before it is used again.
+	std::string finish();
+	void reset();
+
+	// True when the SHA extensions are used on this machine.
+	static bool accelerated();
+
+	// Lowercase hex from a "sha256:<hex>" asset digest, empty for anything else.
+	static std::string from_digest(const std::string& digest);
+
+	// Hashes a whole file, false when it can't be read.
+	static bool file(const std::string& path, std::string& hex);
+
+private:
+	void compress(const uint8_t* blocks, size_t count);
+
+	uint32_t _state[8];
+	uint8_t _buffer[64];
+	size_t _buffered;
+	uint64_t _length;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Extracts the squashfs image of an AppImage (or a bare squashfs file) in-process, without FUSE
+// or the AppImage runtime. The inode and directory tables are walked once, then the data blocks
+// are decompressed (gzip, xz or zstd) on a pool of threads: large files are split into runs of
+// blocks and every fragment block is decoded once for all the file tails it holds. Permissions,
+// symlinks and hard links are restored, the tree is written to target as it is in the image.
+class lcl_squashfs_extractor {
+public:
+	lcl_squashfs_extractor(std::filesystem::path image, std::filesystem::path target);
+
+	bool run();
+
+	const std::string& error() const { return _error; }
+
+private:
+	static constexpr unsigned MAX_THREADS = 8;
+	static constexpr uint64_t JOB_BLOCKS = 32;
+	static constexpr uint32_t NO_FRAGMENT = 0xFFFFFFFF;
+
+	struct _file {
+		std::filesystem::path path;
+		uint64_t size;
+		uint64_t blocks_start;
+		std::vector<uint32_t> block_sizes;
+		uint32_t fragment;
+		uint32_t fragment_offset;
+		uint32_t mode;
+	};
+
+	struct _fragment {
+		uint64_t start;
+		uint32_t size;
+		std::vector<size_t> tails;
+	};
+
+	// A run of data blocks of one file, or a fragment block with the file tails it holds.
+	struct _job {
+		size_t file;
+		size_t first_block;
+		size_t blocks;
+		uint64_t position;
+		uint64_t size;
+		uint32_t fragment;
+	};
+
+	struct _metadata_block {
+		std::vector<char> data;
+		uint64_t next;
+	};
+
+	struct _codec;
+
+	bool find_image(std::ifstream& in);
+	bool read_superblock(std::ifstream& in);
+	bool read_at(std::ifstream& in, uint64_t position, void* data, size_t size);
+	bool decompress(_codec& codec, const char* data, size_t size, char* output, size_t capacity, size_t& produced);
+	bool read_block(std::ifstream& in, _codec& codec, uint64_t position, uint32_t stored, std::vector<char>& compressed,
+		std::vector<char>& output, size_t& produced);
+	bool metadata_block(std::ifstream& in, _codec& codec, uint64_t position, const _metadata_block*& block);
+	bool read_metadata(std::ifstream& in, _codec& codec, uint64_t& position, size_t& offset, void* data, size_t size);
+	bool read_tree(std::ifstream& in, _codec& codec);
+	bool read_fragments(std::ifstream& in, _codec& codec);
+	bool plan();
+	bool extract_job(std::ifstream& in, _codec& codec, const _job& job, std::vector<char>& compressed, std::vector<char>& output);
+	bool finish();
+	bool fail(std::string error);
+
+	std::filesystem::path _image;
+	std::filesystem::path _target;
+	uint64_t _offset;
+	uint64_t _image_size;
+	uint32_t _block_size;
+	uint16_t _compression;
+	uint32_t _inode_count;
+	uint32_t _fragment_count;
+	uint64_t _root_inode;
+	uint64_t _inode_table;
+	uint64_t _directory_table;
+	uint64_t _fragment_table;
+	std::map<uint64_t, _metadata_block> _metadata;
+	std::vector<_file> _files;
+	std::vector<_fragment> _fragments;
+	std::vector<_job> _jobs;
+	std::vector<std::pair<std::filesystem::path, uint32_t>> _directories;
+	std::vector<std::pair<std::filesystem::path, std::string>> _symlinks;
+	std::vector<std::pair<std::filesystem::path, size_t>> _hard_links;
+	std::unordered_map<uint32_t, size_t> _file_inodes;
+	std::atomic<bool> _failed;
+	std::atomic<uint64_t> _bytes;
+	std::mutex _error_lock;
+	std::string _error;
+};
@@ -4,8 +4,30 @@
 #include <string>
 #include <filesystem>
 #include <inicpp.h>
+#include <stdexcept>
 
 #include "curl/curl.h"
+#include "lcl_download.hpp"
+#include "lcl_lock.hpp"
+
+struct lcl_release_cache;
+
+// Read an optional key from a config section, falling back when it is missing or empty.
+template<typename T>
+inline T lcl_cfg_get(ini::IniSection& section, const std::string& key, T fallback) {
+	auto it = section.find(key);
+
+	if (it == section.end() || it->second.template as<std::string>().empty()) {
+		return fallback;
+	}
+
+	try {
+		return it->second.template as<T>();
+	}
+	catch (const std::exception&) {
+		return fallback;
+	}
+}
 
 class lcl_utils {
 public:
@@ -19,26 +41,82 @@ public:
 
 	bool lcl_core_get();
 	bool lcl_core_extractor();
+	bool lcl_extract_asset();
+	bool lcl_extract_archive();
+	bool lcl_extract_with_tool(const std::string& command, const std::string& temp);
 	bool lcl_core_updater();
 	bool lcl_core_boot(const struct retro_game_info* info);
+	bool lcl_prepare_appdir(std::string& appdir);
 	bool lcl_build_download_url(CURL* curl, CURLcode& res);
 	bool lcl_download_asset(CURL* curl, CURLcode& res, std::string& url);
+	bool lcl_download_asset(CURL* curl, CURLcode& res, std::string& url, const std::string& target);
+	bool lcl_stream_install(CURL* curl, CURLcode& res);
+	bool lcl_partial_install(CURL* curl, CURLcode& res);
+	bool lcl_zsync_download(CURL* curl, CURLcode& res, const std::string& target);
+	bool lcl_install_asset(CURL* curl, CURLcode& res);
+	bool lcl_cache_fetch(const std::string& target);
+	void lcl_cache_store(const std::string& file);
+	bool lcl_load_release_cache();
+	void lcl_set_release(const lcl_release_cache& cache);
+	bool lcl_save_release_cache();
+	bool lcl_export_download_url();
+	bool lcl_batch_fetch_releases(CURL* curl);
+	bool lcl_fast_path_unchanged(CURL* curl);
+
+	bool lcl_background_updates();
+	bool lcl_core_installed();
+	bool lcl_lock_update(bool wait);
+	void lcl_unlock_update();
+	bool lcl_core_stage_update();
+	bool lcl_apply_staged_update();
+
+	bool lcl_begin_version(const std::string& id);
+	bool lcl_commit_version();
+	void lcl_abort_version();
+	bool lcl_pin_version();
 
 	bool lcl_get_config_status();
 
 private:
+	std::string lcl_live_path();
+	bool lcl_asset_is_appimage();
+
+	// A copy of lcl_utils (the background update worker's) starts without the update lock.
+	struct _update_file_lock : lcl_file_lock {
+		_update_file_lock() = default;
+		_update_file_lock(const _update_file_lock&) {}
+		_update_file_lock& operator=(const _update_file_lock&) { return *this; }
+	};
+	void lcl_set_install_path(const std::string& path);
+
 	std::vector<std::string> _directories;
 	std::vector<std::string> _downloaderDirs;
 	std::vector<std::string> _urls;
 
 	std::string _executable;
+	std::string _executable_name;
+	// Directory the emulator tree lives in: the live version, or the one being installed.
+	std::string _install_path;
+	std::string _install_id;
+	std::string _install_work;
+	std::string _pin_version;
 	std::string _tag;
 	std::string _current_version;
 	std::string _new_version;
 	std::string _config_path;
 	std::string _emu_extensions;
 	std::string _search_token;
+	// ".zip" or ".7z" for the asset of this platform, anything else is an AppImage on Linux.
 	std::string _archive_extension;
+	std::string _asset_name;
+	std::string _asset_digest;
+	std::string _zsync_url;
+	std::string _etag;
+	std::string _last_modified;
+	std::string _graphql_url;
+	std::string _provider;
+	std::string _fast_path_asset;
+	std::string _api_token;
 
 	// using path to not worry about separators
 	std::filesystem::path _base_path;
@@ -47,8 +125,21 @@ private:
 	ini::IniSection _cfg_section;
 	
 	int _url_asset_id;
+	long long _checked_at;
+	long long _check_ttl;
+	unsigned long long _cache_max_bytes;
+	long long _update_lock_wait;
+	long _keep_versions;
 
 	bool _is_flatpak;
+	bool _background_updates;
+	bool _batch_query;
+	bool _stream_extract;
+	bool _stream_installed;
+	bool _partial_updates;
+	bool _zsync_updates;
+	lcl_download_options _download_options;
+	_update_file_lock _update_lock;
 	
    enum _directory_ids {
        EMULATOR_PATH,
@@ -62,6 +153,11 @@ private:
         URL_FILE,
         CURRENT_VERSION_FILE,
         NEW_VERSION_FILE,
+        RELEASE_CACHE_FILE,
+        NET_STATS_FILE,
+        MANIFEST_FILE,
+        STAGING_PATH,
+        STAGED_VERSION_FILE,
         DOWNLOADED_FILE
     };
 
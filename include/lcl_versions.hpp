@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Installed versions of a core side by side, as <root>/versions/<asset id>/. The live one is named
+// by <root>/current, a symlink on Linux and a file holding the id on Windows, swapped with a single
+// rename: a launch finds either the old tree or the new one complete, and one already running keeps
+// the tree it started from. Installs go to a hidden working directory that only takes its final
+// name once complete, nothing is ever written into a version after that.
+class lcl_version_store {
+public:
+	explicit lcl_version_store(std::filesystem::path root);
+
+	// Id of the live version, empty when there is none.
+	std::string live() const;
+
+	std::filesystem::path path(const std::string& id) const;
+	bool installed(const std::string& id) const;
+
+	// Fresh working directory seeded with the files of the live version. They are hard linked
+	// (copied where links fail): every install path replaces a file instead of writing through it,
+	// so the live version is never touched. Top level entries named in skip are left out.
+	bool begin(std::filesystem::path& work, const std::vector<std::string>& skip, std::string& error);
+
+	// Renames work to versions/<id> and makes it live.
+	bool commit(const std::filesystem::path& work, const std::string& id, std::string& error);
+
+	void abort(const std::filesystem::path& work);
+
+	// Makes an installed version live.
+	bool activate(const std::string& id, std::string& error);
+
+	// Turns an emulator installed straight into root, before versioned directories, into
+	// versions/<id>. Top level entries named in skip (the launcher's own files) stay where they are.
+	bool adopt(const std::string& id, const std::vector<std::string>& skip, std::string& error);
+
+	// Deletes the versions least recently made live beyond keep, the live one counted in.
+	// The live and pinned versions are never deleted, neither is one still in use on Windows.
+	void prune(size_t keep, const std::string& pinned);
+
+private:
+	void cleanup();
+
+	std::filesystem::path _root;
+	std::filesystem::path _versions;
+};
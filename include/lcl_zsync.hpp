@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "curl/curl.h"
+#include "lcl_download.hpp"
+
+// The control file zsyncmake publishes for an uncompressed file, with its block size and hash
+// lengths. Lets tools/zsync_bench run without zsync installed.
+bool lcl_zsync_make_control(const std::filesystem::path& file, const std::string& url, std::string& control);
+
+// Rebuilds the new release of a single file asset (an AppImage) from the installed one, with the
+// .zsync control file published next to the asset. The installed file is scanned once with the
+// rolling checksum of the control file, every block found in it at any offset is copied over,
+// only the missing blocks are fetched with HTTP ranges. The result is checked against the SHA-1
+// of the control file (and the published SHA-256 when there is one) before it replaces target.
+class lcl_zsync_client {
+public:
+	lcl_zsync_client(std::string control_url, std::string url, std::filesystem::path seed, std::filesystem::path target,
+		const lcl_download_options& options, const std::atomic<bool>& cancel);
+
+	// "sha256:<hex>", checked along with the SHA-1.
+	void expect_sha256(const std::string& digest);
+
+	// curl stays owned by the caller and is left reusable. target is only replaced on success.
+	bool run(CURL* curl, CURLcode& res);
+
+	const std::string& error() const { return _error; }
+
+private:
+	static constexpr size_t SEED_CHUNK = 16 * 1024 * 1024;
+	// Missing blocks closer than this are fetched in one request, the gap costs less than a round trip.
+	static constexpr uint64_t MERGE_GAP = 64 * 1024;
+	static constexpr size_t MAX_REQUESTS = 256;
+	static constexpr size_t MAX_CONTROL_SIZE = 64 * 1024 * 1024;
+
+	struct _rsum {
+		uint16_t a;
+		uint16_t b;
+	};
+
+	bool fetch_control(CURL* curl, CURLcode& res);
+	bool parse_control();
+	void index_blocks();
+	uint64_t block_key(_rsum first, _rsum second) const;
+	bool scan_seed(FILE* output);
+	bool match(const unsigned char* window, FILE* output);
+	bool write_block(FILE* output, uint32_t block, const unsigned char* data);
+	std::vector<std::pair<uint64_t, uint64_t>> missing_ranges() const;
+	bool verify();
+	bool fail(std::string error);
+
+	std::string _control_url;
+	std::string _url;
+	std::filesystem::path _seed;
+	std::filesystem::path _target;
+	std::filesystem::path _part_path;
+	lcl_download_options _options;
+	const std::atomic<bool>& _cancel;
+	std::string _expected_sha256;
+	std::string _control;
+
+	uint64_t _length;
+	uint32_t _block_size;
+	uint32_t _blocks;
+	unsigned _seq_matches;
+	unsigned _rsum_bytes;
+	unsigned _checksum_bytes;
+	uint16_t _a_mask;
+	std::string _sha1;
+
+	// Per block: the rolling checksum and the leading bytes of its MD4, as the control file has them.
+	std::vector<_rsum> _rsums;
+	std::vector<unsigned char> _checksums;
+	// (key, block) sorted by key, with a bit filter in front of the lookup.
+	std::vector<std::pair<uint64_t, uint32_t>> _index;
+	std::vector<uint64_t> _filter;
+	size_t _filter_bits;
+	std::vector<bool> _known;
+	uint32_t _known_count;
+	std::string _error;
+};
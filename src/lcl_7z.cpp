@@ -0,0 +1,1511 @@
+#include "lcl_7z.hpp"
+#include "lcl_extract.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include <libdeflate.h>
+#include <lzma.h>
+#include <zlib.h>
+
+extern retro_log_printf_t log_cb;
+
+static const unsigned char SIGNATURE[6] = { '7', 'z', 0xBC, 0xAF, 0x27, 0x1C };
+
+static constexpr uint64_t ID_END = 0x00;
+static constexpr uint64_t ID_HEADER = 0x01;
+static constexpr uint64_t ID_ARCHIVE_PROPERTIES = 0x02;
+static constexpr uint64_t ID_ADDITIONAL_STREAMS_INFO = 0x03;
+static constexpr uint64_t ID_MAIN_STREAMS_INFO = 0x04;
+static constexpr uint64_t ID_FILES_INFO = 0x05;
+static constexpr uint64_t ID_PACK_INFO = 0x06;
+static constexpr uint64_t ID_UNPACK_INFO = 0x07;
+static constexpr uint64_t ID_SUBSTREAMS_INFO = 0x08;
+static constexpr uint64_t ID_SIZE = 0x09;
+static constexpr uint64_t ID_CRC = 0x0A;
+static constexpr uint64_t ID_FOLDER = 0x0B;
+static constexpr uint64_t ID_CODERS_UNPACK_SIZE = 0x0C;
+static constexpr uint64_t ID_NUM_UNPACK_STREAM = 0x0D;
+static constexpr uint64_t ID_EMPTY_STREAM = 0x0E;
+static constexpr uint64_t ID_EMPTY_FILE = 0x0F;
+static constexpr uint64_t ID_ANTI = 0x10;
+static constexpr uint64_t ID_NAME = 0x11;
+static constexpr uint64_t ID_WIN_ATTRIBUTES = 0x15;
+static constexpr uint64_t ID_ENCODED_HEADER = 0x17;
+
+static constexpr uint64_t METHOD_COPY = 0x00;
+static constexpr uint64_t METHOD_DELTA = 0x03;
+static constexpr uint64_t METHOD_LZMA2 = 0x21;
+static constexpr uint64_t METHOD_LZMA = 0x030101;
+static constexpr uint64_t METHOD_BCJ2 = 0x0303011B;
+static constexpr uint64_t METHOD_DEFLATE = 0x040108;
+static constexpr uint64_t METHOD_AES = 0x06F10701;
+
+static constexpr uint32_t ATTRIBUTE_DIRECTORY = 0x10;
+static constexpr uint32_t ATTRIBUTE_UNIX_EXTENSION = 0x8000;
+static constexpr uint32_t MODE_TYPE = 0170000;
+static constexpr uint32_t MODE_SYMLINK = 0120000;
+
+static constexpr uint64_t MAX_HEADER_SIZE = 256 * 1024 * 1024;
+
+static uint32_t read_le32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+        (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static uint64_t read_le64(const unsigned char* data) {
+    return static_cast<uint64_t>(read_le32(data)) | (static_cast<uint64_t>(read_le32(data + 4)) << 32);
+}
+
+// The branch converters share their ids between 7z and xz, under the long and the short 7z name.
+static lzma_vli lzma_filter_for(uint64_t method) {
+    switch (method) {
+    case METHOD_LZMA: return LZMA_FILTER_LZMA1;
+    case METHOD_LZMA2: return LZMA_FILTER_LZMA2;
+    case METHOD_DELTA: return LZMA_FILTER_DELTA;
+    case 0x03030103: case 0x04: return LZMA_FILTER_X86;
+    case 0x03030205: case 0x05: return LZMA_FILTER_POWERPC;
+    case 0x03030401: case 0x06: return LZMA_FILTER_IA64;
+    case 0x03030501: case 0x07: return LZMA_FILTER_ARM;
+    case 0x03030701: case 0x08: return LZMA_FILTER_ARMTHUMB;
+    case 0x03030805: case 0x09: return LZMA_FILTER_SPARC;
+#ifdef LZMA_FILTER_ARM64
+    case 0x0A: return LZMA_FILTER_ARM64;
+#endif
+#ifdef LZMA_FILTER_RISCV
+    case 0x0B: return LZMA_FILTER_RISCV;
+#endif
+    default: return LZMA_VLI_UNKNOWN;
+    }
+}
+
+namespace {
+
+// Pull end of a coder, every coder of a folder reads from the ones feeding it.
+class sz_source {
+public:
+    virtual ~sz_source() = default;
+
+    // False on corrupt or truncated data, got is 0 once the stream ended.
+    virtual bool read(unsigned char* data, size_t size, size_t& got) = 0;
+};
+
+// One packed stream of the archive. Several can read the same file, each seeks to its own position.
+class packed_source : public sz_source {
+public:
+    packed_source(std::ifstream& in, uint64_t offset, uint64_t size) : _in(in), _offset(offset), _remaining(size) {}
+
+    bool read(unsigned char* data, size_t size, size_t& got) override {
+        got = static_cast<size_t>(std::min<uint64_t>(size, _remaining));
+
+        if (got == 0) {
+            return true;
+        }
+
+        _in.clear();
+        _in.seekg(static_cast<std::streamoff>(_offset));
+
+        if (!_in.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(got))) {
+            return false;
+        }
+
+        _offset += got;
+        _remaining -= got;
+        return true;
+    }
+
+private:
+    std::ifstream& _in;
+    uint64_t _offset;
+    uint64_t _remaining;
+};
+
+// A raw liblzma filter chain, LZMA or LZMA2 last, stopped once the expected size came out.
+class lzma_source : public sz_source {
+public:
+    static constexpr size_t INPUT_SIZE = 1024 * 1024;
+
+    explicit lzma_source(uint64_t size) : _remaining(size), _buffer(INPUT_SIZE) {}
+
+    ~lzma_source() override {
+        lzma_end(&_stream);
+
+        for (auto& filter : _filters) {
+            free(filter.options);
+        }
+    }
+
+    // Takes ownership of the decoded options.
+    void add(const lzma_filter& filter) { _filters.push_back(filter); }
+
+    bool start(std::unique_ptr<sz_source> input) {
+        std::vector<lzma_filter> chain = _filters;
+
+        _input = std::move(input);
+        chain.push_back({ LZMA_VLI_UNKNOWN, nullptr });
+
+        return _input && lzma_raw_decoder(&_stream, chain.data()) == LZMA_OK;
+    }
+
+    bool read(unsigned char* data, size_t size, size_t& got) override {
+        size = static_cast<size_t>(std::min<uint64_t>(size, _remaining));
+        got = 0;
+
+        _stream.next_out = data;
+        _stream.avail_out = size;
+
+        while (_stream.avail_out > 0 && !_ended) {
+            if (_stream.avail_in == 0 && !_input_done) {
+                size_t count;
+
+                if (!_input->read(_buffer.data(), _buffer.size(), count)) {
+                    return false;
+                }
+
+                _input_done = count == 0;
+                _stream.next_in = _buffer.data();
+                _stream.avail_in = count;
+            }
+
+            size_t before = _stream.avail_out;
+            lzma_ret ret = lzma_code(&_stream, LZMA_RUN);
+
+            if (ret == LZMA_STREAM_END) {
+                _ended = true;
+            } else if (ret != LZMA_OK && ret != LZMA_BUF_ERROR) {
+                return false;
+            } else if (_input_done && _stream.avail_in == 0 && _stream.avail_out == before) {
+                return false;
+            }
+        }
+
+        got = size - _stream.avail_out;
+        _remaining -= got;
+        return true;
+    }
+
+private:
+    std::unique_ptr<sz_source> _input;
+    std::vector<lzma_filter> _filters;
+    lzma_stream _stream = LZMA_STREAM_INIT;
+    uint64_t _remaining;
+    std::vector<unsigned char> _buffer;
+    bool _input_done = false;
+    bool _ended = false;
+};
+
+// Raw deflate through zlib.
+class inflate_source : public sz_source {
+public:
+    static constexpr size_t INPUT_SIZE = 256 * 1024;
+
+    inflate_source(std::unique_ptr<sz_source> input, uint64_t size)
+        : _input(std::move(input)), _remaining(size), _buffer(INPUT_SIZE) {
+        _ready = _input && inflateInit2(&_stream, -MAX_WBITS) == Z_OK;
+    }
+
+    ~inflate_source() override {
+        if (_ready) {
+            inflateEnd(&_stream);
+        }
+    }
+
+    bool read(unsigned char* data, size_t size, size_t& got) override {
+        size = static_cast<size_t>(std::min<uint64_t>(size, _remaining));
+        got = 0;
+
+        if (!_ready) {
+            return false;
+        }
+
+        _stream.next_out = data;
+        _stream.avail_out = static_cast<uInt>(size);
+
+        while (_stream.avail_out > 0 && !_ended) {
+            if (_stream.avail_in == 0) {
+                size_t count;
+
+                if (!_input->read(_buffer.data(), _buffer.size(), count) || count == 0) {
+                    return false;
+                }
+
+                _stream.next_in = _buffer.data();
+                _stream.avail_in = static_cast<uInt>(count);
+            }
+
+            int status = inflate(&_stream, Z_NO_FLUSH);
+
+            if (status == Z_STREAM_END) {
+                _ended = true;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                return false;
+            }
+        }
+
+        got = size - _stream.avail_out;
+        _remaining -= got;
+        return true;
+    }
+
+private:
+    std::unique_ptr<sz_source> _input;
+    z_stream _stream{};
+    uint64_t _remaining;
+    std::vector<unsigned char> _buffer;
+    bool _ready = false;
+    bool _ended = false;
+};
+
+// Byte at a time over a source, for the BCJ2 inputs.
+class byte_reader {
+public:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    explicit byte_reader(std::unique_ptr<sz_source> source) : _source(std::move(source)), _buffer(BUFFER_SIZE) {}
+
+    bool valid() const { return _source != nullptr; }
+
+    bool next(unsigned char& byte) {
+        if (_pos == _end) {
+            if (!_source->read(_buffer.data(), _buffer.size(), _end) || _end == 0) {
+                return false;
+            }
+
+            _pos = 0;
+        }
+
+        byte = _buffer[_pos++];
+        return true;
+    }
+
+    // Call and jump targets are stored big endian.
+    bool next_be32(uint32_t& value) {
+        unsigned char byte;
+
+        value = 0;
+
+        for (int i = 0; i < 4; i++) {
+            if (!next(byte)) {
+                return false;
+            }
+
+            value = (value << 8) | byte;
+        }
+
+        return true;
+    }
+
+private:
+    std::unique_ptr<sz_source> _source;
+    std::vector<unsigned char> _buffer;
+    size_t _pos = 0;
+    size_t _end = 0;
+};
+
+// BCJ2 puts the targets of x86 CALL and JMP instructions in their own streams, a range coded
+// bit per candidate opcode tells whether it was converted. Four inputs: main, call, jump, range coder.
+class bcj2_source : public sz_source {
+public:
+    bcj2_source(std::unique_ptr<sz_source> main, std::unique_ptr<sz_source> call, std::unique_ptr<sz_source> jump,
+        std::unique_ptr<sz_source> range, uint64_t size)
+        : _main(std::move(main)), _call(std::move(call)), _jump(std::move(jump)), _range_coder(std::move(range)), _size(size) {
+        std::fill(std::begin(_probabilities), std::end(_probabilities), static_cast<uint16_t>(BIT_MODEL_TOTAL >> 1));
+    }
+
+    bool valid() const { return _main.valid() && _call.valid() && _jump.valid() && _range_coder.valid(); }
+
+    bool read(unsigned char* data, size_t size, size_t& got) override {
+        got = 0;
+
+        while (got < size && _position < _size) {
+            if (_pending > 0) {
+                data[got++] = static_cast<unsigned char>(_target >> (8 * (4 - _pending)));
+                _pending--;
+                _position++;
+                continue;
+            }
+
+            unsigned char byte;
+
+            if (!_main.next(byte)) {
+                return false;
+            }
+
+            data[got++] = byte;
+            _position++;
+
+            bool jump = (byte & 0xFE) == 0xE8 || (_previous == 0x0F && (byte & 0xF0) == 0x80);
+
+            if (!jump || _position == _size) {
+                _previous = byte;
+                continue;
+            }
+
+            uint16_t& probability = _probabilities[byte == 0xE8 ? _previous : (byte == 0xE9 ? 256 : 257)];
+            bool converted;
+
+            if (!decode_bit(probability, converted)) {
+                return false;
+            }
+
+            if (!converted) {
+                _previous = byte;
+                continue;
+            }
+
+            uint32_t absolute;
+
+            if (!(byte == 0xE8 ? _call : _jump).next_be32(absolute)) {
+                return false;
+            }
+
+            _target = absolute - static_cast<uint32_t>(_position + 4);
+            _previous = static_cast<unsigned char>(_target >> 24);
+            _pending = 4;
+        }
+
+        return true;
+    }
+
+private:
+    static constexpr uint32_t TOP_VALUE = 1u << 24;
+    static constexpr uint32_t BIT_MODEL_TOTAL = 1u << 11;
+    static constexpr int MOVE_BITS = 5;
+
+    bool decode_bit(uint16_t& probability, bool& bit) {
+        unsigned char byte;
+
+        if (!_range_ready) {
+            for (int i = 0; i < 5; i++) {
+                if (!_range_coder.next(byte)) {
+                    return false;
+                }
+
+                _code = (_code << 8) | byte;
+            }
+
+            _range_ready = true;
+        }
+
+        uint32_t bound = (_range >> 11) * probability;
+
+        if (_code < bound) {
+            _range = bound;
+            probability = static_cast<uint16_t>(probability + ((BIT_MODEL_TOTAL - probability) >> MOVE_BITS));
+            bit = false;
+        } else {
+            _range -= bound;
+            _code -= bound;
+            probability = static_cast<uint16_t>(probability - (probability >> MOVE_BITS));
+            bit = true;
+        }
+
+        if (_range < TOP_VALUE) {
+            if (!_range_coder.next(byte)) {
+                return false;
+            }
+
+            _range <<= 8;
+            _code = (_code << 8) | byte;
+        }
+
+        return true;
+    }
+
+    byte_reader _main;
+    byte_reader _call;
+    byte_reader _jump;
+    byte_reader _range_coder;
+    uint64_t _size;
+    uint64_t _position = 0;
+    uint16_t _probabilities[258];
+    uint32_t _range = 0xFFFFFFFF;
+    uint32_t _code = 0;
+    bool _range_ready = false;
+    unsigned char _previous = 0;
+    uint32_t _target = 0;
+    int _pending = 0;
+};
+
+}
+
+struct lcl_7z_extractor::_reader {
+    const unsigned char* data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+
+    unsigned char byte() {
+        if (pos >= size) {
+            ok = false;
+            return 0;
+        }
+
+        return data[pos++];
+    }
+
+    // 7z NUMBER: the leading one bits of the first byte count the bytes that follow.
+    uint64_t number() {
+        unsigned char first = byte();
+        unsigned char mask = 0x80;
+        uint64_t value = 0;
+
+        for (int i = 0; i < 8; i++) {
+            if ((first & mask) == 0) {
+                return value | (static_cast<uint64_t>(first & (mask - 1)) << (8 * i));
+            }
+
+            value |= static_cast<uint64_t>(byte()) << (8 * i);
+            mask >>= 1;
+        }
+
+        return value;
+    }
+
+    uint32_t uint32() {
+        const unsigned char* bytes = take(4);
+        return bytes ? read_le32(bytes) : 0;
+    }
+
+    const unsigned char* take(uint64_t count) {
+        if (count > size - pos) {
+            ok = false;
+            return nullptr;
+        }
+
+        pos += static_cast<size_t>(count);
+        return data + pos - count;
+    }
+
+    // Item counts come from the archive, one that can't fit in what is left is corrupt.
+    bool fits(uint64_t count, uint64_t bits_per_item = 8) {
+        ok = ok && count <= (size - pos) * 8 / bits_per_item;
+        return ok;
+    }
+
+    std::vector<bool> bits(uint64_t count) {
+        std::vector<bool> result;
+        unsigned char current = 0;
+
+        if (!fits(count, 1)) {
+            return result;
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+            if (i % 8 == 0) {
+                current = byte();
+            }
+
+            result.push_back((current & (0x80 >> (i % 8))) != 0);
+        }
+
+        return result;
+    }
+
+    // Either an all-defined byte or a bit per item, each defined item is followed by 4 bytes.
+    std::vector<bool> defined(uint64_t count) {
+        if (byte() == 0) {
+            return bits(count);
+        }
+
+        return fits(count, 32) ? std::vector<bool>(static_cast<size_t>(count), true) : std::vector<bool>();
+    }
+};
+
+struct lcl_7z_extractor::_streams {
+    uint64_t pack_position = 0;
+    std::vector<uint64_t> pack_sizes;
+    std::vector<_folder> folders;
+    std::vector<uint64_t> sizes;
+    std::vector<bool> crc_defined;
+    std::vector<uint32_t> crcs;
+};
+
+// Turns a folder's coder graph into a chain of sources, starting from its unpacked output.
+struct lcl_7z_extractor::_decoder {
+    std::ifstream& in;
+    const _folder& folder;
+    std::string error;
+    int depth = 0;
+
+    // The one out stream no bind pair consumes is what the folder unpacks to.
+    static uint64_t main_out(const _folder& folder) {
+        uint64_t total = 0;
+
+        for (const auto& coder : folder.coders) {
+            total += coder.out_streams;
+        }
+
+        for (uint64_t out = 0; out < total; out++) {
+            bool bound = std::any_of(folder.bind_pairs.begin(), folder.bind_pairs.end(),
+                [out](const auto& pair) { return pair.second == out; });
+
+            if (!bound) {
+                return out;
+            }
+        }
+
+        return 0;
+    }
+
+    static uint64_t unpack_size(const _folder& folder) {
+        uint64_t out = main_out(folder);
+        return out < folder.unpack_sizes.size() ? folder.unpack_sizes[out] : 0;
+    }
+
+    static uint64_t method_id(const _coder& coder) {
+        uint64_t id = 0;
+
+        for (unsigned char byte : coder.method) {
+            id = (id << 8) | byte;
+        }
+
+        return coder.method.size() <= 8 ? id : ~0ULL;
+    }
+
+    bool locate(uint64_t out_index, size_t& coder, uint64_t& first_in) {
+        uint64_t first_out = 0;
+
+        first_in = 0;
+
+        for (coder = 0; coder < folder.coders.size(); coder++) {
+            if (out_index < first_out + folder.coders[coder].out_streams) {
+                return folder.coders[coder].out_streams == 1 || fail("coders with several outputs are not supported");
+            }
+
+            first_out += folder.coders[coder].out_streams;
+            first_in += folder.coders[coder].in_streams;
+        }
+
+        return fail("broken coder graph");
+    }
+
+    bool fail(std::string message) {
+        if (error.empty()) {
+            error = std::move(message);
+        }
+
+        return false;
+    }
+
+    std::unique_ptr<sz_source> open_in(uint64_t in_index) {
+        for (const auto& [bound_in, bound_out] : folder.bind_pairs) {
+            if (bound_in == in_index) {
+                return open_out(bound_out);
+            }
+        }
+
+        for (size_t i = 0; i < folder.packed_streams.size(); i++) {
+            if (folder.packed_streams[i] == in_index) {
+                return std::make_unique<packed_source>(in, folder.pack_offsets[i], folder.pack_sizes[i]);
+            }
+        }
+
+        fail("broken coder graph");
+        return nullptr;
+    }
+
+    std::unique_ptr<sz_source> open_out(uint64_t out_index) {
+        size_t coder;
+        uint64_t first_in;
+
+        if (++depth > 32 || !locate(out_index, coder, first_in)) {
+            fail("broken coder graph");
+            return nullptr;
+        }
+
+        uint64_t method = method_id(folder.coders[coder]);
+        uint64_t size = folder.unpack_sizes[out_index];
+
+        if (method == METHOD_COPY) {
+            return open_in(first_in);
+        }
+
+        if (method == METHOD_DEFLATE) {
+            auto input = open_in(first_in);
+            return input ? std::make_unique<inflate_source>(std::move(input), size) : nullptr;
+        }
+
+        if (method == METHOD_BCJ2) {
+            if (folder.coders[coder].in_streams != 4) {
+                fail("malformed BCJ2 coder");
+                return nullptr;
+            }
+
+            auto source = std::make_unique<bcj2_source>(open_in(first_in), open_in(first_in + 1),
+                open_in(first_in + 2), open_in(first_in + 3), size);
+
+            return source->valid() ? std::move(source) : nullptr;
+        }
+
+        // Filters stacked on LZMA/LZMA2 become a single liblzma chain.
+        auto source = std::make_unique<lzma_source>(size);
+
+        for (;;) {
+            const _coder& current = folder.coders[coder];
+            lzma_filter filter{ lzma_filter_for(method_id(current)), nullptr };
+
+            if (method_id(current) == METHOD_AES) {
+                fail("encrypted archive");
+                return nullptr;
+            }
+
+            if (filter.id == LZMA_VLI_UNKNOWN || current.in_streams != 1) {
+                char id[32];
+                snprintf(id, sizeof(id), "%llX", static_cast<unsigned long long>(method_id(current)));
+                fail(std::string("unsupported 7z method ") + id);
+                return nullptr;
+            }
+
+            if (lzma_properties_decode(&filter, nullptr, current.properties.data(), current.properties.size()) != LZMA_OK) {
+                fail("bad coder properties");
+                return nullptr;
+            }
+
+            bool last = filter.id == LZMA_FILTER_LZMA1 || filter.id == LZMA_FILTER_LZMA2;
+
+            // Nothing past the output can be referenced, a smaller dictionary keeps threads cheap.
+            if (last) {
+                auto* options = static_cast<lzma_options_lzma*>(filter.options);
+                uint64_t needed = std::max<uint64_t>(folder.unpack_sizes[out_index], LZMA_DICT_SIZE_MIN);
+
+                options->dict_size = static_cast<uint32_t>(std::min<uint64_t>(options->dict_size, needed));
+            }
+
+            source->add(filter);
+
+            if (last) {
+                break;
+            }
+
+            auto bound = std::find_if(folder.bind_pairs.begin(), folder.bind_pairs.end(),
+                [first_in](const auto& pair) { return pair.first == first_in; });
+
+            if (bound == folder.bind_pairs.end() || ++depth > 32 || !locate(bound->second, coder, first_in)) {
+                fail("unsupported coder chain");
+                return nullptr;
+            }
+
+            out_index = bound->second;
+        }
+
+        if (!source->start(open_in(first_in))) {
+            fail("could not set up the LZMA decoder");
+            return nullptr;
+        }
+
+        return source;
+    }
+};
+
+lcl_7z_extractor::lcl_7z_extractor(std::filesystem::path archive, std::filesystem::path target)
+    : _archive(std::move(archive)), _target(std::move(target)), _failed(false), _extracted_files(0), _bytes(0) {
+}
+
+// The first error is kept, the other threads stop before their next folder.
+bool lcl_7z_extractor::fail(std::string error) {
+    std::lock_guard<std::mutex> lock(_error_lock);
+
+    if (!_failed.exchange(true)) {
+        _error = std::move(error);
+    }
+
+    return false;
+}
+
+bool lcl_7z_extractor::read_folder(_reader& reader, _folder& folder) {
+    uint64_t coders = reader.number();
+    uint64_t in_total = 0;
+    uint64_t out_total = 0;
+
+    if (coders == 0 || coders > 64 || !reader.fits(coders)) {
+        return fail("corrupt folder");
+    }
+
+    for (uint64_t i = 0; i < coders && reader.ok; i++) {
+        unsigned char flags = reader.byte();
+        const unsigned char* method = reader.take(flags & 0x0F);
+        _coder coder{};
+
+        if (flags & 0x80) {
+            return fail("alternative coder methods are not supported");
+        }
+
+        if (method) {
+            coder.method.assign(method, method + (flags & 0x0F));
+        }
+
+        coder.in_streams = (flags & 0x10) ? reader.number() : 1;
+        coder.out_streams = (flags & 0x10) ? reader.number() : 1;
+
+        if (flags & 0x20) {
+            uint64_t size = reader.number();
+            const unsigned char* properties = reader.take(size);
+
+            if (properties) {
+                coder.properties.assign(properties, properties + size);
+            }
+        }
+
+        if (coder.in_streams > 64 || coder.out_streams > 64) {
+            return fail("corrupt folder");
+        }
+
+        in_total += coder.in_streams;
+        out_total += coder.out_streams;
+        folder.coders.push_back(std::move(coder));
+    }
+
+    if (!reader.ok || out_total == 0 || in_total < out_total - 1) {
+        return fail("corrupt folder");
+    }
+
+    for (uint64_t i = 0; i + 1 < out_total; i++) {
+        uint64_t in_index = reader.number();
+        uint64_t out_index = reader.number();
+
+        if (in_index >= in_total || out_index >= out_total) {
+            return fail("corrupt folder");
+        }
+
+        folder.bind_pairs.emplace_back(in_index, out_index);
+    }
+
+    uint64_t packed = in_total - (out_total - 1);
+
+    // A single packed stream is implied: whichever input no bind pair feeds.
+    if (packed == 1) {
+        for (uint64_t in_index = 0; in_index < in_total; in_index++) {
+            bool bound = std::any_of(folder.bind_pairs.begin(), folder.bind_pairs.end(),
+                [in_index](const auto& pair) { return pair.first == in_index; });
+
+            if (!bound) {
+                folder.packed_streams.push_back(in_index);
+                break;
+            }
+        }
+    } else {
+        for (uint64_t i = 0; i < packed; i++) {
+            folder.packed_streams.push_back(reader.number());
+        }
+    }
+
+    return (reader.ok && folder.packed_streams.size() == packed) || fail("corrupt folder");
+}
+
+bool lcl_7z_extractor::read_streams_info(_reader& reader, _streams& streams) {
+    uint64_t id = reader.number();
+
+    if (id == ID_PACK_INFO) {
+        streams.pack_position = reader.number();
+        uint64_t count = reader.number();
+
+        if (!reader.fits(count)) {
+            return fail("corrupt pack info");
+        }
+
+        id = reader.number();
+
+        if (id == ID_SIZE) {
+            for (uint64_t i = 0; i < count; i++) {
+                streams.pack_sizes.push_back(reader.number());
+            }
+
+            id = reader.number();
+        }
+
+        if (id == ID_CRC) {
+            for (bool defined : reader.defined(count)) {
+                if (defined) {
+                    reader.uint32();
+                }
+            }
+
+            id = reader.number();
+        }
+
+        if (id != ID_END || streams.pack_sizes.size() != count) {
+            return fail("corrupt pack info");
+        }
+
+        id = reader.number();
+    }
+
+    if (id == ID_UNPACK_INFO) {
+        if (reader.number() != ID_FOLDER) {
+            return fail("corrupt unpack info");
+        }
+
+        uint64_t count = reader.number();
+
+        if (!reader.fits(count) || reader.byte() != 0) {
+            return fail("corrupt unpack info");
+        }
+
+        streams.folders.resize(static_cast<size_t>(count));
+
+        for (auto& folder : streams.folders) {
+            if (!read_folder(reader, folder)) {
+                return false;
+            }
+        }
+
+        if (reader.number() != ID_CODERS_UNPACK_SIZE) {
+            return fail("corrupt unpack info");
+        }
+
+        for (auto& folder : streams.folders) {
+            for (const auto& coder : folder.coders) {
+                for (uint64_t i = 0; i < coder.out_streams; i++) {
+                    folder.unpack_sizes.push_back(reader.number());
+                }
+            }
+        }
+
+        id = reader.number();
+
+        if (id == ID_CRC) {
+            auto defined = reader.defined(count);
+
+            for (size_t i = 0; i < defined.size(); i++) {
+                streams.folders[i].crc_defined = defined[i];
+                streams.folders[i].crc = defined[i] ? reader.uint32() : 0;
+            }
+
+            id = reader.number();
+        }
+
+        if (id != ID_END) {
+            return fail("corrupt unpack info");
+        }
+
+        id = reader.number();
+    }
+
+    for (auto& folder : streams.folders) {
+        folder.substreams = 1;
+    }
+
+    std::vector<uint32_t> digests;
+    std::vector<bool> digests_defined;
+
+    if (id == ID_SUBSTREAMS_INFO) {
+        id = reader.number();
+
+        if (id == ID_NUM_UNPACK_STREAM) {
+            for (auto& folder : streams.folders) {
+                folder.substreams = reader.number();
+
+                if (!reader.fits(folder.substreams, 1)) {
+                    return fail("corrupt substreams info");
+                }
+            }
+
+            id = reader.number();
+        }
+
+        bool has_sizes = id == ID_SIZE;
+
+        // Every substream but the last has its size, the last one gets what is left of the folder.
+        for (const auto& folder : streams.folders) {
+            uint64_t total = _decoder::unpack_size(folder);
+            uint64_t sum = 0;
+
+            for (uint64_t i = 1; i < folder.substreams; i++) {
+                uint64_t size = has_sizes ? reader.number() : 0;
+
+                if (size > total - sum) {
+                    return fail("corrupt substreams info");
+                }
+
+                streams.sizes.push_back(size);
+                sum += size;
+            }
+
+            if (folder.substreams > 0) {
+                streams.sizes.push_back(total - sum);
+            }
+        }
+
+        if (has_sizes) {
+            id = reader.number();
+        }
+
+        // Digests only for the substreams the folder CRC does not already cover.
+        uint64_t missing = 0;
+
+        for (const auto& folder : streams.folders) {
+            missing += folder.substreams == 1 && folder.crc_defined ? 0 : folder.substreams;
+        }
+
+        if (id == ID_CRC) {
+            digests_defined = reader.defined(missing);
+
+            for (bool defined : digests_defined) {
+                digests.push_back(defined ? reader.uint32() : 0);
+            }
+
+            id = reader.number();
+        }
+
+        if (id != ID_END) {
+            return fail("corrupt substreams info");
+        }
+
+        id = reader.number();
+    } else {
+        for (const auto& folder : streams.folders) {
+            streams.sizes.push_back(_decoder::unpack_size(folder));
+        }
+    }
+
+    size_t digest = 0;
+
+    for (const auto& folder : streams.folders) {
+        for (uint64_t i = 0; i < folder.substreams; i++) {
+            bool covered = folder.substreams == 1 && folder.crc_defined;
+            bool defined = covered || (digest < digests_defined.size() && digests_defined[digest]);
+
+            streams.crc_defined.push_back(defined);
+            streams.crcs.push_back(covered ? folder.crc : (defined ? digests[digest] : 0));
+            digest += covered ? 0 : 1;
+        }
+    }
+
+    return (reader.ok && id == ID_END) || fail("corrupt streams info");
+}
+
+// Folders take their packed streams in order, from just past the signature header.
+bool lcl_7z_extractor::place_pack_streams(_streams& streams, uint64_t archive_size) {
+    uint64_t offset = 32 + streams.pack_position;
+    size_t next = 0;
+
+    for (auto& folder : streams.folders) {
+        for (size_t i = 0; i < folder.packed_streams.size(); i++, next++) {
+            if (next >= streams.pack_sizes.size() || offset > archive_size || streams.pack_sizes[next] > archive_size - offset) {
+                return fail("packed stream outside the archive");
+            }
+
+            folder.pack_offsets.push_back(offset);
+            folder.pack_sizes.push_back(streams.pack_sizes[next]);
+            offset += streams.pack_sizes[next];
+        }
+    }
+
+    return true;
+}
+
+static bool read_utf16_name(const unsigned char* data, size_t size, size_t& pos, std::string& name) {
+    for (;;) {
+        if (size - pos < 2) {
+            return false;
+        }
+
+        uint32_t c = data[pos] | (data[pos + 1] << 8);
+        pos += 2;
+
+        if (c == 0) {
+            return true;
+        }
+
+        if (c >= 0xD800 && c < 0xDC00) {
+            if (size - pos < 2) {
+                return false;
+            }
+
+            uint32_t low = data[pos] | (data[pos + 1] << 8);
+            pos += 2;
+
+            if (low < 0xDC00 || low > 0xDFFF) {
+                return false;
+            }
+
+            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        if (c < 0x80) {
+            name.push_back(static_cast<char>(c));
+        } else if (c < 0x800) {
+            name.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            name.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else if (c < 0x10000) {
+            name.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            name.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            name.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        } else {
+            name.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            name.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            name.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            name.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+}
+
+bool lcl_7z_extractor::read_files_info(_reader& reader, _streams& streams) {
+    uint64_t count = reader.number();
+    std::vector<bool> empty_stream;
+    std::vector<bool> empty_file;
+    std::vector<bool> anti;
+    std::vector<uint32_t> attributes;
+    std::vector<bool> has_attributes;
+    size_t empty_count = 0;
+
+    if (!reader.fits(count)) {
+        return fail("corrupt files info");
+    }
+
+    _files.assign(static_cast<size_t>(count), _file{});
+
+    for (;;) {
+        uint64_t type = reader.number();
+
+        if (type == ID_END || !reader.ok) {
+            break;
+        }
+
+        uint64_t size = reader.number();
+        const unsigned char* data = reader.take(size);
+        _reader property{ data, static_cast<size_t>(size) };
+
+        if (!data) {
+            break;
+        }
+
+        switch (type) {
+        case ID_EMPTY_STREAM:
+            empty_stream = property.bits(count);
+            empty_count = static_cast<size_t>(std::count(empty_stream.begin(), empty_stream.end(), true));
+            break;
+        case ID_EMPTY_FILE:
+            empty_file = property.bits(empty_count);
+            break;
+        case ID_ANTI:
+            anti = property.bits(empty_count);
+            break;
+        case ID_NAME: {
+            size_t pos = 1;
+
+            if (property.byte() != 0) {
+                return fail("external file names are not supported");
+            }
+
+            for (auto& file : _files) {
+                if (!read_utf16_name(data, property.size, pos, file.name)) {
+                    return fail("corrupt file names");
+                }
+            }
+            break;
+        }
+        case ID_WIN_ATTRIBUTES: {
+            has_attributes = property.defined(count);
+
+            if (property.byte() != 0) {
+                return fail("external attributes are not supported");
+            }
+
+            for (bool defined : has_attributes) {
+                attributes.push_back(defined ? property.uint32() : 0);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (!property.ok) {
+            return fail("corrupt files info");
+        }
+    }
+
+    size_t empty_index = 0;
+    size_t stream = 0;
+    size_t folder = 0;
+    uint64_t in_folder = 0;
+    std::vector<_file> kept;
+
+    for (size_t i = 0; i < _files.size(); i++) {
+        _file& file = _files[i];
+        bool is_anti = false;
+
+        file.has_stream = i >= empty_stream.size() || !empty_stream[i];
+
+        if (!file.has_stream) {
+            bool is_empty_file = empty_index < empty_file.size() && empty_file[empty_index];
+
+            is_anti = empty_index < anti.size() && anti[empty_index];
+            file.directory = !is_empty_file;
+            empty_index++;
+        }
+
+        if (i < attributes.size() && has_attributes[i]) {
+            file.directory = file.directory || (attributes[i] & ATTRIBUTE_DIRECTORY);
+            file.mode = (attributes[i] & ATTRIBUTE_UNIX_EXTENSION) ? attributes[i] >> 16 : 0;
+        }
+
+        if (file.has_stream) {
+            while (folder < streams.folders.size() && in_folder == streams.folders[folder].substreams) {
+                folder++;
+                in_folder = 0;
+            }
+
+            if (folder == streams.folders.size() || stream >= streams.sizes.size()) {
+                return fail("more files than streams");
+            }
+
+            file.size = streams.sizes[stream];
+            file.crc_defined = streams.crc_defined[stream];
+            file.crc = streams.crcs[stream];
+            streams.folders[folder].files.push_back(kept.size());
+            stream++;
+            in_folder++;
+        }
+
+        // Anti items only mark deletions in update archives, there is nothing to extract.
+        if (!is_anti) {
+            kept.push_back(std::move(file));
+        }
+    }
+
+    _files = std::move(kept);
+    return true;
+}
+
+bool lcl_7z_extractor::read_archive(std::ifstream& in) {
+    std::error_code ec;
+    uint64_t archive_size = std::filesystem::file_size(_archive, ec);
+    unsigned char start[32];
+
+    if (ec || !in.read(reinterpret_cast<char*>(start), sizeof(start)) || std::memcmp(start, SIGNATURE, sizeof(SIGNATURE)) != 0) {
+        return fail("not a 7z archive");
+    }
+
+    if (libdeflate_crc32(0, start + 12, 20) != read_le32(start + 8)) {
+        return fail("corrupt 7z start header");
+    }
+
+    uint64_t header_offset = read_le64(start + 12);
+    uint64_t header_size = read_le64(start + 20);
+
+    if (header_offset > archive_size - 32 || header_size > archive_size - 32 - header_offset || header_size > MAX_HEADER_SIZE) {
+        return fail("7z header outside the archive");
+    }
+
+    std::vector<char> header(static_cast<size_t>(header_size));
+
+    in.seekg(static_cast<std::streamoff>(32 + header_offset));
+
+    if (!in.read(header.data(), static_cast<std::streamsize>(header.size())) ||
+        libdeflate_crc32(0, header.data(), header.size()) != read_le32(start + 28)) {
+        return fail("corrupt 7z header");
+    }
+
+    for (;;) {
+        _reader reader{ reinterpret_cast<const unsigned char*>(header.data()), header.size() };
+        uint64_t id = reader.number();
+
+        // Archives made by 7-Zip compress their header too, it is unpacked like any other folder.
+        if (id == ID_ENCODED_HEADER) {
+            _streams streams;
+            std::vector<char> decoded;
+
+            if (!read_streams_info(reader, streams) || !place_pack_streams(streams, archive_size)) {
+                return false;
+            }
+
+            if (streams.folders.empty() || !decode_to_memory(in, streams.folders[0], decoded)) {
+                return _failed || fail("could not unpack the 7z header");
+            }
+
+            header = std::move(decoded);
+            continue;
+        }
+
+        if (id != ID_HEADER) {
+            return fail("corrupt 7z header");
+        }
+
+        _streams streams;
+        id = reader.number();
+
+        if (id == ID_ARCHIVE_PROPERTIES) {
+            while (reader.ok && reader.number() != ID_END) {
+                reader.take(reader.number());
+            }
+
+            id = reader.number();
+        }
+
+        if (id == ID_ADDITIONAL_STREAMS_INFO) {
+            _streams additional;
+
+            if (!read_streams_info(reader, additional)) {
+                return false;
+            }
+
+            id = reader.number();
+        }
+
+        if (id == ID_MAIN_STREAMS_INFO) {
+            if (!read_streams_info(reader, streams) || !place_pack_streams(streams, archive_size)) {
+                return false;
+            }
+
+            id = reader.number();
+        }
+
+        if (id == ID_FILES_INFO) {
+            if (!read_files_info(reader, streams)) {
+                return false;
+            }
+
+            id = reader.number();
+        }
+
+        if (!reader.ok || id != ID_END) {
+            return fail("corrupt 7z header");
+        }
+
+        _folders = std::move(streams.folders);
+        return true;
+    }
+}
+
+bool lcl_7z_extractor::decode_to_memory(std::ifstream& in, const _folder& folder, std::vector<char>& output) {
+    _decoder decoder{ in, folder };
+    uint64_t size = _decoder::unpack_size(folder);
+    auto source = decoder.open_out(_decoder::main_out(folder));
+    size_t filled = 0;
+
+    if (!source) {
+        return fail(decoder.error);
+    }
+
+    if (size > MAX_HEADER_SIZE) {
+        return fail("7z header too large");
+    }
+
+    output.resize(static_cast<size_t>(size));
+
+    while (filled < output.size()) {
+        size_t got;
+
+        if (!source->read(reinterpret_cast<unsigned char*>(output.data()) + filled, output.size() - filled, got) || got == 0) {
+            return fail("corrupt 7z header");
+        }
+
+        filled += got;
+    }
+
+    return !folder.crc_defined || libdeflate_crc32(0, output.data(), output.size()) == folder.crc || fail("CRC mismatch in the 7z header");
+}
+
+// Folder paths, flattened like the zip extractor does it. Empty files need no decoding and are
+// created here, the threads only handle files with data.
+bool lcl_7z_extractor::plan() {
+    std::vector<std::string> names;
+    std::vector<bool> directories;
+    std::vector<std::filesystem::path> paths;
+    std::string error;
+    std::error_code ec;
+
+    for (const auto& file : _files) {
+        names.push_back(file.name);
+        directories.push_back(file.directory);
+    }
+
+    if (!lcl_layout_entries(names, directories, _target, paths, error)) {
+        return fail(error);
+    }
+
+    for (size_t i = 0; i < _files.size(); i++) {
+        _file& file = _files[i];
+
+        file.path = std::move(paths[i]);
+
+        if (file.has_stream || file.directory || file.path.empty()) {
+            continue;
+        }
+
+        std::filesystem::remove_all(file.path, ec);
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+
+        if (!out.is_open()) {
+            return fail("could not create " + file.path.string());
+        }
+
+        _extracted_files++;
+    }
+
+    return true;
+}
+
+bool lcl_7z_extractor::extract_folder(std::ifstream& in, const _folder& folder) {
+    _decoder decoder{ in, folder };
+    auto source = decoder.open_out(_decoder::main_out(folder));
+    std::vector<unsigned char> buffer(CHUNK_SIZE);
+    std::error_code ec;
+
+    if (!source) {
+        return fail(decoder.error);
+    }
+
+    for (size_t index : folder.files) {
+        _file& file = _files[index];
+#ifdef _WIN32
+        bool link = false;
+#else
+        bool link = (file.mode & MODE_TYPE) == MODE_SYMLINK;
+#endif
+        std::ofstream out;
+        uint64_t remaining = file.size;
+        uint32_t crc = 0;
+
+        // Replaced instead of written through, as in the zip extractor.
+        if (!file.path.empty()) {
+            std::filesystem::remove_all(file.path, ec);
+
+            if (!link) {
+                out.open(file.path, std::ios::binary | std::ios::trunc);
+
+                if (!out.is_open()) {
+                    return fail("could not create " + file.path.string());
+                }
+            }
+        }
+
+        while (remaining > 0) {
+            size_t got;
+
+            if (_failed) {
+                return false;
+            }
+
+            if (!source->read(buffer.data(), static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size())), got) || got == 0) {
+                return fail("corrupt data in " + file.name);
+            }
+
+            crc = libdeflate_crc32(crc, buffer.data(), got);
+            remaining -= got;
+
+            if (link) {
+                file.link_target.append(reinterpret_cast<const char*>(buffer.data()), got);
+            } else if (out.is_open()) {
+                out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(got));
+            }
+        }
+
+        if (out.is_open()) {
+            out.close();
+
+            if (out.fail()) {
+                return fail("could not write " + file.path.string());
+            }
+        }
+
+        if (file.crc_defined && crc != file.crc) {
+            return fail("CRC mismatch for " + file.name);
+        }
+
+        // Created by run() once every folder is written.
+        if (link && !file.path.empty() && file.link_target.empty()) {
+            return fail("empty symlink " + file.name);
+        }
+
+#ifndef _WIN32
+        if (!link && !file.path.empty() && (file.mode & 0777) != 0) {
+            std::filesystem::permissions(file.path, static_cast<std::filesystem::perms>(file.mode & 0777), ec);
+        }
+#endif
+
+        _extracted_files++;
+        _bytes += file.size;
+    }
+
+    return true;
+}
+
+bool lcl_7z_extractor::run() {
+    auto started = std::chrono::steady_clock::now();
+    std::vector<size_t> order;
+
+    {
+        std::ifstream in(_archive, std::ios::binary);
+
+        if (!in.is_open()) {
+            return fail("could not open " + _archive.string());
+        }
+
+        if (!read_archive(in) || !plan()) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < _folders.size(); i++) {
+        if (!_folders[i].files.empty()) {
+            order.push_back(i);
+        }
+    }
+
+    // Largest folders first, a solid archive is a single folder and gets a single thread.
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return _decoder::unpack_size(_folders[a]) > _decoder::unpack_size(_folders[b]);
+    });
+
+    unsigned threads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_THREADS);
+    threads = static_cast<unsigned>(std::clamp<size_t>(order.size(), 1, threads));
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            std::ifstream in(_archive, std::ios::binary);
+
+            if (!in.is_open()) {
+                fail("could not open " + _archive.string());
+            }
+
+            while (!_failed) {
+                size_t i = next++;
+
+                if (i >= order.size() || !extract_folder(in, _folders[order[i]])) {
+                    break;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (_failed) {
+        return false;
+    }
+
+    // Links come last and in archive order: no thread ever writes through one.
+    for (const auto& file : _files) {
+        std::string error;
+
+        if (!file.link_target.empty() && !file.path.empty() &&
+            !lcl_create_entry_link(_target, file.path.lexically_relative(_target), file.link_target, error)) {
+            return fail(error);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    uint64_t bytes = _bytes;
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Extracted %llu files (%llu bytes) from %zu 7z folders in %.2f s with %u threads (%.1f MB/s).\n",
+        static_cast<unsigned long long>(_extracted_files.load()), static_cast<unsigned long long>(bytes), order.size(),
+        seconds, threads, seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+
+    return true;
+}
@@ -0,0 +1,290 @@
+#include "lcl_cache.hpp"
+#include "lcl_sha256.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+using json = nlohmann::json;
+
+extern retro_log_printf_t log_cb;
+
+static long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Objects are named after the sha256 of their content.
+static bool is_object_name(const std::string& name) {
+    return name.size() == 64 && std::all_of(name.begin(), name.end(), [](unsigned char c) {
+        return std::isdigit(c) || (c >= 'a' && c <= 'f');
+    });
+}
+
+// Hard link when source and target share a filesystem, a copy otherwise.
+static bool link_or_copy(const std::filesystem::path& source, const std::filesystem::path& target) {
+    std::error_code ec;
+
+    std::filesystem::remove(target, ec);
+    std::filesystem::create_hard_link(source, target, ec);
+
+    if (ec) {
+        ec.clear();
+        std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing, ec);
+    }
+
+    return !ec;
+}
+
+lcl_archive_cache::lcl_archive_cache(std::filesystem::path root, unsigned long long max_bytes)
+    : _root(std::move(root)), _max_bytes(max_bytes) {
+    _index_path = _root / "index.json";
+}
+
+bool lcl_archive_cache::lock(lcl_file_lock& lock) {
+    if (!lock.acquire(_root / ".lock", LOCK_WAIT)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Archive cache is busy, skipping it.\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Called with the lock held.
+bool lcl_archive_cache::load() {
+    std::ifstream in(_index_path);
+
+    _index = in.is_open() ? json::parse(in, nullptr, false) : json();
+
+    if (!_index.is_object()) {
+        _index = json::object();
+    }
+
+    for (const char* key : { "entries", "urls" }) {
+        if (!_index[key].is_object()) {
+            _index[key] = json::object();
+        }
+    }
+
+    for (const char* key : { "hits", "misses", "bytes_saved" }) {
+        if (!_index[key].is_number_unsigned()) {
+            _index[key] = 0ULL;
+        }
+    }
+
+    adopt_objects();
+
+    return true;
+}
+
+// Archives the index lost track of (an index write that never happened, a deleted index.json)
+// still take space: they are listed again as never used, so they are the first evicted.
+// Temporary files only exist while their writer holds the lock, any found here are leftovers.
+void lcl_archive_cache::adopt_objects() {
+    std::error_code ec;
+    std::vector<std::filesystem::path> leftovers;
+
+    for (const auto& entry : std::filesystem::directory_iterator(_root, ec)) {
+        auto name = entry.path().filename().string();
+
+        if (name.ends_with(".tmp")) {
+            leftovers.push_back(entry.path());
+        } else if (is_object_name(name) && entry.is_regular_file(ec) && !_index["entries"].contains(name)) {
+            _index["entries"][name] = { { "size", entry.file_size(ec) }, { "last_used", 0 }, { "name", name } };
+        }
+    }
+
+    for (const auto& leftover : leftovers) {
+        std::filesystem::remove(leftover, ec);
+    }
+}
+
+// Written next to the index and renamed over it, a crash never leaves half an index behind.
+bool lcl_archive_cache::save() {
+    std::error_code ec;
+    auto temp = _index_path;
+
+    temp += ".tmp";
+    std::filesystem::create_directories(_root, ec);
+
+    {
+        std::ofstream out(temp, std::ios::trunc);
+
+        if (!out.is_open() || !(out << _index.dump())) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, _index_path, ec);
+
+    return !ec;
+}
+
+std::string lcl_archive_cache::lookup(const std::string& digest, const std::string& url) const {
+    if (!digest.empty()) {
+        return _index.at("entries").contains(digest) ? digest : "";
+    }
+
+    return _index.at("urls").value(url, "");
+}
+
+void lcl_archive_cache::forget(const std::string& hash) {
+    auto& urls = _index["urls"];
+
+    _index["entries"].erase(hash);
+
+    for (auto it = urls.begin(); it != urls.end();) {
+        it = it.value() == hash ? urls.erase(it) : std::next(it);
+    }
+}
+
+bool lcl_archive_cache::fetch(const std::string& digest, const std::string& url, const std::filesystem::path& target) {
+    lcl_file_lock cache_lock;
+
+    if (!enabled() || !lock(cache_lock)) {
+        return false;
+    }
+
+    load();
+
+    std::string hash = lookup(lcl_sha256::from_digest(digest), url);
+    auto object = _root / hash;
+    std::string actual;
+    std::error_code ec;
+
+    // Checked before every use, a damaged archive is dropped instead of installed.
+    bool usable = !hash.empty() && std::filesystem::exists(object, ec) &&
+        lcl_sha256::file(object.string(), actual) && actual == hash;
+
+    if (!usable && !hash.empty()) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Cached archive %s is missing or damaged, dropping it.\n", hash.c_str());
+        std::filesystem::remove(object, ec);
+        forget(hash);
+    }
+
+    if (!usable || !link_or_copy(object, target)) {
+        _index["misses"] = _index["misses"].get<unsigned long long>() + 1;
+        save();
+
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Archive cache miss (%llu hits, %llu misses).\n",
+            _index["hits"].get<unsigned long long>(), _index["misses"].get<unsigned long long>());
+        return false;
+    }
+
+    auto& entry = _index["entries"][hash];
+    unsigned long long size = entry.value("size", 0ULL);
+
+    entry["last_used"] = unix_now();
+    _index["hits"] = _index["hits"].get<unsigned long long>() + 1;
+    _index["bytes_saved"] = _index["bytes_saved"].get<unsigned long long>() + size;
+    save();
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Archive cache hit: %s (%llu bytes, %llu hits, %llu misses, %llu bytes saved).\n",
+        entry.value("name", hash).c_str(), size, _index["hits"].get<unsigned long long>(),
+        _index["misses"].get<unsigned long long>(), _index["bytes_saved"].get<unsigned long long>());
+
+    return true;
+}
+
+bool lcl_archive_cache::store(const std::filesystem::path& file, const std::string& digest, const std::string& url) {
+    if (!enabled()) {
+        return false;
+    }
+
+    std::error_code ec;
+    std::string hash = lcl_sha256::from_digest(digest);
+    unsigned long long size = std::filesystem::file_size(file, ec);
+
+    // Without a published digest the archive is hashed here, it still gets a content address.
+    if (ec || (hash.empty() && !lcl_sha256::file(file.string(), hash))) {
+        return false;
+    }
+
+    if (size > _max_bytes) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] %s is larger than the archive cache, not cached.\n", file.filename().string().c_str());
+        return false;
+    }
+
+    lcl_file_lock cache_lock;
+
+    if (!lock(cache_lock)) {
+        return false;
+    }
+
+    load();
+
+    auto object = _root / hash;
+
+    if (!std::filesystem::exists(object, ec)) {
+        auto temp = object;
+
+        temp += ".tmp";
+        std::filesystem::create_directories(_root, ec);
+
+        if (!link_or_copy(file, temp)) {
+            std::filesystem::remove(temp, ec);
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not add %s to the archive cache.\n", file.string().c_str());
+            return false;
+        }
+
+        std::filesystem::rename(temp, object, ec);
+
+        if (ec) {
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+    _index["entries"][hash] = { { "size", size }, { "last_used", unix_now() }, { "name", file.filename().string() } };
+
+    if (!url.empty()) {
+        _index["urls"][url] = hash;
+    }
+
+    evict(hash);
+    save();
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Cached archive %s as %s.\n", file.filename().string().c_str(), hash.c_str());
+
+    return true;
+}
+
+// Least recently used first, until everything fits under the cap again.
+void lcl_archive_cache::evict(const std::string& keep) {
+    unsigned long long total = 0;
+
+    for (const auto& [hash, entry] : _index["entries"].items()) {
+        total += entry.value("size", 0ULL);
+    }
+
+    while (total > _max_bytes) {
+        std::string oldest;
+        long long oldest_use = 0;
+
+        for (const auto& [hash, entry] : _index["entries"].items()) {
+            long long used = entry.value("last_used", 0LL);
+
+            if (hash != keep && (oldest.empty() || used < oldest_use)) {
+                oldest = hash;
+                oldest_use = used;
+            }
+        }
+
+        if (oldest.empty()) {
+            break;
+        }
+
+        std::error_code ec;
+        unsigned long long size = _index["entries"][oldest].value("size", 0ULL);
+
+        std::filesystem::remove(_root / oldest, ec);
+        forget(oldest);
+        total -= std::min(total, size);
+
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Evicted %s from the archive cache (%llu bytes).\n", oldest.c_str(), size);
+    }
+}
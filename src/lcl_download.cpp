@@ -0,0 +1,899 @@
+#include "lcl_download.hpp"
+#include "lcl_net.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+extern retro_log_printf_t log_cb;
+
+// libcurl callback, the probe only needs the headers. A server answering the one byte range
+// with the whole file is cut off right away.
+static size_t ProbeCallback(void* contents, size_t size, size_t nmemb, void* userdata) {
+    long responseCode = 0;
+
+    curl_easy_getinfo(static_cast<CURL*>(userdata), CURLINFO_RESPONSE_CODE, &responseCode);
+
+    return responseCode == 206 ? size * nmemb : 0;
+}
+
+bool lcl_seek_file(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// Client errors won't go away by asking again, timeouts, throttling and server errors might.
+static bool is_retryable_status(long responseCode) {
+    return responseCode < 400 || responseCode == 408 || responseCode == 429 || responseCode >= 500;
+}
+
+static bool is_http_url(const std::string& url) {
+    std::string scheme = url.substr(0, url.find("://"));
+
+    std::transform(scheme.begin(), scheme.end(), scheme.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    return scheme == "http" || scheme == "https";
+}
+
+lcl_downloader::lcl_downloader(std::string url, std::string target, const lcl_download_options& options, const std::atomic<bool>& cancel)
+    : _url(std::move(url)), _target(std::move(target)), _options(options), _cancel(cancel) {
+    _part_path = _target + ".part";
+    _meta_path = _target + ".part.json";
+    _total_size = 0;
+    _ranges = false;
+    _hashed = 0;
+    _output = nullptr;
+}
+
+void lcl_downloader::expect_sha256(const std::string& digest) {
+    _expected_sha256 = lcl_sha256::from_digest(digest);
+}
+
+size_t lcl_downloader::write_segment(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* segment = static_cast<_segment*>(userdata);
+    size_t totalSize = size * nmemb;
+
+    // A server ignoring the range would overwrite the neighbouring segment.
+    if (segment->written + static_cast<curl_off_t>(totalSize) > segment->last - segment->first + 1) {
+        return 0;
+    }
+
+    size_t stored = fwrite(data, 1, totalSize, segment->file);
+    lcl_downloader* owner = segment->owner;
+
+    // Only the segment right at the hash position can feed the hash directly.
+    if (!owner->_expected_sha256.empty() && segment->first + segment->written == owner->_hashed) {
+        owner->_hash.update(data, stored);
+        owner->_hashed += static_cast<curl_off_t>(stored);
+    }
+
+    segment->written += static_cast<curl_off_t>(stored);
+
+    return stored;
+}
+
+size_t lcl_downloader::write_single(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* self = static_cast<lcl_downloader*>(userdata);
+    size_t stored = fwrite(data, 1, size * nmemb, self->_output);
+
+    if (!self->_expected_sha256.empty()) {
+        self->_hash.update(data, stored);
+        self->_hashed += static_cast<curl_off_t>(stored);
+    }
+
+    return stored;
+}
+
+static int CancelCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    return static_cast<const std::atomic<bool>*>(clientp)->load() ? 1 : 0;
+}
+
+// Connection and stall limits, a dead CDN connection fails instead of hanging the launch.
+void lcl_apply_transfer_limits(CURL* curl, const lcl_download_options& options, const std::atomic<bool>& cancel) {
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, options.low_speed_limit);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, options.low_speed_limit > 0 ? options.low_speed_time : 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, CancelCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, const_cast<std::atomic<bool>*>(&cancel));
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+}
+
+void lcl_downloader::apply_limits(CURL* curl) {
+    lcl_apply_transfer_limits(curl, _options, _cancel);
+}
+
+// One byte request telling whether ranges work, how large the asset is and which ETag it has.
+// Repeated before every attempt, it also refreshes the signed CDN url github redirects to.
+lcl_downloader::_attempt lcl_downloader::probe(CURL* curl, CURLcode& res) {
+    lcl_http_headers responseHeaders;
+    long responseCode = 0;
+    char* effective_url = nullptr;
+
+    // Local files (PROVIDER=file) have no status line to probe, they are read in one stream.
+    if (!is_http_url(_url)) {
+        _effective_url = _url;
+        _etag.clear();
+        _ranges = false;
+        _total_size = 0;
+        res = CURLE_OK;
+        return _attempt::DONE;
+    }
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(curl, CURLOPT_URL, _url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_RANGE, "0-0");
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ProbeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, curl);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lcl_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+    apply_limits(curl);
+
+    res = lcl_net::instance().perform(curl, "probe");
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+    _effective_url = effective_url ? effective_url : _url;
+
+    curl_slist_free_all(headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_RANGE, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, nullptr);
+
+    if (responseCode >= 400) {
+        res = CURLE_HTTP_RETURNED_ERROR;
+        return is_retryable_status(responseCode) ? _attempt::RETRY : _attempt::FATAL;
+    }
+
+    // The write callback cuts off a 200 answer on purpose. A body without any response code
+    // came over a protocol that is not HTTP: no ranges, a single stream.
+    if (res != CURLE_OK && !(res == CURLE_WRITE_ERROR && (responseCode == 200 || responseCode == 0))) {
+        return _cancel.load() ? _attempt::FATAL : _attempt::RETRY;
+    }
+
+    _etag = responseHeaders.count("etag") ? responseHeaders["etag"] : "";
+    _ranges = false;
+    _total_size = 0;
+
+    if (responseCode == 206 && responseHeaders.count("content-range")) {
+        // "bytes 0-0/123456"
+        const std::string& content_range = responseHeaders["content-range"];
+        size_t slash = content_range.rfind('/');
+
+        if (slash != std::string::npos && content_range.compare(slash + 1, std::string::npos, "*") != 0) {
+            _total_size = std::strtoll(content_range.c_str() + slash + 1, nullptr, 10);
+            _ranges = _total_size > 0;
+        }
+    } else if (responseHeaders.count("content-length")) {
+        _total_size = std::strtoll(responseHeaders["content-length"].c_str(), nullptr, 10);
+    }
+
+    res = CURLE_OK;
+    return _attempt::DONE;
+}
+
+// Split the asset in ranges of at least MIN_SEGMENT_SIZE, nothing is planned when one stream will do.
+void lcl_downloader::plan_segments() {
+    int count = static_cast<int>(std::min<curl_off_t>(std::min(_options.segments, MAX_SEGMENTS),
+        (_total_size + MIN_SEGMENT_SIZE - 1) / MIN_SEGMENT_SIZE));
+
+    _parts.clear();
+
+    if (count < 2) {
+        return;
+    }
+
+    curl_off_t segment_size = _total_size / count;
+    _parts.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        _parts[i].first = i * segment_size;
+        _parts[i].last = i == count - 1 ? _total_size - 1 : (i + 1) * segment_size - 1;
+    }
+
+    if (!preallocate()) {
+        std::error_code ec;
+
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not preallocate %s, downloading in one stream.\n", _part_path.c_str());
+        std::filesystem::remove(_part_path, ec);
+        _parts.clear();
+    }
+}
+
+// Reserve the whole file up front, segments then write into place without growing it.
+bool lcl_downloader::preallocate() {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(_part_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    size.QuadPart = _total_size;
+    bool ok = SetFilePointerEx(file, size, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    CloseHandle(file);
+
+    return ok;
+#else
+    int fd = open(_part_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // Filesystems without fallocate support still get a sparse file of the right size.
+    bool ok = posix_fallocate(fd, 0, static_cast<off_t>(_total_size)) == 0 ||
+        ftruncate(fd, static_cast<off_t>(_total_size)) == 0;
+    close(fd);
+
+    return ok;
+#endif
+}
+
+bool lcl_downloader::start_segment(_segment& segment) {
+    segment.owner = this;
+    segment.file = fopen(_part_path.c_str(), "r+b");
+    segment.curl = lcl_net::instance().easy();
+
+    if (!segment.file || !segment.curl || !lcl_seek_file(segment.file, segment.first + segment.written)) {
+        return false;
+    }
+
+    std::string range = std::format("{}-{}", segment.first + segment.written, segment.last);
+
+    segment.headers = curl_slist_append(segment.headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(segment.curl, CURLOPT_URL, _effective_url.c_str());
+    curl_easy_setopt(segment.curl, CURLOPT_HTTPHEADER, segment.headers);
+    curl_easy_setopt(segment.curl, CURLOPT_RANGE, range.c_str());
+    curl_easy_setopt(segment.curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(segment.curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(segment.curl, CURLOPT_WRITEFUNCTION, write_segment);
+    curl_easy_setopt(segment.curl, CURLOPT_WRITEDATA, &segment);
+    curl_easy_setopt(segment.curl, CURLOPT_PRIVATE, &segment);
+    apply_limits(segment.curl);
+
+    return true;
+}
+
+void lcl_downloader::close_segment(_segment& segment) {
+    if (segment.file) {
+        fclose(segment.file);
+        segment.file = nullptr;
+    }
+
+    if (segment.curl) {
+        curl_easy_cleanup(segment.curl);
+        segment.curl = nullptr;
+    }
+
+    curl_slist_free_all(segment.headers);
+    segment.headers = nullptr;
+}
+
+lcl_downloader::_attempt lcl_downloader::download_segments(CURLcode& res) {
+    CURLM* multi = curl_multi_init();
+    auto last_save = std::chrono::steady_clock::now();
+    bool ok = multi != nullptr;
+
+    // One connection per segment, multiplexing them over a single HTTP/2 stream defeats the purpose.
+    if (multi) {
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+    }
+
+    for (auto& segment : _parts) {
+        if (!ok || segment.written == segment.last - segment.first + 1) {
+            continue;
+        }
+
+        if (!start_segment(segment)) {
+            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to open file: %s\n", _part_path.c_str());
+            ok = false;
+            break;
+        }
+
+        curl_multi_add_handle(multi, segment.curl);
+    }
+
+    res = CURLE_OK;
+    int running = ok ? 1 : 0;
+
+    // Failed segments stop on their own, the others keep going and only the rest is retried.
+    while (running > 0) {
+        if (_cancel.load()) {
+            res = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+
+        if (curl_multi_perform(multi, &running) != CURLM_OK) {
+            res = CURLE_FAILED_INIT;
+            break;
+        }
+
+        CURLMsg* message;
+        int queued;
+
+        while ((message = curl_multi_info_read(multi, &queued))) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            _segment* segment = nullptr;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&segment));
+            lcl_net::instance().finished(message->easy_handle, "segment", message->data.result);
+
+            if (message->data.result != CURLE_OK || segment->written != segment->last - segment->first + 1) {
+                log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Segment %lld-%lld stopped at %lld bytes: %s\n",
+                    static_cast<long long>(segment->first), static_cast<long long>(segment->last),
+                    static_cast<long long>(segment->written), curl_easy_strerror(message->data.result));
+                res = message->data.result != CURLE_OK ? message->data.result : CURLE_PARTIAL_FILE;
+            }
+
+            curl_multi_remove_handle(multi, segment->curl);
+            close_segment(*segment);
+        }
+
+        // Segments ahead of the hash position are read back from disk a slice at a time.
+        advance_hash(HASH_CATCH_UP);
+
+        // Keep the resume point recent in case the process goes away without a clean shutdown.
+        if (std::chrono::steady_clock::now() - last_save > std::chrono::seconds(5)) {
+            for (auto& segment : _parts) {
+                if (segment.file) fflush(segment.file);
+            }
+
+            save_progress();
+            last_save = std::chrono::steady_clock::now();
+        }
+
+        if (running > 0) {
+            curl_multi_poll(multi, nullptr, 0, 250, nullptr);
+        }
+    }
+
+    bool complete = ok;
+
+    for (auto& segment : _parts) {
+        complete = complete && segment.written == segment.last - segment.first + 1;
+
+        if (multi && segment.curl) {
+            curl_multi_remove_handle(multi, segment.curl);
+        }
+
+        close_segment(segment);
+    }
+
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
+
+    if (complete) {
+        res = CURLE_OK;
+        return _attempt::DONE;
+    }
+
+    return !ok || _cancel.load() ? _attempt::FATAL : _attempt::RETRY;
+}
+
+lcl_downloader::_attempt lcl_downloader::download_single(CURL* curl, CURLcode& res) {
+    std::error_code ec;
+    curl_off_t offset = 0;
+    long responseCode = 0;
+
+    // Continue after the bytes already on disk when the server can serve the rest.
+    if (_ranges && std::filesystem::exists(_part_path, ec)) {
+        offset = static_cast<curl_off_t>(std::filesystem::file_size(_part_path, ec));
+        offset = ec || offset > _total_size ? 0 : offset;
+    }
+
+    if (_ranges && offset == _total_size) {
+        return _attempt::DONE;
+    }
+
+    // The hash has to cover exactly the bytes before the resume point.
+    if (!_expected_sha256.empty() && offset != _hashed) {
+        if (offset < _hashed) {
+            reset_hash();
+        }
+
+        if (!hash_from_disk(offset)) {
+            reset_hash();
+            offset = 0;
+        }
+    }
+
+    _output = fopen(_part_path.c_str(), offset > 0 ? "ab" : "wb");
+
+    if (!_output) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to open file: %s\n", _part_path.c_str());
+        return _attempt::FATAL;
+    }
+
+    if (offset > 0) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Resuming download at byte %lld of %lld.\n",
+            static_cast<long long>(offset), static_cast<long long>(_total_size));
+    }
+
+    struct curl_slist* download_headers = nullptr;
+    download_headers = curl_slist_append(download_headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, download_headers);
+    curl_easy_setopt(curl, CURLOPT_URL, _effective_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_single);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, offset);
+    apply_limits(curl);
+
+    res = lcl_net::instance().perform(curl, "download");
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_slist_free_all(download_headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_RESUME_FROM_LARGE, static_cast<curl_off_t>(0));
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 0L);
+    fclose(_output);
+    _output = nullptr;
+
+    if (res == CURLE_OK) {
+        auto size = static_cast<curl_off_t>(std::filesystem::file_size(_part_path, ec));
+
+        if (_total_size > 0 && size != _total_size) {
+            res = CURLE_PARTIAL_FILE;
+            return _attempt::RETRY;
+        }
+
+        _total_size = ec ? _total_size : size;
+        return _attempt::DONE;
+    }
+
+    // The server refused to resume after all, start over from byte zero.
+    if (res == CURLE_RANGE_ERROR) {
+        _ranges = false;
+        return _attempt::RETRY;
+    }
+
+    // A local file that is not there won't show up by asking again.
+    if (res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_FILE_COULDNT_READ_FILE || !is_retryable_status(responseCode)) {
+        return _attempt::FATAL;
+    }
+
+    return _attempt::RETRY;
+}
+
+// Picks up a download an earlier attempt or launch left behind, as long as it is the same url.
+bool lcl_downloader::load_progress() {
+    std::ifstream metaIn(_meta_path);
+    std::error_code ec;
+
+    if (!metaIn.is_open() || !std::filesystem::exists(_part_path, ec)) {
+        return false;
+    }
+
+    json meta = json::parse(metaIn, nullptr, false);
+
+    if (!meta.is_object() || meta.value("url", "") != _url) {
+        return false;
+    }
+
+    _total_size = meta.value("size", static_cast<curl_off_t>(0));
+    _etag = meta.value("etag", "");
+    _ranges = meta.value("ranges", false);
+    _parts.clear();
+
+    for (const auto& entry : meta.value("segments", json::array())) {
+        _segment segment;
+
+        if (!entry.is_array() || entry.size() != 3) {
+            _parts.clear();
+            return false;
+        }
+
+        segment.first = entry[0].get<curl_off_t>();
+        segment.last = entry[1].get<curl_off_t>();
+        segment.written = entry[2].get<curl_off_t>();
+
+        if (segment.first > segment.last || segment.last >= _total_size ||
+            segment.written < 0 || segment.written > segment.last - segment.first + 1) {
+            _parts.clear();
+            return false;
+        }
+
+        _parts.push_back(segment);
+    }
+
+    // Segments write into a preallocated file, anything else means it was replaced meanwhile.
+    if (!_parts.empty() && static_cast<curl_off_t>(std::filesystem::file_size(_part_path, ec)) != _total_size) {
+        _parts.clear();
+        return false;
+    }
+
+    return true;
+}
+
+void lcl_downloader::save_progress() {
+    json segments = json::array();
+
+    for (const auto& segment : _parts) {
+        segments.push_back({ segment.first, segment.last, segment.written });
+    }
+
+    json meta = {
+        { "url", _url },
+        { "size", _total_size },
+        { "etag", _etag },
+        { "ranges", _ranges },
+        { "segments", segments }
+    };
+
+    std::ofstream metaOut(_meta_path, std::ios::trunc);
+
+    if (metaOut.is_open()) {
+        metaOut << meta.dump();
+    }
+}
+
+void lcl_downloader::discard_progress() {
+    std::error_code ec;
+
+    std::filesystem::remove(_part_path, ec);
+    std::filesystem::remove(_meta_path, ec);
+    _parts.clear();
+    reset_hash();
+}
+
+void lcl_downloader::reset_hash() {
+    _hash.reset();
+    _hashed = 0;
+}
+
+// Feeds the part file from the hash position up to until into the hash.
+bool lcl_downloader::hash_from_disk(curl_off_t until) {
+    if (until <= _hashed) {
+        return true;
+    }
+
+    FILE* in = fopen(_part_path.c_str(), "rb");
+    std::vector<char> buffer(1024 * 1024);
+    bool ok = in && lcl_seek_file(in, _hashed);
+
+    while (ok && _hashed < until) {
+        size_t wanted = static_cast<size_t>(std::min<curl_off_t>(until - _hashed, static_cast<curl_off_t>(buffer.size())));
+        size_t got = fread(buffer.data(), 1, wanted, in);
+
+        _hash.update(buffer.data(), got);
+        _hashed += static_cast<curl_off_t>(got);
+        ok = got == wanted;
+    }
+
+    if (in) {
+        fclose(in);
+    }
+
+    return ok;
+}
+
+// Moves the hash position through bytes segments already wrote, at most budget bytes per call.
+// Once it reaches the write position of a running segment that segment hashes on its own.
+void lcl_downloader::advance_hash(curl_off_t budget) {
+    if (_expected_sha256.empty()) {
+        return;
+    }
+
+    for (auto& segment : _parts) {
+        if (_hashed > segment.last) {
+            continue;
+        }
+
+        curl_off_t until = std::min(segment.first + segment.written, _hashed + budget);
+
+        if (_hashed < segment.first || until <= _hashed) {
+            return;
+        }
+
+        if (segment.file) {
+            fflush(segment.file);
+        }
+
+        budget -= until - _hashed;
+
+        if (!hash_from_disk(until) || budget <= 0 || _hashed <= segment.last) {
+            return;
+        }
+    }
+}
+
+// Finishes the hash over whatever is left and compares it with the published digest.
+bool lcl_downloader::verify() {
+    if (_expected_sha256.empty()) {
+        return true;
+    }
+
+    std::error_code ec;
+    auto size = static_cast<curl_off_t>(std::filesystem::file_size(_part_path, ec));
+    auto started = std::chrono::steady_clock::now();
+
+    if (ec || !hash_from_disk(size)) {
+        reset_hash();
+        return false;
+    }
+
+    std::string digest = _hash.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    reset_hash();
+
+    if (digest != _expected_sha256) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] SHA-256 mismatch for %s: expected %s, got %s\n",
+            _target.c_str(), _expected_sha256.c_str(), digest.c_str());
+        return false;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] SHA-256 verified (%s, %.3f s after the last byte).\n",
+        lcl_sha256::accelerated() ? "SHA extensions" : "portable", seconds);
+
+    return true;
+}
+
+// Exponential backoff with jitter, 1, 2, 4 ... 60 seconds. False when cancelled meanwhile.
+bool lcl_downloader::wait_backoff(int attempt) {
+    static thread_local std::mt19937 generator{ std::random_device{}() };
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);
+    double delay = std::min(60.0, static_cast<double>(1LL << std::min(attempt - 1, 6))) * jitter(generator);
+    auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(delay);
+
+    log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Download interrupted, retrying in %.1f seconds (attempt %d of %d).\n",
+        delay, attempt, _options.retries);
+
+    while (std::chrono::steady_clock::now() < until) {
+        if (_cancel.load()) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    return !_cancel.load();
+}
+
+bool lcl_downloader::run(CURL* curl, CURLcode& res) {
+    auto started = std::chrono::steady_clock::now();
+    bool resumed = load_progress();
+    std::error_code ec;
+
+    if (resumed) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Found partial download of %s, resuming.\n", _target.c_str());
+    } else {
+        discard_progress();
+    }
+
+    res = CURLE_OK;
+
+    for (int attempt = 0; attempt <= _options.retries; attempt++) {
+        if (attempt > 0 && !wait_backoff(attempt)) {
+            res = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+
+        std::string known_etag = _etag;
+        curl_off_t known_size = _total_size;
+        _attempt result = probe(curl, res);
+
+        if (result == _attempt::FATAL) {
+            break;
+        }
+
+        if (result == _attempt::RETRY) {
+            continue;
+        }
+
+        // A different file behind the same url, the bytes on disk are worthless.
+        if ((resumed || attempt > 0) && (known_size != _total_size || known_etag != _etag)) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Remote file changed, restarting download.\n");
+            discard_progress();
+        }
+
+        if (_ranges && _parts.empty() && !std::filesystem::exists(_part_path, ec)) {
+            plan_segments();
+
+            if (!_parts.empty()) {
+                log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Downloading %lld bytes in %zu segments.\n",
+                    static_cast<long long>(_total_size), _parts.size());
+            }
+        }
+
+        save_progress();
+        result = !_parts.empty() && _ranges ? download_segments(res) : download_single(curl, res);
+
+        // A corrupted copy is thrown away and fetched again from scratch.
+        if (result == _attempt::DONE && !verify()) {
+            discard_progress();
+            res = CURLE_BAD_CONTENT_ENCODING;
+            result = _attempt::RETRY;
+            continue;
+        }
+
+        if (result == _attempt::DONE) {
+            std::filesystem::remove(_target, ec);
+            std::filesystem::rename(_part_path, _target, ec);
+            std::filesystem::remove(_meta_path, ec);
+
+            if (ec) {
+                log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not move %s into place: %s\n", _part_path.c_str(), ec.message().c_str());
+                return false;
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+            log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Downloaded %lld bytes in %.2f s (%.1f MB/s).\n",
+                static_cast<long long>(_total_size), seconds,
+                seconds > 0 ? _total_size / seconds / (1024.0 * 1024.0) : 0.0);
+
+            return true;
+        }
+
+        save_progress();
+
+        if (result == _attempt::FATAL) {
+            break;
+        }
+    }
+
+    log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Download of %s failed: %s\n", _url.c_str(), curl_easy_strerror(res));
+    return false;
+}
+
+lcl_range_fetcher::lcl_range_fetcher(std::string url, FILE* file, const lcl_download_options& options, const std::atomic<bool>& cancel)
+    : _url(std::move(url)), _file(file), _options(options), _cancel(cancel), _curl(nullptr), _started(false), _first(0), _last(0),
+      _position(0), _total_size(0), _received(0), _requests(0) {
+}
+
+void lcl_range_fetcher::expect_size(uint64_t size) {
+    _total_size = size;
+}
+
+// The response must be the range asked for, of a file that kept its size. Anything else,
+// a 200 with the whole file included, ends the transfer.
+bool lcl_range_fetcher::start_range() {
+    long responseCode = 0;
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    unsigned long long total = 0;
+
+    curl_easy_getinfo(_curl, CURLINFO_RESPONSE_CODE, &responseCode);
+
+    auto content_range = _headers.find("content-range");
+
+    // "bytes 1000-1999/123456"
+    if (responseCode != 206 || content_range == _headers.end() ||
+        std::sscanf(content_range->second.c_str(), "bytes %llu-%llu/%llu", &first, &last, &total) != 3 ||
+        first > last || last >= total || (_total_size != 0 && total != _total_size)) {
+        return false;
+    }
+
+    // A suffix request learns where the tail starts from the answer.
+    if (_total_size == 0) {
+        _first = first;
+        _last = last + 1;
+        _total_size = total;
+    }
+
+    if (first != _first || last + 1 != _last || !lcl_seek_file(_file, first)) {
+        return false;
+    }
+
+    _position = first;
+    _started = true;
+
+    return true;
+}
+
+size_t lcl_range_fetcher::write_range(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* self = static_cast<lcl_range_fetcher*>(userdata);
+    size_t total = size * nmemb;
+
+    if (!self->_started && !self->start_range()) {
+        return 0;
+    }
+
+    if (total > self->_last - self->_position || fwrite(data, 1, total, self->_file) != total) {
+        return 0;
+    }
+
+    self->_position += total;
+    self->_received += total;
+
+    return total;
+}
+
+bool lcl_range_fetcher::request(CURL* curl, CURLcode& res, const std::string& range) {
+    char* effective_url = nullptr;
+
+    _curl = curl;
+    _started = false;
+    _headers.clear();
+    _requests++;
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(curl, CURLOPT_URL, _url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_range);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lcl_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &_headers);
+    lcl_apply_transfer_limits(curl, _options, _cancel);
+
+    res = lcl_net::instance().perform(curl, "range");
+
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+
+    if (res == CURLE_OK && effective_url) {
+        _url = effective_url;
+    }
+
+    curl_slist_free_all(headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_RANGE, nullptr);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 0L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, nullptr);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, nullptr);
+    _curl = nullptr;
+
+    return res == CURLE_OK && _started && _position == _last;
+}
+
+bool lcl_range_fetcher::fetch(CURL* curl, CURLcode& res, uint64_t first, uint64_t last) {
+    _first = first;
+    _last = last;
+
+    return first < last && _total_size != 0 && request(curl, res, std::format("{}-{}", first, last - 1));
+}
+
+bool lcl_range_fetcher::fetch_tail(CURL* curl, CURLcode& res, uint64_t size, uint64_t& first) {
+    _total_size = 0;
+
+    if (!request(curl, res, std::format("-{}", size))) {
+        return false;
+    }
+
+    first = _first;
+
+    return true;
+}
@@ -0,0 +1,1585 @@
+#include "lcl_extract.hpp"
+#include "lcl_net.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <system_error>
+#include <thread>
+
+#include <libdeflate.h>
+#include <nlohmann/json.hpp>
+#include <zlib.h>
+
+extern retro_log_printf_t log_cb;
+
+static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static constexpr uint32_t END_OF_CENTRAL_SIGNATURE = 0x06054b50;
+static constexpr uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+static constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+static constexpr uint32_t DESCRIPTOR_SIGNATURE = 0x08074b50;
+
+static constexpr uint16_t FLAG_ENCRYPTED = 0x0001;
+static constexpr uint16_t FLAG_DESCRIPTOR = 0x0008;
+
+static constexpr uint16_t METHOD_STORE = 0;
+static constexpr uint16_t METHOD_DEFLATE = 8;
+
+static constexpr uint16_t HOST_UNIX = 3;
+static constexpr uint32_t MODE_TYPE = 0170000;
+static constexpr uint32_t MODE_SYMLINK = 0120000;
+
+static uint16_t read_le16(const unsigned char* data) {
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static uint32_t read_le32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+        (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static uint64_t read_le64(const unsigned char* data) {
+    return static_cast<uint64_t>(read_le32(data)) | (static_cast<uint64_t>(read_le32(data + 4)) << 32);
+}
+
+bool lcl_safe_entry_path(std::string name, std::filesystem::path& relative) {
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    if (name.empty() || name[0] == '/' || name.find(':') != std::string::npos) {
+        return false;
+    }
+
+    relative = std::filesystem::path(std::u8string(name.begin(), name.end())).lexically_normal();
+
+    for (const auto& part : relative) {
+        if (part == "..") {
+            return false;
+        }
+    }
+
+    return !relative.empty();
+}
+
+bool lcl_safe_link_target(std::string target, const std::filesystem::path& link, std::filesystem::path& relative) {
+    std::replace(target.begin(), target.end(), '\\', '/');
+
+    if (target.empty() || target[0] == '/' || target.find(':') != std::string::npos) {
+        return false;
+    }
+
+    // Created normalized, the system then resolves exactly the path checked here: an inner
+    // "dir/.." left in would follow dir if it is a link itself.
+    relative = std::filesystem::path(std::u8string(target.begin(), target.end())).lexically_normal();
+
+    auto resolved = (link.parent_path() / relative).lexically_normal();
+
+    return !resolved.empty() && *resolved.begin() != "..";
+}
+
+bool lcl_passes_symlink(const std::filesystem::path& root, const std::filesystem::path& relative) {
+    auto path = root;
+    std::error_code ec;
+
+    for (const auto& part : relative.parent_path()) {
+        if (part == ".") {
+            continue;
+        }
+
+        path /= part;
+
+        if (std::filesystem::is_symlink(std::filesystem::symlink_status(path, ec))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool lcl_create_entry_link(const std::filesystem::path& root, const std::filesystem::path& link,
+    const std::string& target, std::string& error) {
+    std::filesystem::path relative;
+    auto path = root / link;
+    std::error_code ec;
+
+    if (!lcl_safe_link_target(target, link, relative)) {
+        error = "unsafe symlink " + link.string();
+        return false;
+    }
+
+    auto resolved = (link.parent_path() / relative).lexically_normal();
+
+    if (lcl_passes_symlink(root, link) || lcl_passes_symlink(root, resolved)) {
+        error = "symlink " + link.string() + " leads through another symlink";
+        return false;
+    }
+
+    // Another entry was written below it, the archive has a folder there.
+    if (std::filesystem::is_directory(std::filesystem::symlink_status(path, ec))) {
+        error = "symlink " + link.string() + " stands where the archive has a folder";
+        return false;
+    }
+
+    std::filesystem::remove(path, ec);
+    std::filesystem::create_symlink(relative, path, ec);
+
+    if (ec) {
+        error = "could not create symlink " + path.string() + ": " + ec.message();
+        return false;
+    }
+
+    return true;
+}
+
+lcl_ring_buffer::lcl_ring_buffer(size_t capacity)
+    : _data(capacity), _head(0), _size(0), _closed(false), _aborted(false), _draining(false) {
+}
+
+bool lcl_ring_buffer::write(const char* data, size_t size) {
+    std::unique_lock<std::mutex> lock(_lock);
+
+    while (size > 0) {
+        _writable.wait(lock, [this]() { return _aborted || _draining || _size < _data.size(); });
+
+        if (_aborted) {
+            return false;
+        }
+
+        if (_draining) {
+            return true;
+        }
+
+        size_t tail = (_head + _size) % _data.size();
+        size_t count = std::min({ size, _data.size() - _size, _data.size() - tail });
+
+        std::memcpy(_data.data() + tail, data, count);
+        _size += count;
+        data += count;
+        size -= count;
+
+        _readable.notify_one();
+    }
+
+    return true;
+}
+
+size_t lcl_ring_buffer::read(char* data, size_t size) {
+    std::unique_lock<std::mutex> lock(_lock);
+
+    _readable.wait(lock, [this]() { return _aborted || _closed || _size > 0; });
+
+    if (_aborted) {
+        return 0;
+    }
+
+    size_t count = std::min({ size, _size, _data.size() - _head });
+
+    std::memcpy(data, _data.data() + _head, count);
+    _head = (_head + count) % _data.size();
+    _size -= count;
+
+    _writable.notify_one();
+
+    return count;
+}
+
+void lcl_ring_buffer::close() {
+    std::lock_guard<std::mutex> lock(_lock);
+    _closed = true;
+    _readable.notify_all();
+}
+
+void lcl_ring_buffer::abort() {
+    std::lock_guard<std::mutex> lock(_lock);
+    _aborted = true;
+    _readable.notify_all();
+    _writable.notify_all();
+}
+
+void lcl_ring_buffer::drain() {
+    std::lock_guard<std::mutex> lock(_lock);
+    _draining = true;
+    _size = 0;
+    _writable.notify_all();
+}
+
+lcl_zip_stream::lcl_zip_stream(lcl_ring_buffer& input, std::filesystem::path destination)
+    : _input(input), _destination(std::move(destination)), _buffer(BUFFER_SIZE), _output(BUFFER_SIZE) {
+    _pos = 0;
+    _end = 0;
+    _files = 0;
+    _bytes = 0;
+}
+
+bool lcl_zip_stream::fail(std::string error) {
+    _error = std::move(error);
+    return false;
+}
+
+bool lcl_zip_stream::fill() {
+    _pos = 0;
+    _end = _input.read(_buffer.data(), _buffer.size());
+
+    return _end > 0;
+}
+
+// Makes sure at least size bytes are buffered without consuming them.
+bool lcl_zip_stream::ensure(size_t size) {
+    if (_end - _pos >= size) {
+        return true;
+    }
+
+    std::memmove(_buffer.data(), _buffer.data() + _pos, _end - _pos);
+    _end -= _pos;
+    _pos = 0;
+
+    while (_end < size) {
+        size_t count = _input.read(_buffer.data() + _end, _buffer.size() - _end);
+
+        if (count == 0) {
+            return false;
+        }
+
+        _end += count;
+    }
+
+    return true;
+}
+
+bool lcl_zip_stream::read_exact(void* data, size_t size) {
+    auto* out = static_cast<char*>(data);
+
+    while (size > 0) {
+        if (_pos == _end && !fill()) {
+            return false;
+        }
+
+        size_t count = std::min(size, _end - _pos);
+
+        std::memcpy(out, _buffer.data() + _pos, count);
+        _pos += count;
+        out += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool lcl_zip_stream::skip(uint64_t size) {
+    while (size > 0) {
+        if (_pos == _end && !fill()) {
+            return false;
+        }
+
+        size_t count = static_cast<size_t>(std::min<uint64_t>(size, _end - _pos));
+        _pos += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool lcl_zip_stream::run() {
+    std::error_code ec;
+
+    std::filesystem::create_directories(_destination, ec);
+
+    if (ec) {
+        return fail("could not create " + _destination.string() + ": " + ec.message());
+    }
+
+    for (;;) {
+        unsigned char signature[4];
+
+        if (!read_exact(signature, sizeof(signature))) {
+            return fail("archive ended before its central directory");
+        }
+
+        switch (read_le32(signature)) {
+        case LOCAL_HEADER_SIGNATURE:
+            if (!extract_entry()) {
+                return false;
+            }
+            break;
+        case CENTRAL_HEADER_SIGNATURE:
+            if (!read_central_entry()) {
+                return false;
+            }
+            break;
+        // Anything after the central directory is of no use here.
+        default:
+            return apply_attributes();
+        }
+    }
+}
+
+// The central directory repeats the local headers plus what they lack: the host and mode.
+bool lcl_zip_stream::read_central_entry() {
+    unsigned char header[42];
+
+    if (!read_exact(header, sizeof(header))) {
+        return fail("truncated central directory");
+    }
+
+    uint16_t made_by = read_le16(header);
+    uint32_t mode = read_le32(header + 34) >> 16;
+    std::string name(read_le16(header + 24), '\0');
+    std::filesystem::path relative;
+
+    if (!read_exact(name.data(), name.size()) || !skip(read_le16(header + 26) + read_le16(header + 28))) {
+        return fail("truncated central directory");
+    }
+
+    if ((made_by >> 8) == HOST_UNIX && mode != 0 && lcl_safe_entry_path(name, relative)) {
+        _modes.emplace_back(relative, mode);
+    }
+
+    return true;
+}
+
+// Files were written plain, symlinks with their target as content. Links are resolved from where
+// they end up, below the single top level folder lcl_move_extracted() will drop.
+bool lcl_zip_stream::apply_attributes() {
+#ifndef _WIN32
+    std::filesystem::path root = _destination;
+    std::vector<std::filesystem::directory_entry> top;
+    std::error_code ec;
+
+    for (const auto& entry : std::filesystem::directory_iterator(_destination, ec)) {
+        top.push_back(entry);
+    }
+
+    if (top.size() == 1 && top[0].is_directory(ec) && !top[0].is_symlink(ec)) {
+        root = top[0].path();
+    }
+
+    for (const auto& [relative, mode] : _modes) {
+        auto path = _destination / relative;
+        auto status = std::filesystem::symlink_status(path, ec);
+
+        if ((mode & MODE_TYPE) == MODE_SYMLINK && std::filesystem::is_regular_file(status)) {
+            std::ifstream in(path, std::ios::binary);
+            std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            std::string error;
+
+            in.close();
+
+            if (!lcl_create_entry_link(root, path.lexically_relative(root), content, error)) {
+                return fail(error);
+            }
+        } else if (std::filesystem::is_regular_file(status) && (mode & 0777) != 0) {
+            std::filesystem::permissions(path, static_cast<std::filesystem::perms>(mode & 0777), ec);
+        }
+    }
+#endif
+
+    return true;
+}
+
+bool lcl_zip_stream::extract_entry() {
+    unsigned char header[26];
+
+    if (!read_exact(header, sizeof(header))) {
+        return fail("truncated local header");
+    }
+
+    uint16_t flags = read_le16(header + 2);
+    uint16_t method = read_le16(header + 4);
+    uint32_t expected_crc = read_le32(header + 10);
+    uint64_t compressed_size = read_le32(header + 14);
+    uint64_t size = read_le32(header + 18);
+    std::string name(read_le16(header + 22), '\0');
+    std::vector<unsigned char> extra(read_le16(header + 24));
+    bool zip64 = false;
+
+    if (!read_exact(name.data(), name.size()) || !read_exact(extra.data(), extra.size())) {
+        return fail("truncated local header");
+    }
+
+    // Sizes over 4 GiB live in the zip64 extra field, uncompressed size first.
+    for (size_t pos = 0; pos + 4 <= extra.size();) {
+        uint16_t id = read_le16(extra.data() + pos);
+        uint16_t length = read_le16(extra.data() + pos + 2);
+        size_t field = pos + 4;
+
+        if (id == 0x0001) {
+            zip64 = true;
+
+            if (size == 0xFFFFFFFF && field + 8 <= extra.size()) {
+                size = read_le64(extra.data() + field);
+                field += 8;
+            }
+
+            if (compressed_size == 0xFFFFFFFF && field + 8 <= extra.size()) {
+                compressed_size = read_le64(extra.data() + field);
+            }
+        }
+
+        pos += 4 + length;
+    }
+
+    if (flags & FLAG_ENCRYPTED) {
+        return fail("encrypted entry " + name);
+    }
+
+    std::filesystem::path relative;
+
+    if (!lcl_safe_entry_path(name, relative)) {
+        return fail("unsafe entry name " + name);
+    }
+
+    std::filesystem::path target = _destination / relative;
+    bool directory = name.back() == '/' || name.back() == '\\';
+    std::ofstream out;
+    std::error_code ec;
+
+    if (method != METHOD_STORE && method != METHOD_DEFLATE) {
+        return fail("unsupported compression method " + std::to_string(method) + " for " + name);
+    }
+
+    // Without a size up front there is no telling where stored data ends. Streaming zip tools
+    // only write empty files that way, which show as the descriptor following right away.
+    if (method == METHOD_STORE && (flags & FLAG_DESCRIPTOR) && !directory) {
+        if (!ensure(4) || read_le32(reinterpret_cast<const unsigned char*>(_buffer.data() + _pos)) != DESCRIPTOR_SIGNATURE) {
+            return fail("stored entry with data descriptor " + name);
+        }
+
+        compressed_size = 0;
+    }
+
+    // Directory entries still go through the data path, some tools give them an empty deflate stream.
+    if (directory) {
+        std::filesystem::create_directories(target, ec);
+    } else {
+        std::filesystem::create_directories(target.parent_path(), ec);
+        out.open(target, std::ios::binary | std::ios::trunc);
+
+        if (!out.is_open()) {
+            return fail("could not create " + target.string());
+        }
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint64_t written = 0;
+
+    if (method == METHOD_STORE) {
+        uint64_t remaining = compressed_size;
+
+        while (remaining > 0) {
+            if (_pos == _end && !fill()) {
+                return fail("truncated entry " + name);
+            }
+
+            size_t count = static_cast<size_t>(std::min<uint64_t>(remaining, _end - _pos));
+
+            if (!directory) out.write(_buffer.data() + _pos, static_cast<std::streamsize>(count));
+            crc = crc32(crc, reinterpret_cast<const Bytef*>(_buffer.data() + _pos), static_cast<uInt>(count));
+            _pos += count;
+            remaining -= count;
+            written += count;
+        }
+    } else {
+        z_stream stream{};
+        int status = Z_OK;
+
+        // Raw deflate, the stream itself marks where the entry ends.
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            return fail("inflateInit2 failed");
+        }
+
+        while (status != Z_STREAM_END) {
+            if (_pos == _end && !fill()) {
+                inflateEnd(&stream);
+                return fail("truncated entry " + name);
+            }
+
+            stream.next_in = reinterpret_cast<Bytef*>(_buffer.data() + _pos);
+            stream.avail_in = static_cast<uInt>(_end - _pos);
+
+            do {
+                stream.next_out = reinterpret_cast<Bytef*>(_output.data());
+                stream.avail_out = static_cast<uInt>(_output.size());
+                status = inflate(&stream, Z_NO_FLUSH);
+
+                if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                    inflateEnd(&stream);
+                    return fail("corrupt deflate data in " + name);
+                }
+
+                size_t produced = _output.size() - stream.avail_out;
+
+                if (!directory) out.write(_output.data(), static_cast<std::streamsize>(produced));
+                crc = crc32(crc, reinterpret_cast<const Bytef*>(_output.data()), static_cast<uInt>(produced));
+                written += produced;
+            } while (stream.avail_out == 0 && status != Z_STREAM_END);
+
+            _pos = _end - stream.avail_in;
+        }
+
+        inflateEnd(&stream);
+    }
+
+    if (!directory) out.close();
+
+    if (!directory && !out) {
+        return fail("could not write " + target.string());
+    }
+
+    if (flags & FLAG_DESCRIPTOR) {
+        unsigned char descriptor[4];
+
+        // The descriptor signature is optional, without it the first field is the CRC.
+        if (!read_exact(descriptor, sizeof(descriptor)) ||
+            (read_le32(descriptor) == DESCRIPTOR_SIGNATURE && !read_exact(descriptor, sizeof(descriptor))) ||
+            !skip(zip64 ? 16 : 8)) {
+            return fail("truncated data descriptor for " + name);
+        }
+
+        expected_crc = read_le32(descriptor);
+    } else if (written != size) {
+        return fail("size mismatch for " + name);
+    }
+
+    if (crc != expected_crc) {
+        return fail("CRC mismatch for " + name);
+    }
+
+    _files += directory ? 0 : 1;
+    _bytes += written;
+
+    return true;
+}
+
+lcl_stream_installer::lcl_stream_installer(std::string url, std::filesystem::path destination, const lcl_download_options& options, const std::atomic<bool>& cancel)
+    : _url(std::move(url)), _destination(std::move(destination)), _options(options), _cancel(cancel) {
+    _ring = nullptr;
+    _received = 0;
+    _copy = nullptr;
+    _copy_failed = false;
+}
+
+void lcl_stream_installer::expect_sha256(const std::string& digest) {
+    _expected_sha256 = lcl_sha256::from_digest(digest);
+}
+
+void lcl_stream_installer::keep_copy(std::filesystem::path path) {
+    _copy_path = std::move(path);
+}
+
+size_t lcl_stream_installer::write_ring(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* self = static_cast<lcl_stream_installer*>(userdata);
+    size_t totalSize = size * nmemb;
+
+    if (!self->_expected_sha256.empty()) {
+        self->_hash.update(data, totalSize);
+    }
+
+    self->_received += static_cast<curl_off_t>(totalSize);
+
+    if (self->_copy && fwrite(data, 1, totalSize, self->_copy) != totalSize) {
+        self->_copy_failed = true;
+    }
+
+    return self->_ring->write(data, totalSize) ? totalSize : 0;
+}
+
+bool lcl_stream_installer::run(CURL* curl, CURLcode& res) {
+    auto started = std::chrono::steady_clock::now();
+    lcl_ring_buffer ring(RING_SIZE);
+    lcl_zip_stream zip(ring, _destination);
+    bool extracted = false;
+    std::error_code ec;
+
+    std::filesystem::remove_all(_destination, ec);
+
+    _ring = &ring;
+    _received = 0;
+    _hash.reset();
+
+    // The path may be a hard link into the cache, writing through it would change the cached copy.
+    if (!_copy_path.empty()) {
+        std::filesystem::remove(_copy_path, ec);
+        _copy = fopen(_copy_path.string().c_str(), "wb");
+        _copy_failed = _copy == nullptr;
+    }
+
+    // The extractor drains the ring on its own thread, decompression overlaps the download.
+    std::thread extractor([&]() {
+        extracted = zip.run();
+
+        if (extracted) {
+            ring.drain();
+        } else {
+            ring.abort();
+        }
+    });
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(curl, CURLOPT_URL, _url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_ring);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+    lcl_apply_transfer_limits(curl, _options, _cancel);
+
+    res = lcl_net::instance().perform(curl, "stream");
+
+    ring.close();
+    extractor.join();
+    _ring = nullptr;
+
+    curl_slist_free_all(headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 0L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, nullptr);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
+
+    bool ok = res == CURLE_OK && extracted;
+
+    if (!extracted) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Streaming extraction stopped: %s\n", zip.error().c_str());
+    } else if (res != CURLE_OK) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Streaming download failed: %s\n", curl_easy_strerror(res));
+    }
+
+    if (ok && !_expected_sha256.empty()) {
+        std::string digest = _hash.finish();
+
+        if (digest != _expected_sha256) {
+            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] SHA-256 mismatch for %s: expected %s, got %s\n",
+                _url.c_str(), _expected_sha256.c_str(), digest.c_str());
+            ok = false;
+        }
+    }
+
+    if (_copy) {
+        _copy_failed = fclose(_copy) != 0 || _copy_failed;
+        _copy = nullptr;
+    }
+
+    if (!_copy_path.empty() && (!ok || _copy_failed)) {
+        std::filesystem::remove(_copy_path, ec);
+    }
+
+    if (!ok) {
+        std::filesystem::remove_all(_destination, ec);
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Downloaded and extracted %lld bytes (%llu files, %llu bytes unpacked) in %.2f s (%.1f MB/s).\n",
+        static_cast<long long>(_received), static_cast<unsigned long long>(zip.files()),
+        static_cast<unsigned long long>(zip.bytes()), seconds,
+        seconds > 0 ? _received / seconds / (1024.0 * 1024.0) : 0.0);
+
+    return true;
+}
+
+struct lcl_zip_extractor::_worker {
+    std::ifstream in;
+    std::vector<char> compressed;
+    std::vector<char> output;
+    libdeflate_decompressor* decompressor = nullptr;
+};
+
+static std::string manifest_key(const std::filesystem::path& target, const std::filesystem::path& path) {
+    auto key = path.lexically_relative(target).generic_u8string();
+
+    return std::string(key.begin(), key.end());
+}
+
+static long long write_time(const std::filesystem::path& path, std::error_code& ec) {
+    return static_cast<long long>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+}
+
+bool lcl_install_manifest::load(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    auto json = in.is_open() ? nlohmann::json::parse(in, nullptr, false) : nlohmann::json();
+
+    files.clear();
+
+    if (!json.is_object() || !json["files"].is_object()) {
+        return false;
+    }
+
+    for (const auto& [name, file] : json["files"].items()) {
+        files[name] = { file.value("crc", 0U), file.value("size", 0ULL), file.value("written", 0LL) };
+    }
+
+    return true;
+}
+
+// Written next to the manifest and renamed over it, like the archive cache index.
+bool lcl_install_manifest::save(const std::filesystem::path& path) const {
+    nlohmann::json json = { { "files", nlohmann::json::object() } };
+    std::error_code ec;
+    auto temp = path;
+
+    for (const auto& [name, file] : files) {
+        json["files"][name] = { { "crc", file.crc }, { "size", file.size }, { "written", file.written } };
+    }
+
+    temp += ".tmp";
+
+    {
+        std::ofstream out(temp, std::ios::trunc);
+
+        if (!out.is_open() || !(out << json.dump())) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, ec);
+
+    return !ec;
+}
+
+lcl_zip_extractor::lcl_zip_extractor(std::filesystem::path archive, std::filesystem::path target)
+    : _archive(std::move(archive)), _target(std::move(target)), _directory_offset(0), _prepared(false), _compared(false),
+      _delta(false), _failed(false), _files(0), _unchanged(0), _removed(0), _bytes(0) {
+}
+
+void lcl_zip_extractor::delta(lcl_install_manifest installed) {
+    _installed = std::move(installed);
+    _delta = true;
+}
+
+// The first error is kept, the other threads stop before their next entry.
+bool lcl_zip_extractor::fail(std::string error) {
+    std::lock_guard<std::mutex> lock(_error_lock);
+
+    if (!_failed.exchange(true)) {
+        _error = std::move(error);
+    }
+
+    return false;
+}
+
+bool lcl_zip_extractor::read_central_directory(std::ifstream& in) {
+    std::error_code ec;
+    uint64_t archive_size = std::filesystem::file_size(_archive, ec);
+
+    if (ec || archive_size < 22) {
+        return fail("not a zip archive");
+    }
+
+    // The end record is in the last 22 bytes, or further back when the archive has a comment.
+    std::vector<unsigned char> tail(static_cast<size_t>(std::min<uint64_t>(archive_size, 0xFFFF + 22)));
+    size_t pos = tail.size() - 22;
+
+    in.seekg(static_cast<std::streamoff>(archive_size - tail.size()));
+
+    if (!in.read(reinterpret_cast<char*>(tail.data()), static_cast<std::streamsize>(tail.size()))) {
+        return fail("could not read " + _archive.string());
+    }
+
+    while (read_le32(tail.data() + pos) != END_OF_CENTRAL_SIGNATURE) {
+        if (pos-- == 0) {
+            return fail("no end of central directory record");
+        }
+    }
+
+    uint64_t count = read_le16(tail.data() + pos + 10);
+    uint64_t directory_size = read_le32(tail.data() + pos + 12);
+    uint64_t directory_offset = read_le32(tail.data() + pos + 16);
+
+    // Saturated fields mean zip64, the real values are in a second record pointed to by the locator.
+    if ((count == 0xFFFF || directory_size == 0xFFFFFFFF || directory_offset == 0xFFFFFFFF) &&
+        pos >= 20 && read_le32(tail.data() + pos - 20) == ZIP64_LOCATOR_SIGNATURE) {
+        unsigned char record[56];
+
+        in.seekg(static_cast<std::streamoff>(read_le64(tail.data() + pos - 20 + 8)));
+
+        if (!in.read(reinterpret_cast<char*>(record), sizeof(record)) || read_le32(record) != ZIP64_END_SIGNATURE) {
+            return fail("corrupt zip64 end record");
+        }
+
+        count = read_le64(record + 32);
+        directory_size = read_le64(record + 40);
+        directory_offset = read_le64(record + 48);
+    }
+
+    if (directory_offset > archive_size || directory_size > archive_size - directory_offset) {
+        return fail("corrupt central directory");
+    }
+
+    _directory_offset = directory_offset;
+
+    std::vector<unsigned char> directory(static_cast<size_t>(directory_size));
+
+    in.seekg(static_cast<std::streamoff>(directory_offset));
+
+    if (!in.read(reinterpret_cast<char*>(directory.data()), static_cast<std::streamsize>(directory.size()))) {
+        return fail("could not read the central directory");
+    }
+
+    _entries.reserve(static_cast<size_t>(std::min<uint64_t>(count, directory.size() / 46)));
+
+    for (size_t offset = 0; _entries.size() < count;) {
+        const unsigned char* header = directory.data() + offset;
+
+        if (directory.size() - offset < 46 || read_le32(header) != CENTRAL_HEADER_SIGNATURE) {
+            return fail("corrupt central directory");
+        }
+
+        size_t name_length = read_le16(header + 28);
+        size_t extra_length = read_le16(header + 30);
+        size_t record_length = 46 + name_length + extra_length + read_le16(header + 32);
+
+        if (directory.size() - offset < record_length) {
+            return fail("corrupt central directory");
+        }
+
+        uint16_t made_by = read_le16(header + 4);
+        uint16_t flags = read_le16(header + 8);
+        const unsigned char* extra = header + 46 + name_length;
+        _entry entry{};
+
+        entry.name.assign(reinterpret_cast<const char*>(header + 46), name_length);
+        entry.method = read_le16(header + 10);
+        entry.crc = read_le32(header + 16);
+        entry.compressed_size = read_le32(header + 20);
+        entry.size = read_le32(header + 24);
+        entry.offset = read_le32(header + 42);
+        entry.mode = (made_by >> 8) == HOST_UNIX ? read_le32(header + 38) >> 16 : 0;
+        entry.directory = !entry.name.empty() && (entry.name.back() == '/' || entry.name.back() == '\\');
+
+        // The zip64 extra field only holds the values that overflowed, in this order.
+        for (size_t field = 0; field + 4 <= extra_length;) {
+            size_t value = field + 4;
+            size_t field_end = std::min<size_t>(value + read_le16(extra + field + 2), extra_length);
+
+            if (read_le16(extra + field) == 0x0001) {
+                for (uint64_t* overflowed : { &entry.size, &entry.compressed_size, &entry.offset }) {
+                    if (*overflowed == 0xFFFFFFFF && value + 8 <= field_end) {
+                        *overflowed = read_le64(extra + value);
+                        value += 8;
+                    }
+                }
+            }
+
+            field = field_end;
+        }
+
+        if (flags & FLAG_ENCRYPTED) {
+            return fail("encrypted entry " + entry.name);
+        }
+
+        if (entry.method != METHOD_STORE && entry.method != METHOD_DEFLATE) {
+            return fail("unsupported compression method " + std::to_string(entry.method) + " for " + entry.name);
+        }
+
+        if (entry.offset > archive_size || entry.compressed_size > archive_size - entry.offset) {
+            return fail("entry " + entry.name + " points outside the archive");
+        }
+
+        _entries.push_back(std::move(entry));
+        offset += record_length;
+    }
+
+    return true;
+}
+
+// Works out the final path of every entry and creates the folders up front, so the
+// threads only ever write files.
+bool lcl_zip_extractor::plan() {
+    std::vector<std::string> names;
+    std::vector<bool> directories;
+    std::vector<std::filesystem::path> paths;
+    std::string error;
+
+    for (const auto& entry : _entries) {
+        names.push_back(entry.name);
+        directories.push_back(entry.directory);
+    }
+
+    if (!lcl_layout_entries(names, directories, _target, paths, error)) {
+        return fail(error);
+    }
+
+    for (size_t i = 0; i < _entries.size(); i++) {
+        _entries[i].path = std::move(paths[i]);
+        _entries[i].key = manifest_key(_target, _entries[i].path);
+    }
+
+    return true;
+}
+
+bool lcl_zip_extractor::prepare() {
+    std::ifstream in(_archive, std::ios::binary);
+
+    if (!in.is_open()) {
+        return fail("could not open " + _archive.string());
+    }
+
+    _prepared = read_central_directory(in) && plan();
+
+    return _prepared;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> lcl_zip_extractor::needed_ranges() {
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::vector<uint64_t> starts;
+    _worker worker;
+
+    for (const auto& entry : _entries) {
+        starts.push_back(entry.offset);
+    }
+
+    starts.push_back(_directory_offset);
+    starts.push_back(std::numeric_limits<uint64_t>::max());
+    std::sort(starts.begin(), starts.end());
+
+    // Decided once here, run() extracts exactly what was asked for.
+    for (auto& entry : _entries) {
+        if (entry.directory || entry.path.empty()) {
+            continue;
+        }
+
+        entry.keep = unchanged(entry, worker);
+
+        if (!entry.keep) {
+            ranges.emplace_back(entry.offset, *std::upper_bound(starts.begin(), starts.end(), entry.offset));
+        }
+    }
+
+    _compared = true;
+
+    return ranges;
+}
+
+bool lcl_zip_extractor::run() {
+    auto started = std::chrono::steady_clock::now();
+    std::vector<size_t> order;
+
+    if (!_prepared && !prepare()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < _entries.size(); i++) {
+        if (!_entries[i].directory && !_entries[i].path.empty()) {
+            order.push_back(i);
+        }
+    }
+
+    // Largest entries first, a big file picked up last would leave the other threads idle.
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return _entries[a].compressed_size > _entries[b].compressed_size;
+    });
+
+    unsigned threads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_THREADS);
+    threads = static_cast<unsigned>(std::clamp<size_t>(order.size(), 1, threads));
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            _worker worker;
+
+            worker.in.open(_archive, std::ios::binary);
+            worker.decompressor = libdeflate_alloc_decompressor();
+
+            if (!worker.in.is_open() || !worker.decompressor) {
+                fail("could not open " + _archive.string());
+            }
+
+            while (!_failed) {
+                size_t i = next++;
+
+                if (i >= order.size() || !extract_entry(_entries[order[i]], worker)) {
+                    break;
+                }
+            }
+
+            if (worker.decompressor) {
+                libdeflate_free_decompressor(worker.decompressor);
+            }
+        });
+    }
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (_failed) {
+        return false;
+    }
+
+    // Links come last and in archive order: no thread ever writes through one.
+    for (const auto& entry : _entries) {
+        std::string error;
+
+        if (!entry.link_target.empty() && !lcl_create_entry_link(_target, entry.path.lexically_relative(_target), entry.link_target, error)) {
+            return fail(error);
+        }
+    }
+
+    for (size_t i : order) {
+        const _entry& entry = _entries[i];
+
+        _manifest.files[entry.key] = { entry.crc, entry.size, entry.written };
+    }
+
+    if (_delta) {
+        remove_stale();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    uint64_t bytes = _bytes;
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Extracted %llu files (%llu bytes) in %.2f s with %u threads (%.1f MB/s).\n",
+        static_cast<unsigned long long>(_files.load()), static_cast<unsigned long long>(bytes), seconds, threads,
+        seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+
+    if (_delta) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Delta install: %llu files unchanged, %llu removed.\n",
+            static_cast<unsigned long long>(_unchanged.load()), static_cast<unsigned long long>(_removed));
+    }
+
+    return true;
+}
+
+// Installed files the new archive no longer has. Only names from the manifest are touched,
+// whatever the user added to the folder stays, and folders left empty go with them.
+void lcl_zip_extractor::remove_stale() {
+    std::error_code ec;
+
+    for (const auto& [name, file] : _installed.files) {
+        std::filesystem::path relative;
+
+        if (_manifest.files.count(name) || !lcl_safe_entry_path(name, relative)) {
+            continue;
+        }
+
+        auto path = _target / relative;
+
+        if (std::filesystem::is_directory(std::filesystem::symlink_status(path, ec)) || !std::filesystem::remove(path, ec)) {
+            continue;
+        }
+
+        _removed++;
+
+        for (auto parent = relative.parent_path(); !parent.empty(); parent = parent.parent_path()) {
+            if (!std::filesystem::is_empty(_target / parent, ec) || ec || !std::filesystem::remove(_target / parent, ec)) {
+                break;
+            }
+        }
+    }
+}
+
+// A regular file of the right size that the manifest vouches for (same write time as recorded),
+// or whose CRC-32 read back from disk matches the archive.
+bool lcl_zip_extractor::unchanged(_entry& entry, _worker& worker) {
+    std::error_code ec;
+
+    if (!_delta || !std::filesystem::is_regular_file(std::filesystem::symlink_status(entry.path, ec))) {
+        return false;
+    }
+
+    uint64_t size = std::filesystem::file_size(entry.path, ec);
+    long long written = write_time(entry.path, ec);
+
+    if (ec || size != entry.size) {
+        return false;
+    }
+
+    auto installed = _installed.files.find(entry.key);
+
+    if (installed != _installed.files.end() && installed->second.size == size && installed->second.written == written) {
+        entry.written = written;
+        return installed->second.crc == entry.crc;
+    }
+
+    std::ifstream in(entry.path, std::ios::binary);
+    uint32_t crc = 0;
+
+    worker.output.resize(std::max(worker.output.size(), CHUNK_SIZE));
+
+    while (in.read(worker.output.data(), static_cast<std::streamsize>(CHUNK_SIZE)) || in.gcount() > 0) {
+        crc = libdeflate_crc32(crc, worker.output.data(), static_cast<size_t>(in.gcount()));
+    }
+
+    entry.written = written;
+
+    return in.eof() && crc == entry.crc;
+}
+
+bool lcl_zip_extractor::extract_entry(_entry& entry, _worker& worker) {
+    unsigned char header[30];
+    std::error_code ec;
+
+#ifdef _WIN32
+    bool link = false;
+#else
+    bool link = (entry.mode & MODE_TYPE) == MODE_SYMLINK;
+#endif
+
+    // Symlinks are cheap to recreate and always are.
+    if (!link && (_compared ? entry.keep : unchanged(entry, worker))) {
+#ifndef _WIN32
+        if ((entry.mode & 0777) != 0) {
+            std::filesystem::permissions(entry.path, static_cast<std::filesystem::perms>(entry.mode & 0777), ec);
+        }
+#endif
+
+        _unchanged++;
+        return true;
+    }
+
+    worker.in.clear();
+    worker.in.seekg(static_cast<std::streamoff>(entry.offset));
+
+    if (!worker.in.read(reinterpret_cast<char*>(header), sizeof(header)) || read_le32(header) != LOCAL_HEADER_SIGNATURE) {
+        return fail("corrupt local header for " + entry.name);
+    }
+
+    // The local name and extra field can differ from the central copy, only their length matters.
+    worker.in.seekg(static_cast<std::streamoff>(entry.offset + sizeof(header) + read_le16(header + 26) + read_le16(header + 28)));
+
+    // Replaced instead of written through: an old symlink is not followed and a running
+    // executable keeps its own copy.
+    std::filesystem::remove_all(entry.path, ec);
+
+    bool ok = entry.size <= WHOLE_ENTRY_LIMIT && entry.compressed_size <= WHOLE_ENTRY_LIMIT ?
+        extract_in_memory(entry, worker, link) : !link && extract_streamed(entry, worker);
+
+    if (!ok) {
+        return _failed ? false : fail("could not extract " + entry.name);
+    }
+
+#ifndef _WIN32
+    if (!link && (entry.mode & 0777) != 0) {
+        std::filesystem::permissions(entry.path, static_cast<std::filesystem::perms>(entry.mode & 0777), ec);
+    }
+#endif
+
+    entry.written = link ? 0 : write_time(entry.path, ec);
+    _files++;
+    _bytes += entry.size;
+
+    return true;
+}
+
+bool lcl_zip_extractor::extract_in_memory(_entry& entry, _worker& worker, bool link) {
+    size_t size = static_cast<size_t>(entry.size);
+
+    worker.compressed.resize(std::max(worker.compressed.size(), static_cast<size_t>(entry.compressed_size)));
+    const char* data = worker.compressed.data();
+
+    if (!worker.in.read(worker.compressed.data(), static_cast<std::streamsize>(entry.compressed_size))) {
+        return fail("truncated entry " + entry.name);
+    }
+
+    if (entry.method == METHOD_DEFLATE) {
+        worker.output.resize(std::max(worker.output.size(), size));
+        data = worker.output.data();
+
+        if (libdeflate_deflate_decompress(worker.decompressor, worker.compressed.data(), static_cast<size_t>(entry.compressed_size),
+            worker.output.data(), size, nullptr) != LIBDEFLATE_SUCCESS) {
+            return fail("corrupt deflate data in " + entry.name);
+        }
+    } else if (entry.compressed_size != entry.size) {
+        return fail("size mismatch for " + entry.name);
+    }
+
+    if (libdeflate_crc32(0, data, size) != entry.crc) {
+        return fail("CRC mismatch for " + entry.name);
+    }
+
+    // Created by run() once every file is written.
+    if (link) {
+        entry.link_target.assign(data, size);
+        return !entry.link_target.empty() || fail("empty symlink " + entry.name);
+    }
+
+    std::ofstream out(entry.path, std::ios::binary | std::ios::trunc);
+
+    if (!out.is_open() || !out.write(data, static_cast<std::streamsize>(size))) {
+        return fail("could not write " + entry.path.string());
+    }
+
+    out.close();
+    return !out.fail() || fail("could not write " + entry.path.string());
+}
+
+// Entries too big to hold in memory go through zlib chunk by chunk.
+bool lcl_zip_extractor::extract_streamed(const _entry& entry, _worker& worker) {
+    std::ofstream out(entry.path, std::ios::binary | std::ios::trunc);
+    uint64_t remaining = entry.compressed_size;
+    uint64_t written = 0;
+    uint32_t crc = 0;
+    z_stream stream{};
+    int status = Z_OK;
+
+    if (!out.is_open()) {
+        return fail("could not create " + entry.path.string());
+    }
+
+    worker.compressed.resize(std::max(worker.compressed.size(), CHUNK_SIZE));
+    worker.output.resize(std::max(worker.output.size(), CHUNK_SIZE));
+
+    if (entry.method == METHOD_DEFLATE && inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return fail("inflateInit2 failed");
+    }
+
+    while (remaining > 0 && status != Z_STREAM_END) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(remaining, CHUNK_SIZE));
+
+        if (!worker.in.read(worker.compressed.data(), static_cast<std::streamsize>(count))) {
+            status = Z_DATA_ERROR;
+            break;
+        }
+
+        remaining -= count;
+
+        if (entry.method == METHOD_STORE) {
+            crc = libdeflate_crc32(crc, worker.compressed.data(), count);
+            out.write(worker.compressed.data(), static_cast<std::streamsize>(count));
+            written += count;
+            continue;
+        }
+
+        stream.next_in = reinterpret_cast<Bytef*>(worker.compressed.data());
+        stream.avail_in = static_cast<uInt>(count);
+
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(worker.output.data());
+            stream.avail_out = static_cast<uInt>(CHUNK_SIZE);
+            status = inflate(&stream, Z_NO_FLUSH);
+
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                break;
+            }
+
+            size_t produced = CHUNK_SIZE - stream.avail_out;
+
+            crc = libdeflate_crc32(crc, worker.output.data(), produced);
+            out.write(worker.output.data(), static_cast<std::streamsize>(produced));
+            written += produced;
+        } while (stream.avail_out == 0 && status != Z_STREAM_END);
+
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+            break;
+        }
+    }
+
+    if (entry.method == METHOD_DEFLATE) {
+        inflateEnd(&stream);
+    }
+
+    out.close();
+
+    if (out.fail()) {
+        return fail("could not write " + entry.path.string());
+    }
+
+    if (written != entry.size || (entry.method == METHOD_DEFLATE && status != Z_STREAM_END)) {
+        return fail("corrupt entry " + entry.name);
+    }
+
+    return crc == entry.crc || fail("CRC mismatch for " + entry.name);
+}
+
+lcl_partial_installer::lcl_partial_installer(std::string url, std::filesystem::path archive, std::filesystem::path target,
+    const lcl_download_options& options, const std::atomic<bool>& cancel)
+    : _url(std::move(url)), _archive(std::move(archive)), _target(std::move(target)), _options(options), _cancel(cancel),
+      _file(nullptr), _tail_first(0) {
+}
+
+bool lcl_partial_installer::read_at(uint64_t position, void* data, size_t size) {
+    return fflush(_file) == 0 && lcl_seek_file(_file, position) && fread(data, 1, size, _file) == size;
+}
+
+// Fetches the tail, then whatever of the zip64 end record and the central directory lies before it.
+bool lcl_partial_installer::fetch_directory(lcl_range_fetcher& fetcher, CURL* curl, CURLcode& res) {
+    if (!fetcher.fetch_tail(curl, res, TAIL_SIZE, _tail_first)) {
+        return false;
+    }
+
+    uint64_t total_size = fetcher.total_size();
+
+    std::vector<unsigned char> tail(static_cast<size_t>(std::min<uint64_t>(total_size - _tail_first, 0xFFFF + 22)));
+
+    if (tail.size() < 22 || !read_at(total_size - tail.size(), tail.data(), tail.size())) {
+        return false;
+    }
+
+    size_t pos = tail.size() - 22;
+
+    while (read_le32(tail.data() + pos) != END_OF_CENTRAL_SIGNATURE) {
+        if (pos-- == 0) {
+            return false;
+        }
+    }
+
+    uint64_t count = read_le16(tail.data() + pos + 10);
+    uint64_t directory_size = read_le32(tail.data() + pos + 12);
+    uint64_t directory_offset = read_le32(tail.data() + pos + 16);
+
+    if ((count == 0xFFFF || directory_size == 0xFFFFFFFF || directory_offset == 0xFFFFFFFF) &&
+        pos >= 20 && read_le32(tail.data() + pos - 20) == ZIP64_LOCATOR_SIGNATURE) {
+        uint64_t record_offset = read_le64(tail.data() + pos - 20 + 8);
+        unsigned char record[56];
+
+        if (record_offset > total_size - sizeof(record) ||
+            (record_offset < _tail_first && !fetcher.fetch(curl, res, record_offset, std::min<uint64_t>(record_offset + sizeof(record), _tail_first))) ||
+            !read_at(record_offset, record, sizeof(record)) || read_le32(record) != ZIP64_END_SIGNATURE) {
+            return false;
+        }
+
+        directory_size = read_le64(record + 40);
+        directory_offset = read_le64(record + 48);
+    }
+
+    if (directory_offset > total_size || directory_size > total_size - directory_offset) {
+        return false;
+    }
+
+    return directory_offset >= _tail_first ||
+        fetcher.fetch(curl, res, directory_offset, std::min<uint64_t>(directory_offset + directory_size, _tail_first));
+}
+
+bool lcl_partial_installer::run(CURL* curl, CURLcode& res, lcl_install_manifest installed) {
+    auto started = std::chrono::steady_clock::now();
+    lcl_zip_extractor extractor(_archive, _target);
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::error_code ec;
+    uint64_t total_size = 0;
+    uint64_t needed = 0;
+    size_t changed = 0;
+
+    std::filesystem::remove(_archive, ec);
+    _file = fopen(_archive.string().c_str(), "w+b");
+
+    lcl_range_fetcher fetcher(_url, _file, _options, _cancel);
+
+    // The tail reaches the last byte, so the sparse archive has its full size from the start.
+    bool ok = _file && fetch_directory(fetcher, curl, res);
+
+    if (ok) {
+        ok = fflush(_file) == 0;
+        total_size = fetcher.total_size();
+        extractor.delta(std::move(installed));
+    }
+
+    if (ok && !extractor.prepare()) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Partial update: %s\n", extractor.error().c_str());
+        ok = false;
+    }
+
+    if (ok) {
+        auto records = extractor.needed_ranges();
+
+        std::sort(records.begin(), records.end());
+        changed = records.size();
+
+        for (auto [first, last] : records) {
+            last = std::min(last, total_size);
+
+            if (!ranges.empty() && first <= ranges.back().second + MERGE_GAP) {
+                ranges.back().second = std::max(ranges.back().second, last);
+            } else {
+                ranges.emplace_back(first, last);
+            }
+        }
+
+        for (const auto& [first, last] : ranges) {
+            needed += last - first;
+        }
+
+        // Past this point the segmented download of the whole archive is the faster way.
+        if (needed > total_size / 4 * 3) {
+            log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Partial update would fetch %llu of %llu bytes, downloading the archive instead.\n",
+                static_cast<unsigned long long>(needed), static_cast<unsigned long long>(total_size));
+            ok = false;
+        }
+    }
+
+    for (size_t i = 0; ok && i < ranges.size(); i++) {
+        if (ranges[i].first < ranges[i].second && ranges[i].first < _tail_first) {
+            ok = fetcher.fetch(curl, res, ranges[i].first, std::min(ranges[i].second, _tail_first));
+        }
+    }
+
+    if (_file) {
+        ok = fclose(_file) == 0 && ok;
+        _file = nullptr;
+    }
+
+    if (!ok && res != CURLE_OK) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Partial update: range request failed: %s\n", curl_easy_strerror(res));
+    }
+
+    // Records that were not fetched are zeros and fail their signature check, nothing is trusted blindly.
+    if (ok && !extractor.run()) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Partial update: %s\n", extractor.error().c_str());
+        ok = false;
+    }
+
+    std::filesystem::remove(_archive, ec);
+
+    if (!ok) {
+        return false;
+    }
+
+    _manifest = extractor.manifest();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Partial update: fetched %llu of %llu bytes for %zu changed files in %.2f s.\n",
+        static_cast<unsigned long long>(fetcher.received()), static_cast<unsigned long long>(total_size), changed, seconds);
+
+    return true;
+}
+
+bool lcl_layout_entries(const std::vector<std::string>& names, const std::vector<bool>& directories,
+    const std::filesystem::path& target, std::vector<std::filesystem::path>& paths, std::string& error) {
+    std::vector<std::filesystem::path> relative(names.size());
+    std::filesystem::path top;
+    bool single_top = !names.empty();
+    std::error_code ec;
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (!lcl_safe_entry_path(names[i], relative[i])) {
+            error = "unsafe entry name " + names[i];
+            return false;
+        }
+
+        auto first = *relative[i].begin();
+        bool nested = directories[i] || std::next(relative[i].begin()) != relative[i].end();
+
+        if (top.empty()) {
+            top = first;
+        }
+
+        single_top = single_top && nested && first == top;
+    }
+
+    paths.assign(names.size(), std::filesystem::path());
+
+    // Same rule as lcl_move_extracted(): one top level folder holding everything is flattened.
+    for (size_t i = 0; i < names.size(); i++) {
+        std::filesystem::path path;
+        auto part = relative[i].begin();
+
+        if (single_top) {
+            part++;
+        }
+
+        for (; part != relative[i].end(); part++) {
+            path /= *part;
+        }
+
+        // Left empty for the flattened folder itself, which has nothing to extract.
+        paths[i] = path.empty() ? path : target / path;
+    }
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (paths[i].empty()) {
+            continue;
+        }
+
+        auto directory = directories[i] ? paths[i] : paths[i].parent_path();
+
+        // Nothing is written through a link already on disk, a previous install may have left one.
+        if (lcl_passes_symlink(target, (directories[i] ? paths[i] / "." : paths[i]).lexically_relative(target))) {
+            error = "entry " + names[i] + " leads through a symlink";
+            return false;
+        }
+
+        // A file standing where the archive has a folder is replaced, like the archive tools do.
+        if (!std::filesystem::is_directory(directory, ec)) {
+            std::filesystem::remove(directory, ec);
+            std::filesystem::create_directories(directory, ec);
+
+            if (ec) {
+                error = "could not create " + directory.string() + ": " + ec.message();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Moves the contents of from into target, merging directories and replacing files and symlinks.
+static bool merge_tree(const std::filesystem::path& from, const std::filesystem::path& target, std::error_code& ec) {
+    std::vector<std::filesystem::directory_entry> entries;
+
+    std::filesystem::create_directories(target, ec);
+
+    for (const auto& entry : std::filesystem::directory_iterator(from, ec)) {
+        entries.push_back(entry);
+    }
+
+    if (ec) {
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        auto destination = target / entry.path().filename();
+
+        // A link to a folder moves as the link, it is never merged through.
+        if (entry.is_directory(ec) && !entry.is_symlink(ec) && !ec) {
+            if (std::filesystem::is_symlink(std::filesystem::symlink_status(destination, ec))) {
+                std::filesystem::remove(destination, ec);
+            }
+
+            if (!merge_tree(entry.path(), destination, ec)) {
+                return false;
+            }
+
+            continue;
+        }
+
+        if (std::filesystem::is_directory(std::filesystem::symlink_status(destination, ec))) {
+            std::filesystem::remove_all(destination, ec);
+        }
+
+        std::filesystem::rename(entry.path(), destination, ec);
+
+        if (ec) {
+            return false;
+        }
+    }
+
+    return !ec;
+}
+
+bool lcl_move_extracted(const std::filesystem::path& from, const std::filesystem::path& target, std::string& error) {
+    std::error_code ec;
+    std::filesystem::path root = from;
+    std::vector<std::filesystem::directory_entry> top;
+
+    for (const auto& entry : std::filesystem::directory_iterator(from, ec)) {
+        top.push_back(entry);
+    }
+
+    if (ec) {
+        error = ec.message();
+        return false;
+    }
+
+    // Release archives usually wrap everything in one "<name>-<version>" folder.
+    if (top.size() == 1 && top[0].is_directory(ec)) {
+        root = top[0].path();
+    }
+
+    if (!merge_tree(root, target, ec)) {
+        error = ec.message();
+        return false;
+    }
+
+    std::filesystem::remove_all(from, ec);
+
+    return true;
+}
@@ -0,0 +1,87 @@
+#include "lcl_lock.hpp"
+
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+lcl_file_lock::~lcl_file_lock() {
+    release();
+}
+
+bool lcl_file_lock::held() const {
+#ifdef _WIN32
+    return _handle != nullptr;
+#else
+    return _fd >= 0;
+#endif
+}
+
+bool lcl_file_lock::acquire(const std::filesystem::path& path, std::chrono::milliseconds wait) {
+    std::error_code ec;
+    auto until = std::chrono::steady_clock::now() + wait;
+
+    release();
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    _handle = handle;
+#else
+    _fd = open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+
+    if (_fd < 0) {
+        return false;
+    }
+#endif
+
+    // Polled rather than blocking, so the wait stays bounded.
+    while (!try_acquire()) {
+        if (std::chrono::steady_clock::now() >= until) {
+            release();
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    return true;
+}
+
+bool lcl_file_lock::try_acquire() {
+#ifdef _WIN32
+    OVERLAPPED overlapped{};
+    return LockFileEx(static_cast<HANDLE>(_handle), LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped) != 0;
+#else
+    return flock(_fd, LOCK_EX | LOCK_NB) == 0;
+#endif
+}
+
+// Closing the handle drops the lock as well.
+void lcl_file_lock::release() {
+#ifdef _WIN32
+    if (_handle) {
+        CloseHandle(static_cast<HANDLE>(_handle));
+        _handle = nullptr;
+    }
+#else
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+#endif
+}
@@ -0,0 +1,787 @@
+#include "lcl_mirror.hpp"
+#include "lcl_net.hpp"
+#include "lcl_sha256.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define LCL_INVALID_SOCKET INVALID_SOCKET
+#define lcl_close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int socket_t;
+#define LCL_INVALID_SOCKET (-1)
+#define lcl_close_socket close
+#endif
+
+using json = nlohmann::json;
+
+extern retro_log_printf_t log_cb;
+
+static constexpr int MAX_CLIENTS = 64;
+static constexpr size_t MAX_REQUEST_HEADER = 16384;
+static constexpr size_t SEND_CHUNK = 1 << 20;
+
+enum class range_result {
+    FULL,
+    PARTIAL,
+    UNSATISFIABLE
+};
+
+static long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// libcurl callback
+static inline size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
+    size_t totalSize = size * nmemb;
+    output->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+struct hashed_file {
+    FILE* file;
+    lcl_sha256 hash;
+};
+
+// libcurl callback, writes the asset and hashes it on the way.
+static size_t HashingWriteCallback(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* out = static_cast<hashed_file*>(userdata);
+    size_t stored = fwrite(data, 1, size * nmemb, out->file);
+
+    out->hash.update(data, stored);
+
+    return stored;
+}
+
+// libcurl progress callback, aborts upstream downloads once the mirror is shutting down.
+static int StopCallback(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    return static_cast<std::atomic<bool>*>(clientp)->load() ? 1 : 0;
+}
+
+static bool send_all(socket_t client, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        int sent = send(client, data, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0);
+#else
+        ssize_t sent = send(client, data, size, MSG_NOSIGNAL);
+#endif
+        if (sent <= 0) {
+            return false;
+        }
+
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+
+    return true;
+}
+
+static bool send_response(socket_t client, int status, const char* reason, const std::string& headers,
+    const std::string& body, bool head_only) {
+    std::string response = std::format("HTTP/1.1 {} {}\r\nServer: LCL\r\nConnection: close\r\n{}Content-Length: {}\r\n\r\n",
+        status, reason, headers, body.size());
+
+    if (!head_only) {
+        response += body;
+    }
+
+    return send_all(client, response.data(), response.size());
+}
+
+static std::string percent_encode(const std::string& value) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+
+    for (unsigned char c : value) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back(static_cast<char>(c));
+        } else {
+            out.push_back('%');
+            out.push_back(digits[c >> 4]);
+            out.push_back(digits[c & 0x0F]);
+        }
+    }
+
+    return out;
+}
+
+static std::string body_etag(const std::string& body) {
+    unsigned long long hash = 14695981039346656037ull;
+
+    for (unsigned char c : body) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    return std::format("\"{:016x}\"", hash);
+}
+
+// A single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range. Anything else is
+// answered with the whole file, as HTTP allows.
+static range_result parse_range(const std::string& header, unsigned long long size,
+    unsigned long long& first, unsigned long long& last) {
+    first = 0;
+    last = size == 0 ? 0 : size - 1;
+
+    if (header.rfind("bytes=", 0) != 0 || header.find(',') != std::string::npos) {
+        return range_result::FULL;
+    }
+
+    std::string spec = header.substr(6);
+    size_t dash = spec.find('-');
+
+    if (dash == std::string::npos) {
+        return range_result::FULL;
+    }
+
+    std::string from = spec.substr(0, dash);
+    std::string to = spec.substr(dash + 1);
+    auto is_number = [](const std::string& s) {
+        return !s.empty() && s.size() < 20 && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+    };
+
+    if (from.empty()) {
+        if (!is_number(to) || std::stoull(to) == 0 || size == 0) {
+            return range_result::UNSATISFIABLE;
+        }
+
+        first = size - std::min<unsigned long long>(std::stoull(to), size);
+        return range_result::PARTIAL;
+    }
+
+    if (!is_number(from) || (!to.empty() && !is_number(to))) {
+        return range_result::FULL;
+    }
+
+    first = std::stoull(from);
+
+    if (!to.empty()) {
+        last = std::min<unsigned long long>(std::stoull(to), size - 1);
+    }
+
+    if (first >= size || (!to.empty() && std::stoull(to) < first)) {
+        return range_result::UNSATISFIABLE;
+    }
+
+    return range_result::PARTIAL;
+}
+
+lcl_mirror& lcl_mirror::instance() {
+    static lcl_mirror mirror;
+    return mirror;
+}
+
+lcl_mirror::lcl_mirror() {
+    _active_clients = 0;
+    _stopping = false;
+    _listener = -1;
+    _running = false;
+}
+
+bool lcl_mirror::start(const std::filesystem::path& root, const std::string& bind_address, int port,
+    const std::string& api_token, const std::vector<lcl_mirror_source>& sources) {
+    if (_running) {
+        return true;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa_data;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror could not initialize Winsock.\n");
+        return false;
+    }
+#endif
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(port));
+
+    if (inet_pton(AF_INET, bind_address.c_str(), &address.sin_addr) != 1) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Invalid mirror bind address: %s\n", bind_address.c_str());
+        return false;
+    }
+
+    socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int reuse = 1;
+
+    if (listener == LCL_INVALID_SOCKET) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror could not create a socket.\n");
+        return false;
+    }
+
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror could not listen on %s:%d.\n", bind_address.c_str(), port);
+        lcl_close_socket(listener);
+        return false;
+    }
+
+    _root = root;
+    _api_token = api_token;
+    _releases.clear();
+    _fetches.clear();
+
+    // Serve whatever was mirrored before right away, upstream is asked again once the TTL expires.
+    for (const auto& source : sources) {
+        auto release = std::make_unique<_release>();
+        auto section_dir = _root / source.section;
+        std::ifstream document_in(section_dir / "release.json");
+        std::ifstream meta_in(section_dir / "release.meta.json");
+
+        release->source = source;
+
+        if (document_in.is_open()) {
+            release->document = json::parse(document_in, nullptr, false);
+
+            if (release->document.is_discarded()) {
+                release->document = nullptr;
+            }
+        }
+
+        json meta = meta_in.is_open() ? json::parse(meta_in, nullptr, false) : json();
+
+        if (!release->document.is_null() && meta.is_object()) {
+            release->etag = meta.value("etag", "");
+            release->checked_at = meta.value("checked_at", 0LL);
+        }
+
+        _releases[source.section] = std::move(release);
+    }
+
+    _listener = static_cast<long long>(listener);
+    _stopping = false;
+    _running = true;
+    _accept_thread = std::thread(&lcl_mirror::accept_loop, this);
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Mirror listening on %s:%d for %zu cores, cache in %s\n",
+        bind_address.c_str(), port, _releases.size(), _root.string().c_str());
+
+    return true;
+}
+
+void lcl_mirror::stop() {
+    if (!_running) {
+        return;
+    }
+
+    _stopping = true;
+
+    if (_accept_thread.joinable()) {
+        _accept_thread.join();
+    }
+
+    lcl_close_socket(static_cast<socket_t>(_listener));
+    _listener = -1;
+
+    // Client threads notice _stopping between chunks and within their receive timeout.
+    std::unique_lock<std::mutex> lock(_clients_lock);
+    _clients_done.wait(lock, [this] { return _active_clients == 0; });
+    lock.unlock();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    _running = false;
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Mirror stopped.\n");
+}
+
+void lcl_mirror::accept_loop() {
+    socket_t listener = static_cast<socket_t>(_listener);
+
+    while (!_stopping) {
+        fd_set read_set;
+        timeval timeout{ 0, 250000 };
+
+        FD_ZERO(&read_set);
+        FD_SET(listener, &read_set);
+
+        if (select(static_cast<int>(listener + 1), &read_set, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+
+        socket_t client = accept(listener, nullptr, nullptr);
+
+        if (client == LCL_INVALID_SOCKET) {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_clients_lock);
+
+            if (_active_clients >= MAX_CLIENTS) {
+                send_response(client, 503, "Service Unavailable", "Retry-After: 5\r\n", "", false);
+                lcl_close_socket(client);
+                continue;
+            }
+
+            _active_clients++;
+        }
+
+        std::thread([this, client] {
+            handle_client(static_cast<long long>(client));
+            lcl_close_socket(client);
+
+            std::lock_guard<std::mutex> lock(_clients_lock);
+            _active_clients--;
+            _clients_done.notify_all();
+        }).detach();
+    }
+}
+
+void lcl_mirror::handle_client(long long client_handle) {
+    socket_t client = static_cast<socket_t>(client_handle);
+    std::string data;
+    char buffer[4096];
+    _request request;
+
+#ifdef _WIN32
+    DWORD timeout = 5000;
+#else
+    timeval timeout{ 5, 0 };
+#endif
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+
+    while (data.find("\r\n\r\n") == std::string::npos) {
+        int received = static_cast<int>(recv(client, buffer, sizeof(buffer), 0));
+
+        if (received <= 0 || _stopping || data.size() + static_cast<size_t>(received) > MAX_REQUEST_HEADER) {
+            return;
+        }
+
+        data.append(buffer, static_cast<size_t>(received));
+    }
+
+    size_t line_end = data.find("\r\n");
+    std::string request_line = data.substr(0, line_end);
+    size_t first_space = request_line.find(' ');
+    size_t second_space = request_line.find(' ', first_space + 1);
+
+    if (first_space == std::string::npos || second_space == std::string::npos) {
+        send_response(client, 400, "Bad Request", "", "", false);
+        return;
+    }
+
+    request.method = request_line.substr(0, first_space);
+    request.path = request_line.substr(first_space + 1, second_space - first_space - 1);
+    request.path = request.path.substr(0, request.path.find('?'));
+
+    for (size_t pos = line_end + 2; pos < data.size();) {
+        size_t end = data.find("\r\n", pos);
+
+        if (end == std::string::npos || end == pos) {
+            break;
+        }
+
+        std::string line = data.substr(pos, end - pos);
+        size_t colon = line.find(':');
+        pos = end + 2;
+
+        if (colon == std::string::npos) {
+            continue;
+        }
+
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t") + 1);
+
+        if (name == "host") request.host = value;
+        else if (name == "range") request.range = value;
+        else if (name == "if-none-match") request.if_none_match = value;
+    }
+
+    if (request.method != "GET" && request.method != "HEAD") {
+        send_response(client, 405, "Method Not Allowed", "Allow: GET, HEAD\r\n", "", false);
+        return;
+    }
+
+    // /<core>/release.json or /<core>/<asset id>/<name>
+    std::vector<std::string> segments;
+
+    for (size_t pos = 1; pos <= request.path.size();) {
+        size_t end = request.path.find('/', pos);
+        end = end == std::string::npos ? request.path.size() : end;
+        segments.push_back(request.path.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    auto release = segments.empty() ? _releases.end() : _releases.find(segments[0]);
+
+    if (release == _releases.end()) {
+        send_response(client, 404, "Not Found", "", "", request.method == "HEAD");
+        return;
+    }
+
+    if (segments.size() == 2 && segments[1] == "release.json") {
+        serve_release(client_handle, request, *release->second);
+    } else if (segments.size() == 3 && !segments[1].empty() && std::all_of(segments[1].begin(), segments[1].end(), [](unsigned char c) { return std::isdigit(c); })) {
+        serve_asset(client_handle, request, *release->second, segments[1]);
+    } else {
+        send_response(client, 404, "Not Found", "", "", request.method == "HEAD");
+    }
+}
+
+void lcl_mirror::serve_release(long long client_handle, const _request& request, _release& release) {
+    socket_t client = static_cast<socket_t>(client_handle);
+    bool head_only = request.method == "HEAD";
+    json document;
+
+    {
+        std::lock_guard<std::mutex> lock(release.lock);
+
+        if (!refresh_release(release)) {
+            send_response(client, 502, "Bad Gateway", "", "", head_only);
+            return;
+        }
+
+        document = release.document;
+    }
+
+    std::string host = request.host.empty() ? "localhost" : request.host;
+
+    // Point every asset back at this mirror, under the Host name the client used to reach it.
+    for (auto& asset : document["assets"]) {
+        if (!asset.is_object() || !asset.contains("id") || !asset["name"].is_string()) {
+            continue;
+        }
+
+        asset["browser_download_url"] = std::format("http://{}/{}/{}/{}", host, percent_encode(release.source.section),
+            asset["id"].dump(), percent_encode(asset["name"].get<std::string>()));
+    }
+
+    std::string body = document.dump();
+    std::string etag = body_etag(body);
+
+    if (request.if_none_match == etag) {
+        send_response(client, 304, "Not Modified", std::format("ETag: {}\r\n", etag), "", true);
+        return;
+    }
+
+    send_response(client, 200, "OK", std::format("Content-Type: application/json\r\nETag: {}\r\n", etag), body, head_only);
+}
+
+void lcl_mirror::serve_asset(long long client_handle, const _request& request, _release& release, const std::string& asset_id) {
+    socket_t client = static_cast<socket_t>(client_handle);
+    bool head_only = request.method == "HEAD";
+    json asset;
+
+    {
+        std::lock_guard<std::mutex> lock(release.lock);
+
+        if (release.document.is_null() && !refresh_release(release)) {
+            send_response(client, 502, "Bad Gateway", "", "", head_only);
+            return;
+        }
+
+        for (const auto& candidate : release.document["assets"]) {
+            if (candidate.is_object() && candidate.contains("id") && candidate["id"].dump() == asset_id) {
+                asset = candidate;
+                break;
+            }
+        }
+    }
+
+    std::string name = asset.is_object() ? asset.value("name", "") : "";
+
+    // Names come from upstream, never let one leave the mirror directory.
+    if (name.empty() || name == "." || name == ".." || name.find_first_of("/\\") != std::string::npos) {
+        send_response(client, 404, "Not Found", "", "", head_only);
+        return;
+    }
+
+    auto target = _root / release.source.section / asset_id / name;
+    unsigned long long expected_size = asset.value("size", 0ULL);
+    auto fetch = asset_fetch_state(release.source.section + "/" + asset_id);
+    std::error_code ec;
+
+    auto is_complete = [&] {
+        std::error_code size_ec;
+        auto size = std::filesystem::file_size(target, size_ec);
+        return !size_ec && (expected_size == 0 || size == expected_size);
+    };
+
+    // The first client to ask pulls the asset from upstream, the others wait for that copy.
+    {
+        std::unique_lock<std::mutex> lock(fetch->lock);
+        fetch->done.wait(lock, [&] { return !fetch->busy; });
+
+        if (!is_complete()) {
+            fetch->busy = true;
+            lock.unlock();
+            fetch_asset(asset, target);
+            lock.lock();
+            fetch->busy = false;
+            fetch->done.notify_all();
+        }
+    }
+
+    if (!is_complete()) {
+        send_response(client, 502, "Bad Gateway", "", "", head_only);
+        return;
+    }
+
+    unsigned long long size = std::filesystem::file_size(target, ec);
+    unsigned long long first = 0;
+    unsigned long long last = 0;
+    range_result range = request.range.empty() ? range_result::FULL : parse_range(request.range, size, first, last);
+
+    if (range == range_result::FULL) {
+        first = 0;
+        last = size == 0 ? 0 : size - 1;
+    }
+
+    if (range == range_result::UNSATISFIABLE) {
+        send_response(client, 416, "Range Not Satisfiable", std::format("Content-Range: bytes */{}\r\n", size), "", head_only);
+        return;
+    }
+
+    unsigned long long length = size == 0 ? 0 : last - first + 1;
+    std::string headers = std::format("HTTP/1.1 {}\r\nServer: LCL\r\nConnection: close\r\n"
+        "Content-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\nContent-Length: {}\r\n",
+        range == range_result::PARTIAL ? "206 Partial Content" : "200 OK", length);
+
+    if (range == range_result::PARTIAL) {
+        headers += std::format("Content-Range: bytes {}-{}/{}\r\n", first, last, size);
+    }
+
+    headers += "\r\n";
+
+    if (!send_all(client, headers.data(), headers.size()) || head_only) {
+        return;
+    }
+
+    std::ifstream in(target, std::ios::binary);
+    std::vector<char> chunk(SEND_CHUNK);
+
+    in.seekg(static_cast<std::streamoff>(first));
+
+    while (length > 0 && !_stopping && in) {
+        size_t count = static_cast<size_t>(std::min<unsigned long long>(length, chunk.size()));
+
+        in.read(chunk.data(), static_cast<std::streamsize>(count));
+
+        if (in.gcount() <= 0 || !send_all(client, chunk.data(), static_cast<size_t>(in.gcount()))) {
+            return;
+        }
+
+        length -= static_cast<unsigned long long>(in.gcount());
+    }
+}
+
+// Caller holds release.lock.
+bool lcl_mirror::refresh_release(_release& release) {
+    bool has_document = !release.document.is_null();
+
+    if (has_document && unix_now() - release.checked_at < release.source.ttl) {
+        return true;
+    }
+
+    bool github_api = release.source.api_url.rfind("https://api.github.com/", 0) == 0;
+    long long wait_seconds = 0;
+
+    if (github_api && !lcl_net::instance().rate_limit_allows("core", wait_seconds)) {
+        return has_document;
+    }
+
+    CURL* curl = lcl_net::instance().easy();
+    std::string response;
+    lcl_http_headers responseHeaders;
+    long responseCode = 0;
+
+    if (!curl) {
+        return has_document;
+    }
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Accept: application/json");
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    if (github_api && !_api_token.empty()) {
+        headers = curl_slist_append(headers, std::format("Authorization: Bearer {}", _api_token).c_str());
+    }
+
+    if (has_document && !release.etag.empty()) {
+        headers = curl_slist_append(headers, std::format("If-None-Match: {}", release.etag).c_str());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, release.source.api_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lcl_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+    CURLcode res = lcl_net::instance().perform(curl, "mirror-metadata");
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    if (github_api) {
+        lcl_net::instance().rate_limit_update("core", responseCode, responseHeaders);
+    }
+
+    if (res == CURLE_OK && responseCode == 304 && has_document) {
+        release.checked_at = unix_now();
+    } else {
+        json document = res == CURLE_OK && responseCode < 400 ? json::parse(response, nullptr, false) : json();
+
+        if (!document.is_object() || !document.contains("tag_name") || !document["assets"].is_array()) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Mirror could not refresh %s (%s, HTTP %ld).\n",
+                release.source.section.c_str(), curl_easy_strerror(res), responseCode);
+            return has_document;
+        }
+
+        release.document = std::move(document);
+        release.etag = responseHeaders.count("etag") ? responseHeaders["etag"] : "";
+        release.checked_at = unix_now();
+
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Mirror refreshed %s (tag: %s).\n",
+            release.source.section.c_str(), release.document.value("tag_name", "").c_str());
+    }
+
+    std::error_code ec;
+    auto section_dir = _root / release.source.section;
+
+    std::filesystem::create_directories(section_dir, ec);
+
+    std::ofstream document_out(section_dir / "release.json");
+    std::ofstream meta_out(section_dir / "release.meta.json");
+
+    document_out << release.document.dump();
+    meta_out << json{ { "etag", release.etag }, { "checked_at", release.checked_at } }.dump();
+
+    return true;
+}
+
+bool lcl_mirror::fetch_asset(const json& asset, const std::filesystem::path& target) {
+    std::string url = asset.value("browser_download_url", "");
+    unsigned long long expected_size = asset.value("size", 0ULL);
+    std::string expected_sha256 = lcl_sha256::from_digest(asset.value("digest", ""));
+    auto part = target;
+    std::error_code ec;
+
+    part += ".part";
+
+    if (url.empty()) {
+        return false;
+    }
+
+    std::filesystem::create_directories(target.parent_path(), ec);
+
+    CURL* curl = lcl_net::instance().easy();
+    hashed_file out{ fopen(part.string().c_str(), "wb") };
+
+    if (!curl || !out.file) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror could not open %s\n", part.string().c_str());
+
+        if (curl) curl_easy_cleanup(curl);
+        if (out.file) fclose(out.file);
+        return false;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Mirror fetching %s from upstream.\n", url.c_str());
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HashingWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &out);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, StopCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &_stopping);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+
+    CURLcode res = lcl_net::instance().perform(curl, "mirror-download");
+    curl_off_t content_length = -1;
+
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    fclose(out.file);
+
+    // Without a size in the release the length announced by the host is the only check left.
+    if (expected_size == 0 && content_length > 0) {
+        expected_size = static_cast<unsigned long long>(content_length);
+    }
+
+    auto size = std::filesystem::file_size(part, ec);
+
+    // Nothing to check the copy against, a cut connection would go out as the asset.
+    if (res == CURLE_OK && expected_size == 0 && expected_sha256.empty()) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror refused to cache %s: upstream gave no size or digest.\n", url.c_str());
+        std::filesystem::remove(part, ec);
+        return false;
+    }
+
+    // Never publish a truncated or oversized copy to the fleet.
+    if (res != CURLE_OK || ec || (expected_size != 0 && size != expected_size)) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror download of %s failed (%s, %llu of %llu bytes).\n",
+            url.c_str(), curl_easy_strerror(res), static_cast<unsigned long long>(ec ? 0 : size), expected_size);
+        std::filesystem::remove(part, ec);
+        return false;
+    }
+
+    if (!expected_sha256.empty()) {
+        std::string actual = out.hash.finish();
+
+        if (actual != expected_sha256) {
+            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror download of %s failed SHA-256 verification (got %s).\n",
+                url.c_str(), actual.c_str());
+            std::filesystem::remove(part, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(part, target, ec);
+
+    if (ec) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Mirror could not store %s: %s\n", target.string().c_str(), ec.message().c_str());
+        return false;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Mirror cached %s (%llu bytes).\n", target.string().c_str(),
+        static_cast<unsigned long long>(size));
+
+    return true;
+}
+
+std::shared_ptr<lcl_mirror::_asset_fetch> lcl_mirror::asset_fetch_state(const std::string& key) {
+    std::lock_guard<std::mutex> lock(_fetches_lock);
+    auto& state = _fetches[key];
+
+    if (!state) {
+        state = std::make_shared<_asset_fetch>();
+    }
+
+    return state;
+}
@@ -0,0 +1,684 @@
+#include "lcl_net.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <random>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+extern retro_log_printf_t log_cb;
+
+static long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string hex_encode(const unsigned char* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+
+    out.reserve(size * 2);
+
+    for (size_t i = 0; i < size; i++) {
+        out.push_back(digits[data[i] >> 4]);
+        out.push_back(digits[data[i] & 0x0F]);
+    }
+
+    return out;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string hex_decode(const std::string& hex) {
+    std::string out;
+
+    if (hex.size() % 2 != 0) {
+        return out;
+    }
+
+    out.reserve(hex.size() / 2);
+
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        int high = hex_digit(hex[i]);
+        int low = hex_digit(hex[i + 1]);
+
+        if (high < 0 || low < 0) {
+            return {};
+        }
+
+        out.push_back(static_cast<char>((high << 4) | low));
+    }
+
+    return out;
+}
+
+// The files hold session secrets, keep them readable by the owner only.
+static void restrict_permissions(const std::filesystem::path& path) {
+    std::error_code ec;
+    std::filesystem::permissions(path,
+        std::filesystem::perms::owner_read | std::filesystem::perms::owner_write,
+        std::filesystem::perm_options::replace, ec);
+}
+
+size_t lcl_header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    auto* headers = static_cast<lcl_http_headers*>(userdata);
+    size_t totalSize = size * nitems;
+    std::string line(buffer, totalSize);
+    size_t colon = line.find(':');
+
+    // A new status line starts a new header block (e.g. after a redirect).
+    if (line.rfind("HTTP/", 0) == 0) {
+        headers->clear();
+        return totalSize;
+    }
+
+    if (colon == std::string::npos) {
+        return totalSize;
+    }
+
+    std::string name = line.substr(0, colon);
+    std::string value = line.substr(colon + 1);
+
+    for (auto& c : name) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+    (*headers)[name] = value;
+    return totalSize;
+}
+
+lcl_net& lcl_net::instance() {
+    static lcl_net net;
+    return net;
+}
+
+lcl_net::lcl_net() {
+    _share = nullptr;
+    _dns_ttl = 0;
+    _verbose = false;
+    _loaded = false;
+    _prewarm_cancel = false;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    init_share();
+}
+
+void lcl_net::init_share() {
+    _share = curl_share_init();
+
+    if (!_share) {
+        return;
+    }
+
+    curl_share_setopt(_share, CURLSHOPT_LOCKFUNC, lock_callback);
+    curl_share_setopt(_share, CURLSHOPT_UNLOCKFUNC, unlock_callback);
+    curl_share_setopt(_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+}
+
+void lcl_net::lock_callback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    static_cast<lcl_net*>(userptr)->_locks[data].lock();
+}
+
+void lcl_net::unlock_callback(CURL* handle, curl_lock_data data, void* userptr) {
+    static_cast<lcl_net*>(userptr)->_locks[data].unlock();
+}
+
+CURL* lcl_net::easy() {
+    CURL* curl = curl_easy_init();
+
+    if (!_share) {
+        init_share();
+    }
+
+    if (curl && _share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, _share);
+    }
+
+    if (curl && _verbose) {
+        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+    }
+
+    return curl;
+}
+
+void lcl_net::load(const std::filesystem::path& system_dir, const std::filesystem::path& stats_path, long long dns_ttl, bool verbose) {
+    {
+        std::lock_guard<std::mutex> guard(_state_lock);
+
+        if (_loaded) {
+            return;
+        }
+
+        _loaded = true;
+        _dns_ttl = dns_ttl;
+        _verbose = verbose;
+        _stats_path = stats_path;
+        _dns_cache_path = system_dir / "LCL.DnsCache.json";
+        _tls_cache_path = system_dir / "LCL.TlsSessions.json";
+        _rate_limit_path = system_dir / "LCL.RateLimit.json";
+    }
+
+    load_dns_cache();
+    load_tls_sessions();
+    load_rate_limits();
+}
+
+void lcl_net::load_dns_cache() {
+    std::ifstream cacheIn(_dns_cache_path);
+
+    if (!cacheIn.is_open()) {
+        return;
+    }
+
+    json cache = json::parse(cacheIn, nullptr, false);
+
+    if (cache.is_discarded() || !cache.is_object()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(_state_lock);
+    long long now = unix_now();
+
+    for (const auto& [host, entry] : cache.items()) {
+        _dns_entry dns;
+
+        dns.address = entry.value("address", "");
+        dns.expires = entry.value("expires", 0LL);
+
+        if (!dns.address.empty() && dns.expires > now) {
+            _dns_cache[host] = dns;
+        }
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Loaded %zu cached host addresses.\n", _dns_cache.size());
+}
+
+void lcl_net::load_tls_sessions() {
+    std::ifstream cacheIn(_tls_cache_path);
+
+    if (!cacheIn.is_open()) {
+        return;
+    }
+
+    json cache = json::parse(cacheIn, nullptr, false);
+
+    if (cache.is_discarded() || !cache.is_array()) {
+        return;
+    }
+
+    CURL* curl = easy();
+    size_t imported = 0;
+    long long now = unix_now();
+
+    for (const auto& entry : cache) {
+        std::string key = entry.value("session_key", "");
+        std::string shmac = hex_decode(entry.value("shmac", ""));
+        std::string sdata = hex_decode(entry.value("sdata", ""));
+
+        if (key.empty() || sdata.empty() || entry.value("valid_until", 0LL) <= now) {
+            continue;
+        }
+
+        CURLcode res = curl_easy_ssls_import(curl, key.c_str(),
+            reinterpret_cast<const unsigned char*>(shmac.data()), shmac.size(),
+            reinterpret_cast<const unsigned char*>(sdata.data()), sdata.size());
+
+        // Older or differently built libcurl cannot import, nothing else to do then.
+        if (res == CURLE_NOT_BUILT_IN || res == CURLE_UNKNOWN_OPTION) {
+            break;
+        }
+
+        if (res == CURLE_OK) {
+            imported++;
+        }
+    }
+
+    curl_easy_cleanup(curl);
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Imported %zu cached TLS sessions.\n", imported);
+}
+
+CURLcode lcl_net::export_callback(CURL* handle, void* userptr, const char* session_key,
+    const unsigned char* shmac, size_t shmac_len, const unsigned char* sdata, size_t sdata_len,
+    curl_off_t valid_until, int ietf_tls_id, const char* alpn, size_t earlydata_max) {
+    auto* sessions = static_cast<std::vector<_tls_session>*>(userptr);
+
+    if (valid_until > unix_now()) {
+        sessions->push_back({session_key, hex_encode(shmac, shmac_len), hex_encode(sdata, sdata_len),
+            static_cast<long long>(valid_until)});
+    }
+
+    return CURLE_OK;
+}
+
+void lcl_net::save() {
+    std::lock_guard<std::mutex> guard(_save_lock);
+
+    if (!_loaded) {
+        return;
+    }
+
+    save_dns_cache();
+    save_tls_sessions();
+}
+
+void lcl_net::save_dns_cache() {
+    json cache = json::object();
+
+    {
+        std::lock_guard<std::mutex> guard(_state_lock);
+        long long now = unix_now();
+
+        for (const auto& [host, entry] : _dns_cache) {
+            if (entry.expires > now) {
+                cache[host] = {{"address", entry.address}, {"expires", entry.expires}};
+            }
+        }
+    }
+
+    std::ofstream cacheOut(_dns_cache_path);
+
+    if (cacheOut.is_open()) {
+        cacheOut << cache.dump(4) << "\n";
+    }
+}
+
+void lcl_net::save_tls_sessions() {
+    std::vector<_tls_session> sessions;
+    CURL* curl = easy();
+    CURLcode res = curl_easy_ssls_export(curl, export_callback, &sessions);
+
+    curl_easy_cleanup(curl);
+
+    if (res != CURLE_OK) {
+        return;
+    }
+
+    json cache = json::array();
+
+    for (const auto& session : sessions) {
+        cache.push_back({
+            {"session_key", session.session_key},
+            {"shmac", session.shmac},
+            {"sdata", session.sdata},
+            {"valid_until", session.valid_until}
+        });
+    }
+
+    std::ofstream cacheOut(_tls_cache_path);
+
+    if (cacheOut.is_open()) {
+        cacheOut << cache.dump() << "\n";
+        cacheOut.close();
+        restrict_permissions(_tls_cache_path);
+    }
+}
+
+void lcl_net::cleanup() {
+    cancel_prewarm();
+    save();
+
+    if (_share) {
+        curl_share_cleanup(_share);
+        _share = nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(_state_lock);
+    _loaded = false;
+    _dns_cache.clear();
+}
+
+void lcl_net::remember_address(CURL* curl) {
+    char* effective_url = nullptr;
+    char* primary_ip = nullptr;
+    char* host = nullptr;
+    char* port = nullptr;
+
+    if (_dns_ttl <= 0 ||
+        curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url) != CURLE_OK || !effective_url ||
+        curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &primary_ip) != CURLE_OK || !primary_ip || !*primary_ip) {
+        return;
+    }
+
+    CURLU* url = curl_url();
+
+    if (curl_url_set(url, CURLUPART_URL, effective_url, 0) == CURLUE_OK &&
+        curl_url_get(url, CURLUPART_HOST, &host, 0) == CURLUE_OK &&
+        curl_url_get(url, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK &&
+        std::string(host) != primary_ip) {
+        std::lock_guard<std::mutex> guard(_state_lock);
+        _dns_cache[std::string(host) + ":" + port] = {primary_ip, unix_now() + _dns_ttl};
+    }
+
+    curl_free(host);
+    curl_free(port);
+    curl_url_cleanup(url);
+}
+
+CURLcode lcl_net::perform(CURL* curl, const char* kind) {
+    struct curl_slist* resolve = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(_state_lock);
+        long long now = unix_now();
+
+        // "+" entries behave like a regular lookup and time out from curl's own cache.
+        for (const auto& [host, entry] : _dns_cache) {
+            if (entry.expires > now) {
+                bool is_ipv6 = entry.address.find(':') != std::string::npos;
+                auto line = "+" + host + ":" + (is_ipv6 ? "[" + entry.address + "]" : entry.address);
+                resolve = curl_slist_append(resolve, line.c_str());
+            }
+        }
+    }
+
+    curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve);
+    CURLcode res = curl_easy_perform(curl);
+
+    curl_off_t connect_time = 0;
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect_time);
+
+    // A cached address that never connected is stale, forget it and resolve again.
+    if (resolve && connect_time == 0 && (res == CURLE_COULDNT_CONNECT || res == CURLE_OPERATION_TIMEDOUT)) {
+        struct curl_slist* forget = nullptr;
+
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Cached address did not answer, resolving again.\n");
+
+        {
+            std::lock_guard<std::mutex> guard(_state_lock);
+
+            for (const auto& [host, entry] : _dns_cache) {
+                forget = curl_slist_append(forget, ("-" + host).c_str());
+            }
+
+            _dns_cache.clear();
+        }
+
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, forget);
+        res = curl_easy_perform(curl);
+        curl_slist_free_all(forget);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_RESOLVE, nullptr);
+    curl_slist_free_all(resolve);
+
+    if (res == CURLE_OK) {
+        remember_address(curl);
+    }
+
+    report(curl, kind, res);
+
+    return res;
+}
+
+void lcl_net::finished(CURL* curl, const char* kind, CURLcode res) {
+    if (res == CURLE_OK) {
+        remember_address(curl);
+    }
+
+    report(curl, kind, res);
+}
+
+// Log the phase timings of a finished request and append them to the per-core stats file.
+void lcl_net::report(CURL* curl, const char* kind, CURLcode res) {
+    curl_off_t namelookup = 0, connect = 0, appconnect = 0, starttransfer = 0, total = 0, redirect = 0;
+    curl_off_t bytes = 0, speed = 0;
+    long response_code = 0;
+    long connects = 0;
+    char* effective_url = nullptr;
+
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_TIME_T, &redirect);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+    curl_easy_getinfo(curl, CURLINFO_SPEED_DOWNLOAD_T, &speed);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url);
+
+    // curl reports cumulative times in microseconds, split them into phases in milliseconds.
+    double dns_ms = namelookup / 1000.0;
+    double connect_ms = connect > namelookup ? (connect - namelookup) / 1000.0 : 0.0;
+    double tls_ms = appconnect > connect ? (appconnect - connect) / 1000.0 : 0.0;
+    double ttfb_ms = starttransfer / 1000.0;
+    double total_ms = total / 1000.0;
+    double speed_kbps = speed / 1024.0;
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-STATS] kind=%s http=%ld result=%d new_connections=%ld dns_ms=%.1f connect_ms=%.1f "
+        "tls_ms=%.1f ttfb_ms=%.1f redirect_ms=%.1f total_ms=%.1f bytes=%lld speed_kbps=%.1f\n",
+        kind, response_code, static_cast<int>(res), connects, dns_ms, connect_ms, tls_ms, ttfb_ms,
+        redirect / 1000.0, total_ms, static_cast<long long>(bytes), speed_kbps);
+
+    if (_stats_path.empty()) {
+        return;
+    }
+
+    json line = {
+        {"time", unix_now()},
+        {"kind", kind},
+        {"url", effective_url ? effective_url : ""},
+        {"http", response_code},
+        {"result", curl_easy_strerror(res)},
+        {"new_connections", connects},
+        {"dns_ms", dns_ms},
+        {"connect_ms", connect_ms},
+        {"tls_ms", tls_ms},
+        {"ttfb_ms", ttfb_ms},
+        {"redirect_ms", redirect / 1000.0},
+        {"total_ms", total_ms},
+        {"bytes", static_cast<long long>(bytes)},
+        {"speed_kbps", speed_kbps}
+    };
+
+    std::lock_guard<std::mutex> guard(_state_lock);
+    std::error_code ec;
+
+    // Keep one previous generation so the log cannot grow without bound.
+    if (std::filesystem::file_size(_stats_path, ec) > 1024 * 1024 && !ec) {
+        std::filesystem::rename(_stats_path, _stats_path.string() + ".1", ec);
+    }
+
+    std::ofstream statsOut(_stats_path, std::ios::app);
+
+    if (statsOut.is_open()) {
+        statsOut << line.dump() << "\n";
+    }
+}
+
+int lcl_net::prewarm_progress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    return static_cast<lcl_net*>(clientp)->_prewarm_cancel.load() ? 1 : 0;
+}
+
+void lcl_net::prewarm(const std::string& url) {
+    cancel_prewarm();
+    _prewarm_cancel = false;
+
+    _prewarm_thread = std::thread([this, url]() {
+        CURL* curl = easy();
+
+        if (!curl) {
+            return;
+        }
+
+        struct curl_slist* headers = curl_slist_append(nullptr, "User-Agent: curl/7.88.1");
+
+        // A complete request: a connect-only handle keeps its connection out of the shared pool
+        // and never reads the TLS 1.3 session ticket, which arrives after the handshake.
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, prewarm_progress);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+
+        CURLcode res = perform(curl, "prewarm");
+        curl_off_t connect_time = 0;
+
+        curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &connect_time);
+        curl_easy_cleanup(curl);
+        curl_slist_free_all(headers);
+
+        if (res == CURLE_OK) {
+            log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Connection pre-warmed (handshake %lld ms).\n",
+                static_cast<long long>(connect_time / 1000));
+        } else if (res != CURLE_ABORTED_BY_CALLBACK) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Connection pre-warm failed: %s\n", curl_easy_strerror(res));
+        }
+    });
+}
+
+void lcl_net::wait_prewarm() {
+    if (_prewarm_thread.joinable()) {
+        _prewarm_thread.join();
+    }
+}
+
+void lcl_net::cancel_prewarm() {
+    _prewarm_cancel = true;
+    wait_prewarm();
+}
+
+void lcl_net::load_rate_limits() {
+    std::ifstream stateIn(_rate_limit_path);
+
+    if (!stateIn.is_open()) {
+        return;
+    }
+
+    json state = json::parse(stateIn, nullptr, false);
+
+    if (state.is_discarded() || !state.is_object()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(_state_lock);
+
+    for (const auto& [resource, entry] : state.items()) {
+        _rate_limit limit;
+
+        limit.remaining = entry.value("remaining", -1LL);
+        limit.reset = entry.value("reset", 0LL);
+        limit.next_allowed = entry.value("next_allowed", 0LL);
+        limit.failures = entry.value("failures", 0);
+        _rate_limits[resource] = limit;
+    }
+}
+
+void lcl_net::save_rate_limits() {
+    json state = json::object();
+
+    for (const auto& [resource, limit] : _rate_limits) {
+        state[resource] = {
+            {"remaining", limit.remaining},
+            {"reset", limit.reset},
+            {"next_allowed", limit.next_allowed},
+            {"failures", limit.failures}
+        };
+    }
+
+    if (_rate_limit_path.empty()) {
+        return;
+    }
+
+    std::ofstream stateOut(_rate_limit_path);
+
+    if (stateOut.is_open()) {
+        stateOut << state.dump(4) << "\n";
+    }
+}
+
+bool lcl_net::rate_limit_allows(const std::string& resource, long long& wait_seconds) {
+    std::lock_guard<std::mutex> guard(_state_lock);
+    auto it = _rate_limits.find(resource);
+    long long now = unix_now();
+
+    wait_seconds = 0;
+
+    if (it == _rate_limits.end()) {
+        return true;
+    }
+
+    if (it->second.next_allowed > now) {
+        wait_seconds = it->second.next_allowed - now;
+    } else if (it->second.remaining == 0 && it->second.reset > now) {
+        wait_seconds = it->second.reset - now;
+    }
+
+    return wait_seconds == 0;
+}
+
+void lcl_net::rate_limit_update(const std::string& resource, long http_code, const lcl_http_headers& headers) {
+    static std::mt19937 rng(std::random_device{}());
+    auto header_value = [&headers](const char* name, long long fallback) {
+        auto it = headers.find(name);
+
+        if (it == headers.end()) {
+            return fallback;
+        }
+
+        try {
+            return std::stoll(it->second);
+        }
+        catch (const std::exception&) {
+            return fallback;
+        }
+    };
+
+    // No answer at all (DNS, connect or TLS failed) says nothing about the quota.
+    if (http_code == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(_state_lock);
+    auto& limit = _rate_limits[resource];
+    long long now = unix_now();
+    long long retry_after = header_value("retry-after", 0);
+
+    limit.remaining = header_value("x-ratelimit-remaining", limit.remaining);
+    limit.reset = header_value("x-ratelimit-reset", limit.reset);
+
+    if (http_code == 403 || http_code == 429 || http_code >= 500) {
+        // Spread the machines behind one NAT apart instead of retrying in lockstep.
+        std::uniform_real_distribution<double> jitter(0.5, 1.5);
+        long long backoff = std::min(60LL << std::min(limit.failures, 6), 3600LL);
+
+        limit.failures++;
+
+        if (limit.remaining == 0 && limit.reset > now) {
+            limit.next_allowed = limit.reset + static_cast<long long>(30 * jitter(rng));
+        } else if (retry_after > 0) {
+            limit.next_allowed = now + retry_after + static_cast<long long>(5 * jitter(rng));
+        } else {
+            limit.next_allowed = now + static_cast<long long>(backoff * jitter(rng));
+        }
+
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] GitHub %s API refused the request (HTTP %ld), next check in %lld seconds.\n",
+            resource.c_str(), http_code, limit.next_allowed - now);
+    } else {
+        limit.failures = 0;
+        limit.next_allowed = 0;
+    }
+
+    save_rate_limits();
+}
@@ -0,0 +1,258 @@
+#include "lcl_provider.hpp"
+#include "lcl_net.hpp"
+#include "libretro.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <system_error>
+
+extern retro_log_printf_t log_cb;
+
+// libcurl callback, parses the release JSON as it streams in.
+// Returning 0 aborts the transfer once the tag and matching asset are known.
+static size_t ReleaseParserCallback(void* contents, size_t size, size_t nmemb, lcl_release_parser* parser) {
+    size_t totalSize = size * nmemb;
+
+    if (!parser->feed((const char*)contents, totalSize) || parser->complete()) {
+        return 0;
+    }
+
+    return totalSize;
+}
+
+// Only github's API gets to see the token, never mirrors or download hosts.
+static bool is_github_api(const std::string& url) {
+    return url.rfind("https://api.github.com/", 0) == 0;
+}
+
+// Stable 31 bit version id for assets that don't carry one, it ends up in the version files.
+static long long derive_asset_id(const std::string& key) {
+    uint32_t hash = 2166136261u;
+
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+
+    hash &= 0x7FFFFFFF;
+    return hash == 0 ? 1 : hash;
+}
+
+static std::filesystem::path file_url_to_path(const std::string& url) {
+    std::string path = url.substr(std::string("file://").size());
+
+    if (path.rfind("localhost/", 0) == 0) {
+        path.erase(0, std::string("localhost").size());
+    }
+
+#ifdef _WIN32
+    // file:///C:/mirror -> C:/mirror
+    if (path.size() > 2 && path[0] == '/' && path[2] == ':') {
+        path.erase(0, 1);
+    }
+#endif
+
+    return std::filesystem::path(path);
+}
+
+static std::string path_to_file_url(const std::filesystem::path& path) {
+    std::string generic = path.generic_string();
+
+    return generic.rfind("/", 0) == 0 ? "file://" + generic : "file:///" + generic;
+}
+
+// GitHub "releases/latest" and every API copying its schema: Gitea, Forgejo and static index files.
+class lcl_json_release_provider : public lcl_release_provider {
+public:
+    lcl_json_release_provider(const char* name, bool github) : _name(name), _github(github) {}
+
+    const char* name() const override {
+        return _name;
+    }
+
+    lcl_fetch_result fetch(CURL* curl, CURLcode& res, const lcl_release_request& request,
+        lcl_release_cache& cache, std::string& error) override {
+        lcl_release_parser parser(request.search_token);
+        lcl_http_headers responseHeaders;
+        long responseCode = 0;
+        bool github_api = _github && is_github_api(request.url);
+        long long wait_seconds = 0;
+
+        // Don't spend a launch on a request github is going to refuse.
+        if (github_api && !lcl_net::instance().rate_limit_allows("core", wait_seconds)) {
+            error = std::format("rate limited for {} more seconds", wait_seconds);
+            return lcl_fetch_result::FAILED;
+        }
+
+        curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+
+        struct curl_slist* headers = nullptr;
+        headers = curl_slist_append(headers, "Accept: application/json");
+        headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+        // Authenticated requests get 5000 requests per hour per token instead of 60 per IP.
+        if (github_api && !request.api_token.empty()) {
+            headers = curl_slist_append(headers, std::format("Authorization: Bearer {}", request.api_token).c_str());
+        }
+
+        // Conditional request, the server answers 304 without a body when nothing changed.
+        if (!cache.etag.empty()) {
+            headers = curl_slist_append(headers, std::format("If-None-Match: {}", cache.etag).c_str());
+        }
+        else if (!cache.last_modified.empty()) {
+            headers = curl_slist_append(headers, std::format("If-Modified-Since: {}", cache.last_modified).c_str());
+        }
+
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, ReleaseParserCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &parser);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lcl_header_callback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        res = lcl_net::instance().perform(curl, "metadata");
+
+        curl_slist_free_all(headers);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, nullptr);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, nullptr);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+
+        if (github_api) {
+            lcl_net::instance().rate_limit_update("core", responseCode, responseHeaders);
+        }
+
+        // The callback stops the transfer early once everything needed has been parsed.
+        if (res == CURLE_WRITE_ERROR && parser.complete()) {
+            log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Release metadata parsed after %zu bytes.\n", parser.bytes_parsed());
+            res = CURLE_OK;
+        }
+
+        if (res == CURLE_OK && responseCode == 304 && !cache.tag.empty()) {
+            return lcl_fetch_result::NOT_MODIFIED;
+        }
+
+        // file:// index files have no status code.
+        if (res != CURLE_OK || responseCode >= 400 || parser.bytes_parsed() == 0) {
+            error = std::format("{}, HTTP {}", curl_easy_strerror(res), responseCode);
+            return lcl_fetch_result::FAILED;
+        }
+
+        if (parser.failed() || parser.tag().empty()) {
+            error = "invalid JSON structure";
+            return lcl_fetch_result::FAILED;
+        }
+
+        if (!parser.has_asset()) {
+            error = std::format("no asset found matching token {}", request.search_token);
+            return lcl_fetch_result::FAILED;
+        }
+
+        cache.tag = parser.tag();
+        cache.asset = parser.asset();
+        cache.etag = responseHeaders.count("etag") ? responseHeaders["etag"] : "";
+        cache.last_modified = responseHeaders.count("last-modified") ? responseHeaders["last-modified"] : "";
+
+        // Hand written index files may leave the id out.
+        if (cache.asset.id == 0) {
+            cache.asset.id = derive_asset_id(cache.tag + "/" + cache.asset.download_url);
+        }
+
+        return lcl_fetch_result::UPDATED;
+    }
+
+private:
+    const char* _name;
+    bool _github;
+};
+
+// A local or mounted directory of archives (API_URL=file:///srv/emulators/pcsx2), the newest
+// file matching the search token is the latest release. Nothing is downloaded for the lookup.
+class lcl_directory_release_provider : public lcl_release_provider {
+public:
+    const char* name() const override {
+        return "file";
+    }
+
+    lcl_fetch_result fetch(CURL* curl, CURLcode& res, const lcl_release_request& request,
+        lcl_release_cache& cache, std::string& error) override {
+        std::error_code ec;
+        std::filesystem::path newest;
+        std::filesystem::file_time_type newest_time{};
+        uintmax_t newest_size = 0;
+
+        if (request.url.rfind("file://", 0) != 0) {
+            error = "the file provider needs a file:// API_URL";
+            return lcl_fetch_result::FAILED;
+        }
+
+        auto directory = file_url_to_path(request.url);
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            std::error_code entry_ec;
+
+            if (!entry.is_regular_file(entry_ec) ||
+                entry.path().filename().string().find(request.search_token) == std::string::npos) {
+                continue;
+            }
+
+            auto time = entry.last_write_time(entry_ec);
+
+            if (!entry_ec && (newest.empty() || time > newest_time)) {
+                newest = entry.path();
+                newest_time = time;
+                newest_size = entry.file_size(entry_ec);
+            }
+        }
+
+        res = CURLE_OK;
+
+        if (ec) {
+            error = std::format("cannot read {}: {}", directory.string(), ec.message());
+            return lcl_fetch_result::FAILED;
+        }
+
+        if (newest.empty()) {
+            error = std::format("no file matching token {} in {}", request.search_token, directory.string());
+            return lcl_fetch_result::FAILED;
+        }
+
+        std::string file_name = newest.filename().string();
+        long long ticks = static_cast<long long>(newest_time.time_since_epoch().count());
+        long long id = derive_asset_id(std::format("{}/{}/{}", file_name, newest_size, ticks));
+
+        if (cache.asset.id == id && cache.asset.name == file_name) {
+            return lcl_fetch_result::NOT_MODIFIED;
+        }
+
+        cache.tag = file_name;
+        cache.asset.id = id;
+        cache.asset.name = file_name;
+        cache.asset.download_url = path_to_file_url(std::filesystem::absolute(newest, ec));
+        cache.etag.clear();
+        cache.last_modified.clear();
+
+        return lcl_fetch_result::UPDATED;
+    }
+};
+
+std::unique_ptr<lcl_release_provider> lcl_make_release_provider(const std::string& name) {
+    if (name == "github") {
+        return std::make_unique<lcl_json_release_provider>("github", true);
+    }
+
+    if (name == "gitea" || name == "forgejo") {
+        return std::make_unique<lcl_json_release_provider>("gitea", false);
+    }
+
+    if (name == "index") {
+        return std::make_unique<lcl_json_release_provider>("index", false);
+    }
+
+    if (name == "file") {
+        return std::make_unique<lcl_directory_release_provider>();
+    }
+
+    return nullptr;
+}
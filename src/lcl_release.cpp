@@ -0,0 +1,557 @@
+#include "lcl_release.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+static bool is_json_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+lcl_release_parser::lcl_release_parser(std::string search_token) {
+    _search_token = std::move(search_token);
+    _has_asset = false;
+    _assets_done = false;
+    _state_id = _state::VALUE;
+    _capture_id = _capture::NONE;
+    _in_assets = false;
+    _string_is_key = false;
+    _unicode_value = 0;
+    _unicode_digits = 0;
+    _high_surrogate = 0;
+    _bytes = 0;
+}
+
+bool lcl_release_parser::feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (!step(data[i])) {
+            _state_id = _state::FAILED;
+            return false;
+        }
+    }
+
+    _bytes += size;
+    return true;
+}
+
+bool lcl_release_parser::complete() const {
+    return _has_asset && _assets_done && !_tag.empty();
+}
+
+bool lcl_release_parser::failed() const {
+    return _state_id == _state::FAILED;
+}
+
+size_t lcl_release_parser::bytes_parsed() const {
+    return _bytes;
+}
+
+const std::string& lcl_release_parser::tag() const {
+    return _tag;
+}
+
+const lcl_release_asset& lcl_release_parser::asset() const {
+    return _asset;
+}
+
+bool lcl_release_parser::has_asset() const {
+    return _has_asset;
+}
+
+bool lcl_release_parser::step(char c) {
+    switch (_state_id) {
+    case _state::VALUE:
+        if (is_json_space(c)) return true;
+
+        if (c == '{') {
+            _state_id = _state::OBJECT_KEY_OR_END;
+            return open_container(true);
+        }
+
+        if (c == '[') {
+            _state_id = _state::ARRAY_VALUE_OR_END;
+            return open_container(false);
+        }
+
+        if (c == '"') {
+            begin_value_string();
+            return true;
+        }
+
+        if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+            _literal.assign(1, c);
+            _state_id = _state::LITERAL;
+            return true;
+        }
+
+        return false;
+
+    case _state::ARRAY_VALUE_OR_END:
+        if (is_json_space(c)) return true;
+
+        if (c == ']') {
+            _state_id = _state::AFTER_VALUE;
+            return close_container(false);
+        }
+
+        _state_id = _state::VALUE;
+        return step(c);
+
+    case _state::OBJECT_KEY_OR_END:
+    case _state::OBJECT_KEY:
+        if (is_json_space(c)) return true;
+
+        if (c == '}' && _state_id == _state::OBJECT_KEY_OR_END) {
+            _state_id = _state::AFTER_VALUE;
+            return close_container(true);
+        }
+
+        if (c != '"') return false;
+
+        // Keys are only remembered where they matter: the root object and each asset object.
+        _string_is_key = true;
+        _capture_id = (_stack.size() == 1 || (_in_assets && _stack.size() == 3)) ? _capture::KEY : _capture::NONE;
+        _buffer.clear();
+        _state_id = _state::STRING;
+        return true;
+
+    case _state::COLON:
+        if (is_json_space(c)) return true;
+        if (c != ':') return false;
+
+        _state_id = _state::VALUE;
+        return true;
+
+    case _state::AFTER_VALUE:
+        if (is_json_space(c)) return true;
+        if (_stack.empty()) return false;
+
+        if (c == ',') {
+            _state_id = _stack.back() ? _state::OBJECT_KEY : _state::VALUE;
+            return true;
+        }
+
+        if (c == '}' || c == ']') {
+            return close_container(c == '}');
+        }
+
+        return false;
+
+    case _state::STRING:
+        if (c == '"') {
+            end_string();
+            return true;
+        }
+
+        if (c == '\\') {
+            _state_id = _state::STRING_ESCAPE;
+            return true;
+        }
+
+        if (static_cast<unsigned char>(c) < 0x20) return false;
+
+        if (_capture_id != _capture::NONE && _buffer.size() < MAX_CAPTURE) {
+            _buffer.push_back(c);
+        }
+
+        return true;
+
+    case _state::STRING_ESCAPE: {
+        char decoded = 0;
+
+        switch (c) {
+        case '"': decoded = '"'; break;
+        case '\\': decoded = '\\'; break;
+        case '/': decoded = '/'; break;
+        case 'b': decoded = '\b'; break;
+        case 'f': decoded = '\f'; break;
+        case 'n': decoded = '\n'; break;
+        case 'r': decoded = '\r'; break;
+        case 't': decoded = '\t'; break;
+        case 'u':
+            _unicode_value = 0;
+            _unicode_digits = 0;
+            _state_id = _state::STRING_UNICODE;
+            return true;
+        default:
+            return false;
+        }
+
+        append_captured(std::string(1, decoded));
+        _state_id = _state::STRING;
+        return true;
+    }
+
+    case _state::STRING_UNICODE: {
+        int digit = hex_value(c);
+
+        if (digit < 0) return false;
+
+        _unicode_value = (_unicode_value << 4) | static_cast<unsigned>(digit);
+
+        if (++_unicode_digits < 4) return true;
+
+        _state_id = _state::STRING;
+
+        if (_unicode_value >= 0xD800 && _unicode_value <= 0xDBFF) {
+            _high_surrogate = _unicode_value;
+        } else if (_unicode_value >= 0xDC00 && _unicode_value <= 0xDFFF && _high_surrogate != 0) {
+            append_codepoint(0x10000 + ((_high_surrogate - 0xD800) << 10) + (_unicode_value - 0xDC00));
+            _high_surrogate = 0;
+        } else {
+            append_codepoint(_unicode_value);
+        }
+
+        return true;
+    }
+
+    case _state::LITERAL:
+        if (c == '+' || c == '-' || c == '.' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == 'E') {
+            if (_literal.size() >= MAX_LITERAL) return false;
+
+            _literal.push_back(c);
+            return true;
+        }
+
+        if (!end_literal()) return false;
+
+        _state_id = _state::AFTER_VALUE;
+        return step(c);
+
+    case _state::FAILED:
+        return false;
+    }
+
+    return false;
+}
+
+void lcl_release_parser::begin_value_string() {
+    _string_is_key = false;
+    _capture_id = _capture::NONE;
+    _buffer.clear();
+
+    if (_stack.size() == 1 && _root_key == "tag_name") {
+        _capture_id = _capture::TAG;
+    } else if (_in_assets && _stack.size() == 3) {
+        if (_asset_key == "name") {
+            _capture_id = _capture::ASSET_NAME;
+        } else if (_asset_key == "browser_download_url") {
+            _capture_id = _capture::ASSET_URL;
+        } else if (_asset_key == "digest") {
+            _capture_id = _capture::ASSET_DIGEST;
+        }
+    }
+
+    _state_id = _state::STRING;
+}
+
+void lcl_release_parser::end_string() {
+    if (_string_is_key) {
+        if (_capture_id == _capture::KEY) {
+            (_stack.size() == 1 ? _root_key : _asset_key) = _buffer;
+        }
+
+        _state_id = _state::COLON;
+    } else {
+        switch (_capture_id) {
+        case _capture::TAG: _tag = _buffer; break;
+        case _capture::ASSET_NAME: _candidate.name = _buffer; break;
+        case _capture::ASSET_URL: _candidate.download_url = _buffer; break;
+        case _capture::ASSET_DIGEST: _candidate.digest = _buffer; break;
+        default: break;
+        }
+
+        _state_id = _state::AFTER_VALUE;
+    }
+
+    _capture_id = _capture::NONE;
+    _high_surrogate = 0;
+}
+
+bool lcl_release_parser::end_literal() {
+    if (_literal == "true" || _literal == "false" || _literal == "null") {
+        return true;
+    }
+
+    char* end = nullptr;
+    std::strtod(_literal.c_str(), &end);
+
+    if (end == _literal.c_str() || *end != '\0') {
+        return false;
+    }
+
+    if (_in_assets && _stack.size() == 3 && _asset_key == "id") {
+        _candidate.id = std::strtoll(_literal.c_str(), nullptr, 10);
+    }
+
+    return true;
+}
+
+bool lcl_release_parser::open_container(bool is_object) {
+    if (_stack.size() >= MAX_DEPTH) {
+        return false;
+    }
+
+    if (!is_object && _stack.size() == 1 && _root_key == "assets") {
+        _in_assets = true;
+    } else if (is_object && _in_assets && _stack.size() == 2) {
+        _candidate = lcl_release_asset{};
+        _asset_key.clear();
+    }
+
+    _stack.push_back(is_object);
+    return true;
+}
+
+bool lcl_release_parser::close_container(bool is_object) {
+    if (_stack.empty() || _stack.back() != is_object) {
+        return false;
+    }
+
+    _stack.pop_back();
+
+    if (is_object && _in_assets && _stack.size() == 2) {
+        // An asset element is complete, the first one matching the token wins. Matching zsync
+        // files are set aside until the list is over, they can come before their asset.
+        bool matching = !_candidate.download_url.empty() && _candidate.name.find(_search_token) != std::string::npos;
+
+        if (matching && lcl_is_zsync_name(_candidate.name)) {
+            _zsync_assets.emplace_back(_candidate.name, _candidate.download_url);
+        } else if (matching && !_has_asset) {
+            _asset = _candidate;
+            _has_asset = true;
+        }
+    } else if (!is_object && _in_assets && _stack.size() == 1) {
+        _in_assets = false;
+        _assets_done = true;
+
+        for (const auto& [name, url] : _zsync_assets) {
+            if (_has_asset && name == _asset.name + ".zsync") {
+                _asset.zsync_url = url;
+            }
+        }
+    }
+
+    _state_id = _state::AFTER_VALUE;
+    return true;
+}
+
+void lcl_release_parser::append_captured(const std::string& utf8) {
+    if (_capture_id != _capture::NONE && _buffer.size() + utf8.size() <= MAX_CAPTURE) {
+        _buffer += utf8;
+    }
+}
+
+void lcl_release_parser::append_codepoint(unsigned codepoint) {
+    std::string utf8;
+
+    if (codepoint < 0x80) {
+        utf8.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800) {
+        utf8.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+        utf8.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+        utf8.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+        utf8.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        utf8.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    } else {
+        utf8.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+        utf8.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+        utf8.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+        utf8.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    }
+
+    append_captured(utf8);
+}
+
+bool lcl_is_zsync_name(const std::string& name) {
+    return name.size() > 6 && name.compare(name.size() - 6, 6, ".zsync") == 0;
+}
+
+bool lcl_release_cache::load(const std::string& path) {
+    std::ifstream cacheIn(path);
+
+    if (!cacheIn.is_open()) {
+        return false;
+    }
+
+    json cache = json::parse(cacheIn, nullptr, false);
+
+    if (cache.is_discarded() || !cache.is_object()) {
+        return false;
+    }
+
+    search_token = cache.value("search_token", "");
+    tag = cache.value("tag_name", "");
+    asset.id = cache.value("asset_id", 0LL);
+    asset.name = cache.value("asset_name", "");
+    asset.download_url = cache.value("download_url", "");
+    asset.digest = cache.value("digest", "");
+    asset.zsync_url = cache.value("zsync_url", "");
+    etag = cache.value("etag", "");
+    last_modified = cache.value("last_modified", "");
+    checked_at = cache.value("checked_at", 0LL);
+
+    return true;
+}
+
+bool lcl_release_cache::save(const std::string& path) const {
+    json cache = {
+        {"search_token", search_token},
+        {"tag_name", tag},
+        {"asset_id", asset.id},
+        {"asset_name", asset.name},
+        {"download_url", asset.download_url},
+        {"digest", asset.digest},
+        {"zsync_url", asset.zsync_url},
+        {"etag", etag},
+        {"last_modified", last_modified},
+        {"checked_at", checked_at}
+    };
+
+    // Renamed over the cache once complete: the batched query writes the caches of other cores,
+    // which may be reading theirs at the same time. The temp name is per process for the same reason.
+    std::string temp = path + ".tmp." + std::to_string(getpid());
+    std::error_code ec;
+
+    {
+        std::ofstream cacheOut(temp, std::ios::trunc);
+
+        if (!cacheOut.is_open() || !(cacheOut << cache.dump(4) << "\n")) {
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temp, path, ec);
+
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+
+    return true;
+}
+
+bool lcl_parse_repo_url(const std::string& api_url, std::string& owner, std::string& repo) {
+    static const std::regex repo_pattern(R"(/repos/([^/]+)/([^/]+)/releases)");
+    std::smatch match;
+
+    if (!std::regex_search(api_url, match, repo_pattern)) {
+        return false;
+    }
+
+    owner = match[1];
+    repo = match[2];
+    return true;
+}
+
+std::string lcl_build_graphql_query(const std::vector<lcl_release_target>& targets) {
+    std::string query = "query {";
+
+    // Each repository gets an alias (r0, r1, ...) matching its index in targets.
+    for (size_t i = 0; i < targets.size(); i++) {
+        query += " r" + std::to_string(i) + ": repository(owner: " + json(targets[i].owner).dump() +
+            ", name: " + json(targets[i].repo).dump() + ") {"
+            " latestRelease { tagName releaseAssets(first: 100) { nodes { databaseId name downloadUrl digest } } } }";
+    }
+
+    query += " }";
+
+    return json{{"query", query}}.dump();
+}
+
+bool lcl_parse_graphql_releases(const std::string& response, const std::vector<lcl_release_target>& targets,
+    std::vector<std::pair<std::string, lcl_release_cache>>& releases, std::string& error) {
+    json parsed = json::parse(response, nullptr, false);
+
+    if (parsed.is_discarded() || !parsed.is_object()) {
+        error = "invalid JSON";
+        return false;
+    }
+
+    // Errors for single repositories are reported but do not void the rest of the batch.
+    if (parsed.contains("errors") && parsed["errors"].is_array() && !parsed["errors"].empty()) {
+        error = parsed["errors"][0].value("message", "unknown error");
+    }
+
+    if (!parsed.contains("data") || !parsed["data"].is_object()) {
+        if (error.empty()) {
+            error = "missing data";
+        }
+
+        return false;
+    }
+
+    const auto& data = parsed["data"];
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        auto alias = "r" + std::to_string(i);
+
+        if (!data.contains(alias) || !data[alias].is_object() || !data[alias]["latestRelease"].is_object()) {
+            continue;
+        }
+
+        const auto& release = data[alias]["latestRelease"];
+        const auto& nodes = release["releaseAssets"]["nodes"];
+        lcl_release_cache cache;
+
+        cache.search_token = targets[i].search_token;
+        cache.tag = release.value("tagName", "");
+
+        if (!nodes.is_array()) {
+            continue;
+        }
+
+        for (const auto& node : nodes) {
+            std::string name = node.value("name", "");
+
+            if (name.find(targets[i].search_token) != std::string::npos && !lcl_is_zsync_name(name)) {
+                cache.asset.id = node.value("databaseId", 0LL);
+                cache.asset.name = name;
+                cache.asset.download_url = node.value("downloadUrl", "");
+
+                // null for assets uploaded before GitHub started hashing them.
+                if (node.contains("digest") && node["digest"].is_string()) {
+                    cache.asset.digest = node["digest"].get<std::string>();
+                }
+
+                break;
+            }
+        }
+
+        for (const auto& node : nodes) {
+            if (!cache.asset.name.empty() && node.value("name", "") == cache.asset.name + ".zsync") {
+                cache.asset.zsync_url = node.value("downloadUrl", "");
+            }
+        }
+
+        if (!cache.tag.empty() && !cache.asset.download_url.empty()) {
+            releases.emplace_back(targets[i].section, cache);
+        }
+    }
+
+    return true;
+}
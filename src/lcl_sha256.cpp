@@ -0,0 +1,264 @@
+#include "lcl_sha256.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LCL_SHA256_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LCL_TARGET_SHA
+#else
+#include <cpuid.h>
+#define LCL_TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#endif
+
+alignas(16) static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static void compress_generic(uint32_t state[8], const uint8_t* blocks, size_t count) {
+    for (; count > 0; count--, blocks += 64) {
+        uint32_t w[64];
+
+        for (int t = 0; t < 16; t++) {
+            w[t] = (uint32_t(blocks[t * 4]) << 24) | (uint32_t(blocks[t * 4 + 1]) << 16) |
+                (uint32_t(blocks[t * 4 + 2]) << 8) | uint32_t(blocks[t * 4 + 3]);
+        }
+
+        for (int t = 16; t < 64; t++) {
+            uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 64; t++) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef LCL_SHA256_X86
+static bool cpu_has_sha() {
+    unsigned int leaf1[4] = {};
+    unsigned int leaf7[4] = {};
+
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+
+    if (info[0] < 7) {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    std::memcpy(leaf1, info, sizeof(info));
+    __cpuidex(info, 7, 0);
+    std::memcpy(leaf7, info, sizeof(info));
+#else
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+
+    __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+    __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+#endif
+
+    bool ssse3 = (leaf1[2] >> 9) & 1;
+    bool sse41 = (leaf1[2] >> 19) & 1;
+    bool sha = (leaf7[1] >> 29) & 1;
+
+    return ssse3 && sse41 && sha;
+}
+
+// Four rounds per sha256rnds2 pair, the message schedule is kept in four registers and
+// extended with sha256msg1/sha256msg2 as the rounds go.
+LCL_TARGET_SHA static void compress_sha_ni(uint32_t state[8], const uint8_t* blocks, size_t count) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);                  // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);            // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);    // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);         // CDGH
+
+    for (; count > 0; count--, blocks += 64) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i w[4];
+
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i * 16)), byte_swap);
+            } else {
+                __m128i extended = _mm_add_epi32(_mm_sha256msg1_epu32(w[i % 4], w[(i - 3) % 4]),
+                    _mm_alignr_epi8(w[(i - 1) % 4], w[(i - 2) % 4], 4));
+                w[i % 4] = _mm_sha256msg2_epu32(extended, w[(i - 1) % 4]);
+            }
+
+            __m128i message = _mm_add_epi32(w[i % 4], _mm_load_si128(reinterpret_cast<const __m128i*>(&K[i * 4])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            message = _mm_shuffle_epi32(message, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);               // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);            // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);         // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);            // ABEF
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+#endif
+
+bool lcl_sha256::accelerated() {
+#ifdef LCL_SHA256_X86
+    static const bool has_sha = cpu_has_sha();
+    return has_sha;
+#else
+    return false;
+#endif
+}
+
+std::string lcl_sha256::from_digest(const std::string& digest) {
+    std::string hex = digest.rfind("sha256:", 0) == 0 ? digest.substr(7) : "";
+
+    std::transform(hex.begin(), hex.end(), hex.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    bool valid = hex.size() == 64 && std::all_of(hex.begin(), hex.end(), [](unsigned char c) { return std::isxdigit(c); });
+    return valid ? hex : "";
+}
+
+bool lcl_sha256::file(const std::string& path, std::string& hex) {
+    FILE* in = fopen(path.c_str(), "rb");
+    std::vector<char> buffer(1024 * 1024);
+    lcl_sha256 hash;
+    size_t got;
+
+    if (!in) {
+        return false;
+    }
+
+    while ((got = fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+        hash.update(buffer.data(), got);
+    }
+
+    bool ok = !ferror(in);
+    fclose(in);
+
+    hex = ok ? hash.finish() : "";
+    return ok;
+}
+
+lcl_sha256::lcl_sha256() {
+    reset();
+}
+
+void lcl_sha256::reset() {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    std::memcpy(_state, initial, sizeof(_state));
+    _buffered = 0;
+    _length = 0;
+}
+
+void lcl_sha256::compress(const uint8_t* blocks, size_t count) {
+#ifdef LCL_SHA256_X86
+    if (accelerated()) {
+        compress_sha_ni(_state, blocks, count);
+        return;
+    }
+#endif
+    compress_generic(_state, blocks, count);
+}
+
+void lcl_sha256::update(const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+
+    _length += size;
+
+    if (_buffered > 0) {
+        size_t take = std::min(size, sizeof(_buffer) - _buffered);
+
+        std::memcpy(_buffer + _buffered, bytes, take);
+        _buffered += take;
+        bytes += take;
+        size -= take;
+
+        if (_buffered < sizeof(_buffer)) {
+            return;
+        }
+
+        compress(_buffer, 1);
+        _buffered = 0;
+    }
+
+    // Whole blocks straight from the caller's buffer.
+    if (size >= 64) {
+        compress(bytes, size / 64);
+        bytes += size & ~size_t(63);
+        size &= 63;
+    }
+
+    std::memcpy(_buffer, bytes, size);
+    _buffered = size;
+}
+
+std::string lcl_sha256::finish() {
+    static const char digits[] = "0123456789abcdef";
+    uint64_t bit_length = _length * 8;
+    uint8_t padding[72] = { 0x80 };
+    size_t padding_size = (_buffered < 56 ? 56 : 120) - _buffered;
+    uint8_t length_bytes[8];
+    std::string hex;
+
+    for (int i = 0; i < 8; i++) {
+        length_bytes[i] = static_cast<uint8_t>(bit_length >> (56 - i * 8));
+    }
+
+    update(padding, padding_size);
+    update(length_bytes, sizeof(length_bytes));
+
+    for (uint32_t word : _state) {
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            hex.push_back(digits[(word >> shift) & 0x0F]);
+        }
+    }
+
+    return hex;
+}
@@ -0,0 +1,764 @@
+#include "lcl_squashfs.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+#include <libdeflate.h>
+#include <lzma.h>
+#include <zstd.h>
+
+extern retro_log_printf_t log_cb;
+
+static constexpr uint32_t SQUASHFS_MAGIC = 0x73717368;
+static constexpr size_t SUPERBLOCK_SIZE = 96;
+static constexpr size_t METADATA_SIZE = 8192;
+static constexpr uint16_t METADATA_UNCOMPRESSED = 0x8000;
+static constexpr uint32_t BLOCK_UNCOMPRESSED = 1u << 24;
+static constexpr size_t FRAGMENT_ENTRY_SIZE = 16;
+static constexpr size_t FRAGMENTS_PER_BLOCK = METADATA_SIZE / FRAGMENT_ENTRY_SIZE;
+
+static constexpr uint16_t COMPRESSION_GZIP = 1;
+static constexpr uint16_t COMPRESSION_XZ = 4;
+static constexpr uint16_t COMPRESSION_ZSTD = 6;
+
+static constexpr uint16_t INODE_DIRECTORY = 1;
+static constexpr uint16_t INODE_FILE = 2;
+static constexpr uint16_t INODE_SYMLINK = 3;
+static constexpr uint16_t INODE_EXT_DIRECTORY = 8;
+static constexpr uint16_t INODE_EXT_FILE = 9;
+static constexpr uint16_t INODE_EXT_SYMLINK = 10;
+
+static constexpr size_t MAX_DEPTH = 256;
+static constexpr uint32_t MAX_DIRECTORY_RUN = 256;
+static constexpr uint32_t MAX_SYMLINK_SIZE = 4096;
+
+static uint16_t read_le16(const unsigned char* data) {
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static uint32_t read_le32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+        (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static uint64_t read_le64(const unsigned char* data) {
+    return static_cast<uint64_t>(read_le32(data)) | (static_cast<uint64_t>(read_le32(data + 4)) << 32);
+}
+
+// One per thread, neither libdeflate nor zstd contexts may be shared.
+struct lcl_squashfs_extractor::_codec {
+    explicit _codec(uint16_t compression)
+        : inflater(compression == COMPRESSION_GZIP ? libdeflate_alloc_decompressor() : nullptr),
+          zstd(compression == COMPRESSION_ZSTD ? ZSTD_createDCtx() : nullptr) {
+    }
+
+    ~_codec() {
+        if (inflater) {
+            libdeflate_free_decompressor(inflater);
+        }
+
+        if (zstd) {
+            ZSTD_freeDCtx(zstd);
+        }
+    }
+
+    _codec(const _codec&) = delete;
+    _codec& operator=(const _codec&) = delete;
+
+    libdeflate_decompressor* inflater;
+    ZSTD_DCtx* zstd;
+};
+
+lcl_squashfs_extractor::lcl_squashfs_extractor(std::filesystem::path image, std::filesystem::path target)
+    : _image(std::move(image)), _target(std::move(target)), _offset(0), _image_size(0), _block_size(0), _compression(0),
+      _inode_count(0), _fragment_count(0), _root_inode(0), _inode_table(0), _directory_table(0), _fragment_table(0),
+      _failed(false), _bytes(0) {
+}
+
+// The first error is kept, the other threads stop before their next job.
+bool lcl_squashfs_extractor::fail(std::string error) {
+    std::lock_guard<std::mutex> lock(_error_lock);
+
+    if (!_failed.exchange(true)) {
+        _error = std::move(error);
+    }
+
+    return false;
+}
+
+// Positions are relative to the squashfs image, which starts behind the runtime in an AppImage.
+bool lcl_squashfs_extractor::read_at(std::ifstream& in, uint64_t position, void* data, size_t size) {
+    if (position > _image_size || size > _image_size - position) {
+        return false;
+    }
+
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(_offset + position));
+
+    return static_cast<bool>(in.read(static_cast<char*>(data), static_cast<std::streamsize>(size)));
+}
+
+// An AppImage is an ELF runtime with the image appended right after its section header table,
+// which is where the runtime itself looks for it. Anything else is taken for a bare image.
+bool lcl_squashfs_extractor::find_image(std::ifstream& in) {
+    unsigned char header[64] = {};
+    std::error_code ec;
+    uint64_t file_size = std::filesystem::file_size(_image, ec);
+
+    if (ec) {
+        return fail("could not open " + _image.string());
+    }
+
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.clear();
+
+    if (std::memcmp(header, "\x7f" "ELF", 4) == 0) {
+        if (header[5] != 1) {
+            return fail("unsupported AppImage runtime in " + _image.string());
+        }
+
+        if (header[4] == 2) {
+            _offset = read_le64(header + 0x28) + static_cast<uint64_t>(read_le16(header + 0x3A)) * read_le16(header + 0x3C);
+        } else if (header[4] == 1) {
+            _offset = read_le32(header + 0x20) + static_cast<uint64_t>(read_le16(header + 0x2E)) * read_le16(header + 0x30);
+        } else {
+            return fail("unsupported AppImage runtime in " + _image.string());
+        }
+    }
+
+    if (_offset >= file_size) {
+        return fail("no squashfs image in " + _image.string());
+    }
+
+    _image_size = file_size - _offset;
+
+    return true;
+}
+
+bool lcl_squashfs_extractor::read_superblock(std::ifstream& in) {
+    unsigned char superblock[SUPERBLOCK_SIZE];
+
+    if (!read_at(in, 0, superblock, sizeof(superblock)) || read_le32(superblock) != SQUASHFS_MAGIC) {
+        return fail("no squashfs image in " + _image.string());
+    }
+
+    uint16_t block_log = read_le16(superblock + 22);
+    uint16_t major = read_le16(superblock + 28);
+    uint64_t bytes_used = read_le64(superblock + 40);
+
+    _inode_count = read_le32(superblock + 4);
+    _block_size = read_le32(superblock + 12);
+    _fragment_count = read_le32(superblock + 16);
+    _compression = read_le16(superblock + 20);
+    _root_inode = read_le64(superblock + 32);
+    _inode_table = read_le64(superblock + 64);
+    _directory_table = read_le64(superblock + 72);
+    _fragment_table = read_le64(superblock + 80);
+
+    if (major != 4) {
+        return fail("unsupported squashfs version " + std::to_string(major));
+    }
+
+    if (block_log < 12 || block_log > 20 || _block_size != 1u << block_log) {
+        return fail("corrupt squashfs superblock");
+    }
+
+    if (bytes_used > _image_size || _inode_table >= bytes_used || _directory_table >= bytes_used || _fragment_count > bytes_used) {
+        return fail("truncated squashfs image");
+    }
+
+    if (_compression != COMPRESSION_GZIP && _compression != COMPRESSION_XZ && _compression != COMPRESSION_ZSTD) {
+        return fail("unsupported squashfs compression " + std::to_string(_compression));
+    }
+
+    _image_size = bytes_used;
+
+    return true;
+}
+
+bool lcl_squashfs_extractor::decompress(_codec& codec, const char* data, size_t size, char* output, size_t capacity, size_t& produced) {
+    produced = 0;
+
+    switch (_compression) {
+    case COMPRESSION_GZIP:
+        return libdeflate_zlib_decompress(codec.inflater, data, size, output, capacity, &produced) == LIBDEFLATE_SUCCESS;
+    case COMPRESSION_XZ: {
+        uint64_t memory_limit = UINT64_MAX;
+        size_t consumed = 0;
+
+        return lzma_stream_buffer_decode(&memory_limit, 0, nullptr, reinterpret_cast<const uint8_t*>(data), &consumed, size,
+            reinterpret_cast<uint8_t*>(output), &produced, capacity) == LZMA_OK;
+    }
+    case COMPRESSION_ZSTD: {
+        size_t result = ZSTD_decompressDCtx(codec.zstd, output, capacity, data, size);
+
+        if (ZSTD_isError(result)) {
+            return false;
+        }
+
+        produced = result;
+        return true;
+    }
+    }
+
+    return false;
+}
+
+// A data or fragment block, stored is its size word from the inode or the fragment table.
+bool lcl_squashfs_extractor::read_block(std::ifstream& in, _codec& codec, uint64_t position, uint32_t stored,
+    std::vector<char>& compressed, std::vector<char>& output, size_t& produced) {
+    uint32_t size = stored & ~BLOCK_UNCOMPRESSED;
+
+    if (size > _block_size) {
+        return false;
+    }
+
+    if (stored & BLOCK_UNCOMPRESSED) {
+        produced = size;
+        return read_at(in, position, output.data(), size);
+    }
+
+    return read_at(in, position, compressed.data(), size) && decompress(codec, compressed.data(), size, output.data(), _block_size, produced);
+}
+
+// Inodes, directories and the fragment table live in 8 KiB metadata blocks. Each block is
+// decompressed once, tables are walked by position (of the block) and offset (inside it).
+bool lcl_squashfs_extractor::metadata_block(std::ifstream& in, _codec& codec, uint64_t position, const _metadata_block*& block) {
+    auto it = _metadata.find(position);
+
+    if (it == _metadata.end()) {
+        unsigned char header[2];
+        char stored[METADATA_SIZE];
+        _metadata_block read;
+
+        if (!read_at(in, position, header, sizeof(header))) {
+            return fail("truncated squashfs metadata");
+        }
+
+        size_t size = read_le16(header) & ~METADATA_UNCOMPRESSED;
+        size_t produced = size;
+
+        read.data.resize(METADATA_SIZE);
+
+        if (size == 0 || size > METADATA_SIZE || !read_at(in, position + sizeof(header), stored, size)) {
+            return fail("corrupt squashfs metadata");
+        }
+
+        if (read_le16(header) & METADATA_UNCOMPRESSED) {
+            std::memcpy(read.data.data(), stored, size);
+        } else if (!decompress(codec, stored, size, read.data.data(), METADATA_SIZE, produced) || produced == 0) {
+            return fail("corrupt squashfs metadata");
+        }
+
+        read.data.resize(produced);
+        read.next = position + sizeof(header) + size;
+        it = _metadata.emplace(position, std::move(read)).first;
+    }
+
+    block = &it->second;
+
+    return true;
+}
+
+bool lcl_squashfs_extractor::read_metadata(std::ifstream& in, _codec& codec, uint64_t& position, size_t& offset, void* data, size_t size) {
+    auto output = static_cast<char*>(data);
+
+    while (size > 0) {
+        const _metadata_block* block;
+
+        if (!metadata_block(in, codec, position, block)) {
+            return false;
+        }
+
+        if (offset > block->data.size()) {
+            return fail("corrupt squashfs metadata");
+        }
+
+        if (offset == block->data.size()) {
+            position = block->next;
+            offset = 0;
+            continue;
+        }
+
+        size_t count = std::min(size, block->data.size() - offset);
+
+        std::memcpy(output, block->data.data() + offset, count);
+        output += count;
+        offset += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+// Walks the tree from the root inode. Directories, files, symlinks and hard links are collected,
+// devices, fifos and sockets have no place in an install and are skipped.
+bool lcl_squashfs_extractor::read_tree(std::ifstream& in, _codec& codec) {
+    struct pending {
+        uint64_t inode;
+        std::filesystem::path path;
+        size_t depth;
+    };
+
+    std::vector<pending> stack{ { _root_inode, _target, 0 } };
+    std::unordered_set<uint64_t> directories;
+
+    while (!stack.empty()) {
+        pending entry = std::move(stack.back());
+        uint64_t position = _inode_table + (entry.inode >> 16);
+        size_t offset = entry.inode & 0xFFFF;
+        unsigned char header[16];
+
+        stack.pop_back();
+
+        if (!read_metadata(in, codec, position, offset, header, sizeof(header))) {
+            return false;
+        }
+
+        uint16_t type = read_le16(header);
+        uint32_t mode = read_le16(header + 2) & 07777;
+        uint32_t number = read_le32(header + 12);
+
+        if (type == INODE_DIRECTORY || type == INODE_EXT_DIRECTORY) {
+            unsigned char fields[24];
+            uint64_t listing;
+            uint64_t block;
+            size_t block_offset;
+
+            if (type == INODE_DIRECTORY) {
+                if (!read_metadata(in, codec, position, offset, fields, 16)) {
+                    return false;
+                }
+
+                block = read_le32(fields);
+                listing = read_le16(fields + 8);
+                block_offset = read_le16(fields + 10);
+            } else {
+                if (!read_metadata(in, codec, position, offset, fields, 24)) {
+                    return false;
+                }
+
+                listing = read_le32(fields + 4);
+                block = read_le32(fields + 8);
+                block_offset = read_le16(fields + 18);
+            }
+
+            // A directory reached twice would be a loop, squashfs has no directory hard links.
+            if (!directories.insert(entry.inode).second || entry.depth >= MAX_DEPTH || listing < 3) {
+                return fail("corrupt squashfs directory tree");
+            }
+
+            _directories.emplace_back(entry.path, mode);
+
+            uint64_t list_position = _directory_table + block;
+            uint64_t remaining = listing - 3;
+
+            while (remaining > 0) {
+                unsigned char run[12];
+
+                if (remaining < sizeof(run) || !read_metadata(in, codec, list_position, block_offset, run, sizeof(run))) {
+                    return fail("corrupt squashfs directory " + entry.path.string());
+                }
+
+                uint32_t count = read_le32(run) + 1;
+                uint64_t start = read_le32(run + 4);
+
+                remaining -= sizeof(run);
+
+                if (count > MAX_DIRECTORY_RUN) {
+                    return fail("corrupt squashfs directory " + entry.path.string());
+                }
+
+                for (uint32_t i = 0; i < count; i++) {
+                    unsigned char item[8];
+
+                    if (remaining < sizeof(item) || !read_metadata(in, codec, list_position, block_offset, item, sizeof(item))) {
+                        return fail("corrupt squashfs directory " + entry.path.string());
+                    }
+
+                    size_t name_size = read_le16(item + 6) + 1;
+                    std::string name(name_size, '\0');
+
+                    remaining -= sizeof(item);
+
+                    if (remaining < name_size || !read_metadata(in, codec, list_position, block_offset, name.data(), name_size)) {
+                        return fail("corrupt squashfs directory " + entry.path.string());
+                    }
+
+                    remaining -= name_size;
+
+                    // Names are single path components, nothing may climb out of target.
+                    if (name == "." || name == ".." || name.find('/') != std::string::npos || name.find('\0') != std::string::npos) {
+                        return fail("unsafe entry name " + name);
+                    }
+
+                    stack.push_back({ (start << 16) | read_le16(item), entry.path / std::u8string(name.begin(), name.end()), entry.depth + 1 });
+                }
+            }
+        } else if (type == INODE_FILE || type == INODE_EXT_FILE) {
+            unsigned char fields[40];
+            _file file{ entry.path, 0, 0, {}, NO_FRAGMENT, 0, mode };
+
+            // Further names of a hard linked file only need linking once the data is written.
+            if (auto it = _file_inodes.find(number); it != _file_inodes.end()) {
+                _hard_links.emplace_back(entry.path, it->second);
+                continue;
+            }
+
+            if (type == INODE_FILE) {
+                if (!read_metadata(in, codec, position, offset, fields, 16)) {
+                    return false;
+                }
+
+                file.blocks_start = read_le32(fields);
+                file.fragment = read_le32(fields + 4);
+                file.fragment_offset = read_le32(fields + 8);
+                file.size = read_le32(fields + 12);
+            } else {
+                if (!read_metadata(in, codec, position, offset, fields, 40)) {
+                    return false;
+                }
+
+                file.blocks_start = read_le64(fields);
+                file.size = read_le64(fields + 8);
+                file.fragment = read_le32(fields + 28);
+                file.fragment_offset = read_le32(fields + 32);
+            }
+
+            uint64_t blocks = file.fragment == NO_FRAGMENT ? (file.size + _block_size - 1) / _block_size : file.size / _block_size;
+
+            // Sizes are read in slices, a corrupt block count runs out of metadata instead of memory.
+            while (file.block_sizes.size() < blocks) {
+                unsigned char sizes[1024 * 4];
+                size_t count = static_cast<size_t>(std::min<uint64_t>(blocks - file.block_sizes.size(), 1024));
+
+                if (!read_metadata(in, codec, position, offset, sizes, count * 4)) {
+                    return false;
+                }
+
+                for (size_t i = 0; i < count; i++) {
+                    file.block_sizes.push_back(read_le32(sizes + i * 4));
+                }
+            }
+
+            _file_inodes.emplace(number, _files.size());
+            _files.push_back(std::move(file));
+        } else if (type == INODE_SYMLINK || type == INODE_EXT_SYMLINK) {
+            unsigned char fields[8];
+
+            if (!read_metadata(in, codec, position, offset, fields, sizeof(fields))) {
+                return false;
+            }
+
+            std::string target(read_le32(fields + 4), '\0');
+
+            if (target.empty() || target.size() > MAX_SYMLINK_SIZE || !read_metadata(in, codec, position, offset, target.data(), target.size())) {
+                return fail("corrupt squashfs symlink " + entry.path.string());
+            }
+
+            _symlinks.emplace_back(entry.path, std::move(target));
+        }
+    }
+
+    return true;
+}
+
+// The fragment table is an index of metadata blocks, each holding 512 16 byte entries.
+bool lcl_squashfs_extractor::read_fragments(std::ifstream& in, _codec& codec) {
+    if (_fragment_count == 0) {
+        return true;
+    }
+
+    std::vector<unsigned char> index((_fragment_count + FRAGMENTS_PER_BLOCK - 1) / FRAGMENTS_PER_BLOCK * 8);
+
+    if (!read_at(in, _fragment_table, index.data(), index.size())) {
+        return fail("truncated squashfs fragment table");
+    }
+
+    _fragments.resize(_fragment_count);
+
+    for (size_t i = 0; i < _fragments.size(); i++) {
+        uint64_t position = read_le64(index.data() + i / FRAGMENTS_PER_BLOCK * 8);
+        size_t offset = i % FRAGMENTS_PER_BLOCK * FRAGMENT_ENTRY_SIZE;
+        unsigned char entry[FRAGMENT_ENTRY_SIZE];
+
+        if (!read_metadata(in, codec, position, offset, entry, sizeof(entry))) {
+            return false;
+        }
+
+        _fragments[i].start = read_le64(entry);
+        _fragments[i].size = read_le32(entry + 8);
+    }
+
+    return true;
+}
+
+// Creates the folders and every file at its final size, so the threads can write blocks of the
+// same file independently. Jobs are handed out largest first.
+bool lcl_squashfs_extractor::plan() {
+    std::error_code ec;
+
+    for (const auto& [path, mode] : _directories) {
+        if (!std::filesystem::is_directory(path, ec)) {
+            std::filesystem::remove(path, ec);
+        }
+
+        std::filesystem::create_directories(path, ec);
+
+        if (ec) {
+            return fail("could not create " + path.string() + ": " + ec.message());
+        }
+    }
+
+    for (size_t i = 0; i < _files.size(); i++) {
+        const _file& file = _files[i];
+        uint64_t position = file.blocks_start;
+
+        std::filesystem::remove_all(file.path, ec);
+
+        {
+            std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+
+            if (!out.is_open()) {
+                return fail("could not create " + file.path.string());
+            }
+        }
+
+        std::filesystem::resize_file(file.path, file.size, ec);
+
+        if (ec) {
+            return fail("could not create " + file.path.string() + ": " + ec.message());
+        }
+
+        for (size_t first = 0; first < file.block_sizes.size(); first += JOB_BLOCKS) {
+            size_t blocks = static_cast<size_t>(std::min<uint64_t>(JOB_BLOCKS, file.block_sizes.size() - first));
+            uint64_t offset = static_cast<uint64_t>(first) * _block_size;
+
+            _jobs.push_back({ i, first, blocks, position, std::min<uint64_t>(static_cast<uint64_t>(blocks) * _block_size, file.size - offset), NO_FRAGMENT });
+
+            for (size_t k = first; k < first + blocks; k++) {
+                position += file.block_sizes[k] & ~BLOCK_UNCOMPRESSED;
+            }
+        }
+
+        if (file.fragment != NO_FRAGMENT) {
+            if (file.fragment >= _fragments.size()) {
+                return fail("corrupt squashfs fragment for " + file.path.string());
+            }
+
+            _fragments[file.fragment].tails.push_back(i);
+        }
+    }
+
+    for (uint32_t i = 0; i < _fragments.size(); i++) {
+        uint64_t size = 0;
+
+        for (size_t index : _fragments[i].tails) {
+            size += _files[index].size - _files[index].block_sizes.size() * static_cast<uint64_t>(_block_size);
+        }
+
+        if (size > 0) {
+            _jobs.push_back({ 0, 0, 0, _fragments[i].start, size, i });
+        }
+    }
+
+    std::sort(_jobs.begin(), _jobs.end(), [](const _job& a, const _job& b) { return a.size > b.size; });
+
+    return true;
+}
+
+bool lcl_squashfs_extractor::extract_job(std::ifstream& in, _codec& codec, const _job& job, std::vector<char>& compressed, std::vector<char>& output) {
+    size_t produced;
+
+    // Every tail in a fragment block is cut from a single decompression.
+    if (job.fragment != NO_FRAGMENT) {
+        const _fragment& fragment = _fragments[job.fragment];
+
+        if (!read_block(in, codec, fragment.start, fragment.size, compressed, output, produced)) {
+            return fail("corrupt squashfs fragment " + std::to_string(job.fragment));
+        }
+
+        for (size_t index : fragment.tails) {
+            const _file& file = _files[index];
+            uint64_t offset = file.block_sizes.size() * static_cast<uint64_t>(_block_size);
+            uint64_t tail = file.size - offset;
+
+            if (file.fragment_offset > produced || tail > produced - file.fragment_offset) {
+                return fail("corrupt data in " + file.path.string());
+            }
+
+            std::fstream out(file.path, std::ios::binary | std::ios::in | std::ios::out);
+
+            out.seekp(static_cast<std::streamoff>(offset));
+
+            if (!out.write(output.data() + file.fragment_offset, static_cast<std::streamsize>(tail))) {
+                return fail("could not write " + file.path.string());
+            }
+        }
+
+        _bytes += job.size;
+        return true;
+    }
+
+    const _file& file = _files[job.file];
+    std::fstream out(file.path, std::ios::binary | std::ios::in | std::ios::out);
+    uint64_t position = job.position;
+
+    if (!out.is_open()) {
+        return fail("could not open " + file.path.string());
+    }
+
+    for (size_t k = job.first_block; k < job.first_block + job.blocks; k++) {
+        uint32_t stored = file.block_sizes[k];
+        uint64_t offset = static_cast<uint64_t>(k) * _block_size;
+        uint64_t expected = std::min<uint64_t>(_block_size, file.size - offset);
+
+        if (_failed) {
+            return false;
+        }
+
+        // Sparse blocks are stored as size 0, resize_file() already left zeros there.
+        if ((stored & ~BLOCK_UNCOMPRESSED) == 0) {
+            continue;
+        }
+
+        if (!read_block(in, codec, position, stored, compressed, output, produced) || produced != expected) {
+            return fail("corrupt data in " + file.path.string());
+        }
+
+        position += stored & ~BLOCK_UNCOMPRESSED;
+        out.seekp(static_cast<std::streamoff>(offset));
+
+        if (!out.write(output.data(), static_cast<std::streamsize>(expected))) {
+            return fail("could not write " + file.path.string());
+        }
+    }
+
+    out.close();
+
+    if (out.fail()) {
+        return fail("could not write " + file.path.string());
+    }
+
+    _bytes += job.size;
+
+    return true;
+}
+
+// Links and permissions come last: nothing is written through a symlink and a read-only
+// folder is only locked once its content is in place.
+bool lcl_squashfs_extractor::finish() {
+    std::error_code ec;
+
+    for (const auto& [path, index] : _hard_links) {
+        std::filesystem::remove_all(path, ec);
+        std::filesystem::create_hard_link(_files[index].path, path, ec);
+
+        if (ec) {
+            ec.clear();
+            std::filesystem::copy_file(_files[index].path, path, std::filesystem::copy_options::overwrite_existing, ec);
+        }
+
+        if (ec) {
+            return fail("could not link " + path.string() + ": " + ec.message());
+        }
+    }
+
+    // Targets are kept as they are, the AppImage resolves them the same way when it runs.
+    for (const auto& [path, target] : _symlinks) {
+        std::filesystem::remove_all(path, ec);
+        std::filesystem::create_symlink(std::filesystem::path(std::u8string(target.begin(), target.end())), path, ec);
+
+        if (ec) {
+            return fail("could not create symlink " + path.string() + ": " + ec.message());
+        }
+    }
+
+#ifndef _WIN32
+    for (const auto& file : _files) {
+        std::filesystem::permissions(file.path, static_cast<std::filesystem::perms>(file.mode & 0777), ec);
+    }
+
+    // Deepest first, the owner keeps full access so the next update can replace the tree.
+    for (auto it = _directories.rbegin(); it != _directories.rend(); ++it) {
+        if (it->first != _target) {
+            std::filesystem::permissions(it->first, static_cast<std::filesystem::perms>((it->second & 0777) | 0700), ec);
+        }
+    }
+#endif
+
+    return true;
+}
+
+bool lcl_squashfs_extractor::run() {
+    auto started = std::chrono::steady_clock::now();
+
+    {
+        std::ifstream in(_image, std::ios::binary);
+
+        if (!in.is_open()) {
+            return fail("could not open " + _image.string());
+        }
+
+        if (!find_image(in) || !read_superblock(in)) {
+            return false;
+        }
+
+        _codec codec(_compression);
+
+        if (!read_tree(in, codec) || !read_fragments(in, codec) || !plan()) {
+            return false;
+        }
+    }
+
+    _metadata.clear();
+
+    unsigned threads = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_THREADS);
+    threads = static_cast<unsigned>(std::clamp<size_t>(_jobs.size(), 1, threads));
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> pool;
+
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            std::ifstream in(_image, std::ios::binary);
+            _codec codec(_compression);
+            std::vector<char> compressed(_block_size);
+            std::vector<char> output(_block_size);
+
+            if (!in.is_open()) {
+                fail("could not open " + _image.string());
+            }
+
+            while (!_failed) {
+                size_t i = next++;
+
+                if (i >= _jobs.size() || !extract_job(in, codec, _jobs[i], compressed, output)) {
+                    break;
+                }
+            }
+        });
+    }
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (_failed || !finish()) {
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    uint64_t bytes = _bytes;
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Extracted %zu files (%llu bytes) from squashfs in %.2f s with %u threads (%.1f MB/s).\n",
+        _files.size() + _hard_links.size(), static_cast<unsigned long long>(bytes), seconds, threads,
+        seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+
+    return true;
+}
@@ -1,24 +1,53 @@
 ﻿#include "lcl_utils.hpp"
+#include "lcl_cache.hpp"
+#include "lcl_download.hpp"
+#include "lcl_7z.hpp"
+#include "lcl_extract.hpp"
+#include "lcl_mirror.hpp"
+#include "lcl_net.hpp"
+#include "lcl_provider.hpp"
+#include "lcl_release.hpp"
+#include "lcl_squashfs.hpp"
+#include "lcl_versions.hpp"
+#include "lcl_zsync.hpp"
 #include "libretro.h"
 
+#include <cctype>
 #include <cerrno>
 #include <cstddef>
 #include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <format>
 #include <fstream>
 #include <memory>
 #include <stdlib.h>
 #include <system_error>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <nlohmann/json.hpp>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif __linux__
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 using json = nlohmann::json;
 
 static uint32_t* frame_buf;
 static struct retro_log_callback logging;
-static retro_log_printf_t log_cb;
+retro_log_printf_t log_cb;
 
 #ifdef CORE
 #ifdef SYSTEM_NAME
@@ -29,6 +58,10 @@ std::string system_name = SYSTEM_NAME;
 
 static std::string g_emu_extensions;
 
+// Background update worker, joined (and cancelled if still running) on unload.
+static std::thread g_update_thread;
+static std::atomic<bool> g_cancel_update{false};
+
 // libcurl callback
 static inline size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
     size_t totalSize = size * nmemb;
@@ -36,11 +69,42 @@ static inline size_t WriteCallback(void* contents, size_t size, size_t nmemb, st
     return totalSize;
 }
 
+// Drop the calling thread to idle CPU and I/O priority so updates never compete with the emulator.
+static void lower_thread_priority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif __linux__
+    const int ioprio_class_idle = 3;
+    const int ioprio_class_shift = 13;
+    const int ioprio_who_process = 1;
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+    setpriority(PRIO_PROCESS, tid, 19);
+    syscall(SYS_ioprio_set, ioprio_who_process, tid, ioprio_class_idle << ioprio_class_shift);
+#endif
+}
+
+static long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 lcl_utils::lcl_utils() {
     _is_flatpak = false;
+    _background_updates = false;
+    _batch_query = false;
+    _stream_extract = true;
+    _stream_installed = false;
+    _partial_updates = true;
+    _zsync_updates = true;
     _base_path = std::filesystem::current_path();
     _config_path = (_base_path / "LCL.cfg").string();
     _url_asset_id = 0;
+    _checked_at = 0;
+    _check_ttl = 0;
+    _cache_max_bytes = 0;
+    _update_lock_wait = 300;
+    _keep_versions = 2;
 
     _directories = {
          (_base_path / "system" / core_name).string(),
@@ -53,7 +117,12 @@ lcl_utils::lcl_utils() {
     _downloaderDirs = {
         (_base_path / "system" / core_name / "0.Url.txt").string(),
         (_base_path / "system" / core_name / "1.CurrentVersion.txt").string(),
-        (_base_path / "system" / core_name / "2.NewVersion.txt").string()
+        (_base_path / "system" / core_name / "2.NewVersion.txt").string(),
+        (_base_path / "system" / core_name / "3.ReleaseCache.json").string(),
+        (_base_path / "system" / core_name / "4.NetStats.log").string(),
+        (_base_path / "system" / core_name / "5.Manifest.json").string(),
+        (_base_path / "system" / core_name / "staging").string(),
+        (_base_path / "system" / core_name / "staging" / "version.txt").string()
     };
 
 #ifdef __linux__
@@ -114,15 +183,22 @@ bool lcl_utils::lcl_setup_config_params() {
 
 #ifdef _WIN32
     _search_token = _cfg_section["WINDOWS_SEARCH_TOKEN"].as<std::string>();
+    _fast_path_asset = lcl_cfg_get<std::string>(_cfg_section, "WINDOWS_FAST_PATH_ASSET", "");
     _downloaderDirs.push_back((_base_path / "system" / core_name / _cfg_section["ARCHIVE"].as<std::string>()).string());
-    _executable = (_base_path / "system" / core_name / _cfg_section["WIN_EXECUTABLE"].as<std::string>()).string();
+    _executable_name = _cfg_section["WIN_EXECUTABLE"].as<std::string>();
+    _archive_extension = _cfg_section["ARCHIVE_EXT"].as<std::string>();
 #elif __linux__
     _search_token = _cfg_section["LINUX_SEARCH_TOKEN"].as<std::string>();
-    _executable = (_base_path / "system" / core_name / _cfg_section["LINUX_EXECUTABLE"].as<std::string>()).string();
-    _downloaderDirs.push_back((_executable));
+    _fast_path_asset = lcl_cfg_get<std::string>(_cfg_section, "LINUX_FAST_PATH_ASSET", "");
+    _executable_name = _cfg_section["LINUX_EXECUTABLE"].as<std::string>();
+    // Next to the versions under the executable's name, moved into the version being installed.
+    _downloaderDirs.push_back((_base_path / "system" / core_name / _executable_name).string());
+    // ARCHIVE_EXT describes the Windows asset, the Linux one is an AppImage unless told otherwise.
+    _archive_extension = lcl_cfg_get<std::string>(_cfg_section, "LINUX_ARCHIVE_EXT", "");
 #endif
 
-    _archive_extension = _cfg_section["ARCHIVE_EXT"].as<std::string>();
+    // The executable of the live version, lcl_set_install_path() follows installs from there.
+    lcl_set_install_path(lcl_live_path());
 
     _urls.push_back(_cfg_section["API_URL"].as<std::string>());
     _urls.push_back(_cfg_section["GIT_URL"].as<std::string>());
@@ -132,6 +208,55 @@ bool lcl_utils::lcl_setup_config_params() {
         return false;
     }
 
+    // Seconds during which the last release check is trusted without touching the network.
+    _check_ttl = lcl_cfg_get<long>(_cfg_section, "UPDATE_CHECK_TTL", 0);
+    _background_updates = lcl_cfg_get<std::string>(_cfg_section, "UPDATE_MODE", "blocking") == "background";
+
+    // Where release metadata comes from: github, gitea, index or file.
+    _provider = lcl_cfg_get<std::string>(_cfg_section, "PROVIDER", "github");
+    _pin_version = lcl_cfg_get<std::string>(_cfg_section, "PIN_VERSION", "");
+
+    // Settings shared by every core live in the [lcl] section.
+    if (_cfg.contains("lcl")) {
+        auto& global_section = _cfg["lcl"];
+
+        _batch_query = lcl_cfg_get<bool>(global_section, "BATCH_RELEASE_QUERY", false);
+        _graphql_url = lcl_cfg_get<std::string>(global_section, "GRAPHQL_URL", "https://api.github.com/graphql");
+    }
+
+    // Resolved addresses and TLS sessions survive between core loads.
+    long long dns_ttl = 3600;
+    bool verbose = false;
+
+    if (_cfg.contains("lcl")) {
+        dns_ttl = lcl_cfg_get<long>(_cfg["lcl"], "DNS_CACHE_TTL", 3600);
+        verbose = lcl_cfg_get<bool>(_cfg["lcl"], "CURL_VERBOSE", false);
+        _download_options.segments = lcl_cfg_get<int>(_cfg["lcl"], "DOWNLOAD_SEGMENTS", 1);
+        _download_options.retries = lcl_cfg_get<int>(_cfg["lcl"], "DOWNLOAD_RETRIES", 5);
+        _download_options.low_speed_limit = lcl_cfg_get<long>(_cfg["lcl"], "LOW_SPEED_LIMIT", 1024);
+        _download_options.low_speed_time = lcl_cfg_get<long>(_cfg["lcl"], "LOW_SPEED_TIME", 30);
+        _stream_extract = lcl_cfg_get<bool>(_cfg["lcl"], "STREAM_EXTRACT", true);
+        _partial_updates = lcl_cfg_get<bool>(_cfg["lcl"], "PARTIAL_UPDATES", true);
+        _zsync_updates = lcl_cfg_get<bool>(_cfg["lcl"], "ZSYNC_UPDATES", true);
+        _cache_max_bytes = lcl_cfg_get<unsigned long long>(_cfg["lcl"], "CACHE_MAX_MB", 0) * 1024 * 1024;
+        _update_lock_wait = lcl_cfg_get<long long>(_cfg["lcl"], "UPDATE_LOCK_WAIT", 300);
+        // The previous version always stays, a launch started before the update may still run it.
+        _keep_versions = std::max(2L, lcl_cfg_get<long>(_cfg["lcl"], "KEEP_VERSIONS", 2));
+    }
+
+    lcl_net::instance().load(_base_path / "system", _downloaderDirs[_downloader_ids::NET_STATS_FILE], dns_ttl, verbose);
+
+    // Optional API token, LCL.cfg first and the environment otherwise. GraphQL requires one.
+    if (_cfg.contains("lcl")) {
+        _api_token = lcl_cfg_get<std::string>(_cfg["lcl"], "GITHUB_TOKEN", "");
+    }
+
+    if (_api_token.empty()) {
+        if (const char* token = std::getenv("GITHUB_TOKEN")) {
+            _api_token = token;
+        }
+    }
+
     _emu_extensions = _cfg_section["EXTENSIONS"].as<std::string>();
     g_emu_extensions = _emu_extensions; // export extensions for retro_system_info struct.
 
@@ -140,10 +265,39 @@ bool lcl_utils::lcl_setup_config_params() {
     log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] GIT URL: %s\n", _urls[BASE_URL].c_str());
     log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Loaded archive search token from LCL.cfg\n");
     log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Search Token: %s\n", _search_token.c_str());
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Update check TTL: %lld seconds\n", _check_ttl);
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Update mode: %s\n", _background_updates ? "background" : "blocking");
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Release provider: %s\n", _provider.c_str());
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Emulator path: %s\n", _install_path.c_str());
 
     return true;
 }
 
+// Emulators installed before versioned directories run from system/<core> itself until their first update.
+std::string lcl_utils::lcl_live_path()
+{
+    lcl_version_store versions(_directories[_directory_ids::EMULATOR_PATH]);
+    std::string live = versions.live();
+
+    return live.empty() ? _directories[_directory_ids::EMULATOR_PATH] : versions.path(live).string();
+}
+
+// The asset of this platform is the executable itself, installed without extraction.
+bool lcl_utils::lcl_asset_is_appimage()
+{
+#ifdef __linux__
+    return _archive_extension != ".zip" && _archive_extension != ".7z";
+#else
+    return false;
+#endif
+}
+
+void lcl_utils::lcl_set_install_path(const std::string& path)
+{
+    _install_path = path;
+    _executable = (std::filesystem::path(path) / _executable_name).string();
+}
+
 bool lcl_utils::lcl_setup_dirs()
 {
     for (const auto& path : _directories) {
@@ -168,253 +322,1083 @@ bool lcl_utils::lcl_setup_dirs()
     return true;
 }
 
-bool lcl_utils::lcl_build_download_url(CURL* curl, CURLcode& res)
-{
-    std::string jsonResponse;
+bool lcl_utils::lcl_load_release_cache()
+{
+    lcl_release_cache cache;
+
+    if (!cache.load(_downloaderDirs[_downloader_ids::RELEASE_CACHE_FILE])) {
+        return false;
+    }
+
+    // A different search token means the cached asset belongs to another build.
+    if (cache.search_token != _search_token || cache.asset.download_url.empty()) {
+        return false;
+    }
+
+    lcl_set_release(cache);
+
+    return true;
+}
+
+void lcl_utils::lcl_set_release(const lcl_release_cache& cache)
+{
+    _tag = cache.tag;
+    _url_asset_id = static_cast<int>(cache.asset.id);
+    _asset_name = cache.asset.name;
+    _asset_digest = cache.asset.digest;
+    _zsync_url = cache.asset.zsync_url;
+    _etag = cache.etag;
+    _last_modified = cache.last_modified;
+    _checked_at = cache.checked_at;
+
+    _urls.resize(_url_ids::DOWNLOAD_URL);
+    _urls.push_back(cache.asset.download_url);
+}
+
+bool lcl_utils::lcl_save_release_cache()
+{
+    lcl_release_cache cache;
+
+    cache.search_token = _search_token;
+    cache.tag = _tag;
+    cache.asset.id = _url_asset_id;
+    cache.asset.name = _asset_name;
+    cache.asset.digest = _asset_digest;
+    cache.asset.zsync_url = _zsync_url;
+    cache.asset.download_url = _urls[_url_ids::DOWNLOAD_URL];
+    cache.etag = _etag;
+    cache.last_modified = _last_modified;
+    cache.checked_at = _checked_at;
+
+    if (!cache.save(_downloaderDirs[_downloader_ids::RELEASE_CACHE_FILE])) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write release cache: %s\n",
+            _downloaderDirs[_downloader_ids::RELEASE_CACHE_FILE].c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Refresh the release cache of every core in LCL.cfg with a single GraphQL request.
+// Returns true when this core received a fresh entry.
+bool lcl_utils::lcl_batch_fetch_releases(CURL* curl)
+{
+    std::vector<lcl_release_target> targets;
+    std::string response;
+    std::string error;
+    std::vector<std::pair<std::string, lcl_release_cache>> releases;
+    lcl_http_headers responseHeaders;
+    long responseCode = 0;
+    bool own_release = false;
+
+    for (auto& [section_name, section] : _cfg) {
+        lcl_release_target target;
+        std::string api_url = lcl_cfg_get<std::string>(section, "API_URL", "");
+
+        // Gitea and Forgejo urls carry the same /repos/<owner>/<repo>/releases path, GitHub's answer
+        // for that name is not their release.
+        if (lcl_cfg_get<std::string>(section, "PROVIDER", "github") != "github" ||
+            api_url.rfind("https://api.github.com/", 0) != 0) {
+            continue;
+        }
+
+        if (!lcl_parse_repo_url(api_url, target.owner, target.repo)) {
+            continue;
+        }
+
+        target.section = section_name;
+#ifdef _WIN32
+        target.search_token = lcl_cfg_get<std::string>(section, "WINDOWS_SEARCH_TOKEN", "");
+#elif __linux__
+        target.search_token = lcl_cfg_get<std::string>(section, "LINUX_SEARCH_TOKEN", "");
+#endif
+        targets.push_back(target);
+    }
+
+    if (targets.empty()) {
+        return false;
+    }
+
+    long long wait_seconds = 0;
+
+    if (!lcl_net::instance().rate_limit_allows("graphql", wait_seconds)) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] GraphQL rate limit exhausted, skipping batched query for %lld seconds.\n", wait_seconds);
+        return false;
+    }
+
+    std::string body = lcl_build_graphql_query(targets);
+    std::string authorization = std::format("Authorization: bearer {}", _api_token);
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+    headers = curl_slist_append(headers, authorization.c_str());
+
+    curl_easy_setopt(curl, CURLOPT_URL, _graphql_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lcl_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &responseHeaders);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+    CURLcode res = lcl_net::instance().perform(curl, "graphql");
+
+    curl_slist_free_all(headers);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    lcl_net::instance().rate_limit_update("graphql", responseCode, responseHeaders);
+
+    // Back to a plain GET for whatever request reuses this handle.
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, nullptr);
+
+    if (res != CURLE_OK || responseCode != 200) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Batched release query failed (%s, HTTP %ld).\n",
+            curl_easy_strerror(res), responseCode);
+        return false;
+    }
+
+    if (!lcl_parse_graphql_releases(response, targets, releases, error)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Batched release query returned no data: %s\n", error.c_str());
+        return false;
+    }
+
+    if (!error.empty()) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Batched release query reported: %s\n", error.c_str());
+    }
+
+    for (auto& [section_name, cache] : releases) {
+        auto core_dir = _base_path / "system" / section_name;
+        auto cache_path = (core_dir / "3.ReleaseCache.json").string();
+        lcl_release_cache previous;
+
+        // Only cores that have been set up on this machine get an entry.
+        if (!std::filesystem::exists(core_dir)) {
+            continue;
+        }
+
+        // Keep the REST validators while they still describe the same release.
+        if (previous.load(cache_path) && previous.tag == cache.tag && previous.asset.id == cache.asset.id) {
+            cache.etag = previous.etag;
+            cache.last_modified = previous.last_modified;
+        }
+
+        cache.checked_at = unix_now();
+
+        if (!cache.save(cache_path)) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write release cache: %s\n", cache_path.c_str());
+            continue;
+        }
+
+        own_release = own_release || section_name == core_name;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Batched release query refreshed %zu of %zu cores.\n",
+        releases.size(), targets.size());
+
+    return own_release;
+}
+
+// github.com/<owner>/<repo>/releases/latest/download/<name> redirects to the asset of the latest
+// release, the redirect target carries the tag so it changes exactly when a new release is out.
+// True when it still points at the cached download url, anything else goes through the API.
+bool lcl_utils::lcl_fast_path_unchanged(CURL* curl)
+{
+    std::string git_url = _urls[_url_ids::BASE_URL];
+    size_t releases = git_url.find("/releases");
+    char* location = nullptr;
+    long responseCode = 0;
+
+    if (_fast_path_asset.empty() || _provider != "github" || _asset_name != _fast_path_asset || releases == std::string::npos) {
+        return false;
+    }
+
+    std::string fast_path_url = std::format("{}/latest/download/{}", git_url.substr(0, releases + 9), _fast_path_asset);
+
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    curl_easy_setopt(curl, CURLOPT_URL, fast_path_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0L);
+
+    CURLcode res = lcl_net::instance().perform(curl, "fast-path");
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_URL, &location);
+
+    std::string target = location ? location : "";
+
+    curl_slist_free_all(headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+
+    if (res != CURLE_OK || responseCode < 300 || responseCode >= 400 || target.empty()) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Fast path lookup gave no redirect (%s, HTTP %ld), asking the API.\n",
+            curl_easy_strerror(res), responseCode);
+        return false;
+    }
+
+    if (target != _urls[_url_ids::DOWNLOAD_URL]) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Latest release moved to %s, asking the API.\n", target.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool lcl_utils::lcl_export_download_url()
+{
+    _current_version = std::to_string(_url_asset_id);
+    _new_version = std::to_string(_url_asset_id);
+
+    // export final download URL
+    std::ofstream urlOut(_downloaderDirs[_downloader_ids::URL_FILE]);
+
+    if (urlOut.is_open()) {
+        urlOut << _urls[_url_ids::DOWNLOAD_URL] << "\n";
+        urlOut.close();
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Download URL saved: %s\n", _urls[_url_ids::DOWNLOAD_URL].c_str());
+    }
+    else {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write to URL file: %s\n", _downloaderDirs[_downloader_ids::URL_FILE].c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool lcl_utils::lcl_build_download_url(CURL* curl, CURLcode& res)
+{
+    bool has_cache = lcl_load_release_cache();
+
+    // Skip the network entirely while the last check is still fresh.
+    if (has_cache && _check_ttl > 0 && unix_now() - _checked_at < _check_ttl) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Release checked %lld seconds ago, using cached metadata (tag: %s).\n",
+            unix_now() - _checked_at, _tag.c_str());
+        return lcl_export_download_url();
+    }
+
+    if (!curl) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to initialize cURL.\n");
+        return false;
+    }
+
+    auto provider = lcl_make_release_provider(_provider);
+
+    if (!provider) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Unknown release provider: %s\n", _provider.c_str());
+        return false;
+    }
+
+    // Let a pre-warm started in retro_init hand over its connection first.
+    lcl_net::instance().wait_prewarm();
+
+    // Stable asset names can be checked with one redirect lookup outside the API rate limit.
+    if (has_cache && lcl_fast_path_unchanged(curl)) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Latest release redirect unchanged (tag: %s).\n", _tag.c_str());
+        _checked_at = unix_now();
+        lcl_save_release_cache();
+        return lcl_export_download_url();
+    }
+
+    // One GraphQL request refreshes every core, this one is then served from its new cache entry.
+    if (_provider == "github" && _batch_query && !_api_token.empty() && lcl_batch_fetch_releases(curl) && lcl_load_release_cache()) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Release metadata from batched query (tag: %s).\n", _tag.c_str());
+        return lcl_export_download_url();
+    }
+
+    lcl_release_request request{ _urls[_url_ids::LATEST_RELEASE_URL], _search_token, _api_token };
+    lcl_release_cache cache;
+    std::string error;
+
+    if (has_cache) {
+        cache.tag = _tag;
+        cache.asset.id = _url_asset_id;
+        cache.asset.name = _asset_name;
+        cache.asset.digest = _asset_digest;
+        cache.asset.zsync_url = _zsync_url;
+        cache.asset.download_url = _urls[_url_ids::DOWNLOAD_URL];
+        cache.etag = _etag;
+        cache.last_modified = _last_modified;
+    }
+
+    auto result = provider->fetch(curl, res, request, cache, error);
+
+    if (result == lcl_fetch_result::NOT_MODIFIED) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Release metadata not modified (%s, tag: %s).\n", provider->name(), _tag.c_str());
+        _checked_at = unix_now();
+        lcl_save_release_cache();
+        return lcl_export_download_url();
+    }
+
+    if (result == lcl_fetch_result::FAILED) {
+        // Keep launching with the last known release instead of failing the update check.
+        if (has_cache) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Failed to fetch metadata from %s (%s), using cached release %s.\n",
+                provider->name(), error.c_str(), _tag.c_str());
+            return lcl_export_download_url();
+        }
+
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to fetch metadata from %s: %s\n", provider->name(), error.c_str());
+        return false;
+    }
+
+    lcl_set_release(cache);
+    _checked_at = unix_now();
+    lcl_save_release_cache();
+
+    return lcl_export_download_url();
+}
+
+bool lcl_utils::lcl_download_asset(CURL *curl, CURLcode& res, std::string &url)
+{
+    return lcl_download_asset(curl, res, url, _downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+}
+
+bool lcl_utils::lcl_download_asset(CURL *curl, CURLcode& res, std::string &url, const std::string& target)
+{
+    if (!curl) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to initialize cURL for download.\n");
+        return false;
+    }
+
+    lcl_downloader download(url, target, _download_options, g_cancel_update);
+
+    // Hosts without published digests, and GitHub assets it has none for, leave it to the size checks.
+    download.expect_sha256(_asset_digest);
+    bool downloaded = download.run(curl, res);
+
+    curl_easy_cleanup(curl);
+
+    if (!downloaded) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to download file: %s\n", curl_easy_strerror(res));
+        return false;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Download complete: %s\n", target.c_str());
+    lcl_cache_store(target);
+
+    return true;
+}
+
+bool lcl_utils::lcl_cache_fetch(const std::string& target)
+{
+    lcl_archive_cache cache(_base_path / "system" / "LCL.cache", _cache_max_bytes);
+
+    return cache.fetch(_asset_digest, _urls[_url_ids::DOWNLOAD_URL], target);
+}
+
+void lcl_utils::lcl_cache_store(const std::string& file)
+{
+    lcl_archive_cache cache(_base_path / "system" / "LCL.cache", _cache_max_bytes);
+
+    cache.store(file, _asset_digest, _urls[_url_ids::DOWNLOAD_URL]);
+}
+
+// Archive cache first, then fetching only what changed (zsync for AppImages, entries of zip
+// updates) or extraction while downloading (first installs), then the regular download. Consumes curl.
+bool lcl_utils::lcl_install_asset(CURL* curl, CURLcode& res)
+{
+    // Still kept from before, lcl_commit_version() only has to switch back to it.
+    if (_install_work.empty()) {
+        curl_easy_cleanup(curl);
+        return true;
+    }
+
+    if (lcl_cache_fetch(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE])) {
+        curl_easy_cleanup(curl);
+        return true;
+    }
+
+    return lcl_zsync_download(curl, res, _downloaderDirs[_downloader_ids::DOWNLOADED_FILE]) ||
+        lcl_partial_install(curl, res) || lcl_stream_install(curl, res) ||
+        lcl_download_asset(curl, res, _urls[_url_ids::DOWNLOAD_URL]);
+}
+
+// Single file assets published with a .zsync file (AppImages) are rebuilt from the installed
+// copy, which is the executable itself. The result then only moves into place, lcl_extract_asset()
+// asks the same lcl_asset_is_appimage(). Same curl contract as lcl_stream_install().
+bool lcl_utils::lcl_zsync_download(CURL* curl, CURLcode& res, const std::string& target)
+{
+    std::error_code ec;
+
+    // The executable inside an archive is no seed for the archive.
+    if (!_zsync_updates || !curl || _zsync_url.empty() || !lcl_asset_is_appimage() ||
+        !std::filesystem::is_regular_file(_executable, ec)) {
+        return false;
+    }
+
+    lcl_zsync_client client(_zsync_url, _urls[_url_ids::DOWNLOAD_URL], _executable, target, _download_options, g_cancel_update);
+
+    client.expect_sha256(_asset_digest);
+
+    if (!client.run(curl, res)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] zsync update failed (%s), downloading the whole file instead.\n", client.error().c_str());
+        return false;
+    }
+
+    curl_easy_cleanup(curl);
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Download complete: %s\n", target.c_str());
+    lcl_cache_store(target);
+
+    return true;
+}
+
+// Zip updates over an existing install range-fetch the central directory and the entries that
+// changed, the rest of the archive is never downloaded. Same curl contract as lcl_stream_install().
+bool lcl_utils::lcl_partial_install(CURL* curl, CURLcode& res)
+{
+    std::error_code ec;
+
+    // An AppImage has no central directory to range-fetch, nor does a 7z.
+    if (!_partial_updates || !curl || lcl_asset_is_appimage() || _archive_extension != ".zip" ||
+        !std::filesystem::exists(_executable, ec)) {
+        return false;
+    }
+
+    auto sparse_path = std::filesystem::path(_directories[_directory_ids::EMULATOR_PATH]) / ".lcl_partial";
+    lcl_partial_installer installer(_urls[_url_ids::DOWNLOAD_URL], sparse_path, _install_path, _download_options, g_cancel_update);
+    lcl_install_manifest installed{};
+
+    // Dropped up front like lcl_extract_archive() does, the fallback then reads every file back.
+    installed.load(_downloaderDirs[_downloader_ids::MANIFEST_FILE]);
+    std::filesystem::remove(_downloaderDirs[_downloader_ids::MANIFEST_FILE], ec);
+
+    if (!installer.run(curl, res, std::move(installed))) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Partial update failed, downloading the archive instead.\n");
+        return false;
+    }
+
+    if (!installer.manifest().save(_downloaderDirs[_downloader_ids::MANIFEST_FILE])) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write the install manifest, the next update reads every file back.\n");
+    }
+
+#ifndef _WIN32
+    std::filesystem::permissions(_executable, std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+        std::filesystem::perms::others_exec, std::filesystem::perm_options::add, ec);
+#endif
+
+    curl_easy_cleanup(curl);
+    _stream_installed = true;
+
+    return true;
+}
+
+// Zip archives are unpacked while they download, the archive itself is never written to disk.
+// On success curl is cleaned up like lcl_download_asset() does, on failure it is left for the fallback.
+bool lcl_utils::lcl_stream_install(CURL* curl, CURLcode& res)
+{
+    std::error_code ec;
+
+    // Updates go through the delta install instead, which needs the whole archive first.
+    if (!_stream_extract || !curl || lcl_asset_is_appimage() || _archive_extension != ".zip" ||
+        std::filesystem::exists(_executable, ec)) {
+        return false;
+    }
+
+    auto extract_path = std::filesystem::path(_directories[_directory_ids::EMULATOR_PATH]) / ".lcl_extract";
+    lcl_stream_installer installer(_urls[_url_ids::DOWNLOAD_URL], extract_path, _download_options, g_cancel_update);
+    std::string error;
+
+    installer.expect_sha256(_asset_digest);
+
+    // The cache wants the archive too, it is written alongside without being read back.
+    if (_cache_max_bytes > 0) {
+        installer.keep_copy(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+    }
+
+    if (!installer.run(curl, res)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Streaming install failed, downloading the archive instead.\n");
+        return false;
+    }
+
+    if (!lcl_move_extracted(extract_path, _install_path, error)) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not move extracted files into place: %s\n", error.c_str());
+        return false;
+    }
+
+    std::filesystem::remove(_downloaderDirs[_downloader_ids::MANIFEST_FILE], ec);
+
+    if (_cache_max_bytes > 0 && std::filesystem::exists(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE], ec)) {
+        lcl_cache_store(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+        std::filesystem::remove(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE], ec);
+    }
+
+#ifndef _WIN32
+    std::filesystem::permissions(_executable, std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+        std::filesystem::perms::others_exec, std::filesystem::perm_options::add, ec);
+#endif
+
+    curl_easy_cleanup(curl);
+    _stream_installed = true;
+
+    return true;
+}
+
+bool lcl_utils::lcl_core_get()
+{
+    CURL* curl = lcl_net::instance().easy();
+    CURLcode res;
+
+    if (!lcl_build_download_url(curl, res)) {
+		log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to set URL.\n");
+        return false;
+    }
+
+    if (!std::filesystem::exists(_executable)) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] First boot detected, downloading emulator...\n");
+
+        if (!lcl_begin_version(_current_version)) {
+            curl_easy_cleanup(curl);
+            return false;
+        }
+
+        // Version files are written once the version is live, by lcl_commit_version().
+        if (!lcl_install_asset(curl, res)) {
+			log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to download emulator.\n");
+            lcl_abort_version();
+            return false;
+        }
+
+        return true;
+    }
+
+    // If it's not the first boot, check for updates.
+
+    std::ifstream currentIn(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
+    std::ofstream newOut(_downloaderDirs[_downloader_ids::NEW_VERSION_FILE]);
+
+    if (!currentIn.is_open() || !newOut.is_open()) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not read version files.\n");
+        return false;
+    }
+
+    std::getline(currentIn, _current_version);
+
+    if (newOut.is_open()) {
+        newOut << _new_version << "\n";
+		newOut.close();
+    }
+    else {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not write new version file.\n");
+        return false;
+    }
+
+    if (_current_version != _new_version) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] New version detected (current: %s, new: %s). Downloading update...\n",
+            _current_version.c_str(), _new_version.c_str());
+
+        if (!lcl_begin_version(_new_version)) {
+            curl_easy_cleanup(curl);
+            return false;
+        }
+
+        if (!lcl_install_asset(curl, res)) {
+			log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to download update.\n");
+            lcl_abort_version();
+            return false;
+        }
+    }
+    else {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Core is already up to date (version: %s).\n", _current_version.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool lcl_utils::lcl_background_updates()
+{
+    return _background_updates;
+}
+
+bool lcl_utils::lcl_core_installed()
+{
+    return std::filesystem::exists(_executable);
+}
+
+// One process per core downloads and installs at a time. Others wait for it (at most
+// UPDATE_LOCK_WAIT seconds) and then find the core up to date, or launch what is installed.
+// Whoever held the lock may have switched versions meanwhile, the live one is looked up again.
+bool lcl_utils::lcl_lock_update(bool wait)
+{
+    auto lock_path = std::filesystem::path(_directories[_directory_ids::EMULATOR_PATH]) / ".update.lock";
+    bool locked = _update_lock.acquire(lock_path, std::chrono::milliseconds(0));
+
+    if (!locked && (!wait || _update_lock_wait <= 0)) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Another instance is updating %s.\n", core_name.c_str());
+    } else if (!locked) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Another instance is updating %s, waiting up to %lld seconds.\n",
+            core_name.c_str(), _update_lock_wait);
+
+        locked = _update_lock.acquire(lock_path, std::chrono::seconds(_update_lock_wait));
+
+        if (!locked) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Update of %s still running elsewhere, launching the installed version.\n",
+                core_name.c_str());
+        }
+    }
+
+    lcl_set_install_path(lcl_live_path());
+
+    return locked;
+}
+
+void lcl_utils::lcl_unlock_update()
+{
+    _update_lock.release();
+}
+
+// Background half of the launch-first mode: fetch the latest release into the staging
+// directory while the installed emulator runs. The transfer only holds the staging lock, one
+// download per core, so launches meanwhile never wait for it. The update lock is taken for
+// publishing alone: the file is renamed to its staged name and the staged version file is
+// written last, a cancelled or failed download is never picked up by lcl_apply_staged_update().
+bool lcl_utils::lcl_core_stage_update()
+{
+    lower_thread_priority();
+
+    lcl_file_lock stage_lock;
+    auto emulator_path = std::filesystem::path(_directories[_directory_ids::EMULATOR_PATH]);
+
+    if (!stage_lock.acquire(emulator_path / ".stage.lock", std::chrono::milliseconds(0))) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Another instance is staging an update of %s.\n", core_name.c_str());
+        return false;
+    }
+
+    CURL* curl = lcl_net::instance().easy();
+    CURLcode res;
+    std::string staged_version;
+    auto staged_file = (std::filesystem::path(_downloaderDirs[_downloader_ids::STAGING_PATH]) /
+        std::filesystem::path(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]).filename()).string();
+    auto incoming_file = staged_file + ".download";
+
+    if (!lcl_build_download_url(curl, res)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Background update check failed.\n");
+        curl_easy_cleanup(curl);
+        return false;
+    }
+
+    std::ifstream currentIn(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
+    std::ifstream stagedIn(_downloaderDirs[_downloader_ids::STAGED_VERSION_FILE]);
+
+    std::getline(currentIn, _current_version);
+    std::getline(stagedIn, staged_version);
+    stagedIn.close();
+
+    if (_current_version == _new_version || (staged_version == _new_version && std::filesystem::exists(staged_file))) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] No update to stage (version: %s).\n", _new_version.c_str());
+        curl_easy_cleanup(curl);
+        return false;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Staging update in background (current: %s, new: %s).\n",
+        _current_version.c_str(), _new_version.c_str());
+
+    // Partial downloads stay in the staging directory, the next launch resumes them.
+    std::error_code ec;
+    std::filesystem::create_directories(_downloaderDirs[_downloader_ids::STAGING_PATH], ec);
+
+    if (lcl_cache_fetch(incoming_file)) {
+        curl_easy_cleanup(curl);
+    } else if (!lcl_zsync_download(curl, res, incoming_file) &&
+        !lcl_download_asset(curl, res, _urls[_url_ids::DOWNLOAD_URL], incoming_file)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Background download did not complete, it will resume on the next launch.\n");
+        return false;
+    }
+
+    // Waits out an install of another instance, unless the game is closed first.
+    while (!_update_lock.acquire(emulator_path / ".update.lock", std::chrono::seconds(1))) {
+        if (g_cancel_update.load()) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Update %s downloaded but not staged, another instance is updating.\n",
+                _new_version.c_str());
+            return false;
+        }
+    }
+
+    std::filesystem::remove(_downloaderDirs[_downloader_ids::STAGED_VERSION_FILE], ec);
+    std::filesystem::remove(staged_file, ec);
+    std::filesystem::rename(incoming_file, staged_file, ec);
+
+    std::ofstream stagedOut;
+
+    if (!ec) {
+        stagedOut.open(_downloaderDirs[_downloader_ids::STAGED_VERSION_FILE]);
+        stagedOut << _new_version << "\n";
+        stagedOut.close();
+    }
+
+    lcl_unlock_update();
+
+    if (ec || !stagedOut) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not stage update %s.\n", _new_version.c_str());
+        return false;
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Update %s staged, it will be installed on next launch.\n", _new_version.c_str());
+
+    lcl_net::instance().save();
+
+    return true;
+}
+
+// Swap a previously staged update in before booting.
+bool lcl_utils::lcl_apply_staged_update()
+{
+    std::string staged_version;
+    std::error_code ec;
+    auto staged_file = (std::filesystem::path(_downloaderDirs[_downloader_ids::STAGING_PATH]) /
+        std::filesystem::path(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]).filename()).string();
+
+    std::ifstream stagedIn(_downloaderDirs[_downloader_ids::STAGED_VERSION_FILE]);
+
+    if (!stagedIn.is_open() || !std::getline(stagedIn, staged_version) || !std::filesystem::exists(staged_file)) {
+        return false;
+    }
+
+    stagedIn.close();
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Installing staged update %s.\n", staged_version.c_str());
+
+    if (!lcl_begin_version(staged_version)) {
+        return false;
+    }
+
+    // A version still kept from before needs no download.
+    if (!_install_work.empty()) {
+        std::filesystem::rename(staged_file, _downloaderDirs[_downloader_ids::DOWNLOADED_FILE], ec);
+
+        if (ec) {
+            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to move staged update: %s\n", ec.message().c_str());
+            lcl_abort_version();
+            return false;
+        }
+    }
+
+    // Only what was staged goes, a download another instance is staging stays.
+    std::filesystem::remove(staged_file, ec);
+    std::filesystem::remove(_downloaderDirs[_downloader_ids::STAGED_VERSION_FILE], ec);
+
+    return lcl_core_extractor();
+}
+
+// Every install goes to system/<core>/versions/<id>/, through a working copy of the live version
+// that lcl_commit_version() switches live in one rename. The install paths follow it meanwhile,
+// launches and the live version never see a half written tree. Called with the update lock held.
+bool lcl_utils::lcl_begin_version(const std::string& id)
+{
+    lcl_version_store versions(_directories[_directory_ids::EMULATOR_PATH]);
+    std::filesystem::path work;
+    std::string error;
+
+    // An emulator installed straight into system/<core> becomes the first kept version.
+    if (versions.live().empty() && std::filesystem::exists(_executable)) {
+        std::string legacy_id;
+        std::vector<std::string> skip = { ".update.lock", ".stage.lock", ".lcl_partial", ".lcl_extract" };
+        std::ifstream currentIn(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
+
+        std::getline(currentIn, legacy_id);
+
+        auto downloaded = std::filesystem::path(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]).filename().string();
 
-    if (!curl) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to initialize cURL.\n");
-        return false;
-    }
+        // The launcher's own files and unfinished downloads stay.
+        for (size_t i = _downloader_ids::URL_FILE; i < _downloader_ids::DOWNLOADED_FILE; i++) {
+            if (i != _downloader_ids::STAGED_VERSION_FILE) {
+                skip.push_back(std::filesystem::path(_downloaderDirs[i]).filename().string());
+            }
+        }
 
-    curl_easy_setopt(curl, CURLOPT_URL, _urls[_url_ids::LATEST_RELEASE_URL].c_str());
+        skip.insert(skip.end(), { downloaded + ".part", downloaded + ".part.json", downloaded + ".extract" });
 
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Accept: application/json");
-    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+#ifdef _WIN32
+        // On Linux it is named like the executable, which is the emulator itself here.
+        skip.push_back(downloaded);
+#endif
 
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &jsonResponse);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-    res = curl_easy_perform(curl);
+        if (legacy_id.empty() || legacy_id == id) {
+            legacy_id = "legacy";
+        }
 
-    curl_slist_free_all(headers);
+        if (!versions.adopt(legacy_id, skip, error)) {
+            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not move the installed emulator to versions/%s: %s\n",
+                legacy_id.c_str(), error.c_str());
+            return false;
+        }
 
-    if (res != CURLE_OK || jsonResponse.empty()) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to fetch metadata: %s\n", curl_easy_strerror(res));
-        return false;
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Installed emulator moved to %s.\n", versions.path(legacy_id).string().c_str());
+        lcl_set_install_path(versions.path(legacy_id).string());
     }
 
-    json parsed;
+    _install_id = id;
+    _install_work.clear();
 
-    try {
-        parsed = json::parse(jsonResponse);
-    }
-    catch (const json::exception& e) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] JSON parse error: %s\n", e.what());
-        return false;
+    if (versions.installed(id) && versions.live() != id && std::filesystem::exists(versions.path(id) / _executable_name)) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Version %s is still installed, switching back to it.\n", id.c_str());
+        return true;
     }
 
-    if (!parsed.contains("tag_name") || !parsed.contains("assets") || !parsed["assets"].is_array()) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Invalid JSON structure.\n");
+    // The unpacked AppImage belongs to the version it came from.
+    if (!versions.begin(work, { "appdir" }, error)) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not prepare the install of version %s: %s\n", id.c_str(), error.c_str());
+        _install_id.clear();
         return false;
     }
 
-    _tag = parsed["tag_name"];
-    const auto& assets = parsed["assets"];
+    _install_work = work.string();
+    lcl_set_install_path(_install_work);
 
-    std::string download_url;
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Installing version %s into %s.\n", id.c_str(), _install_work.c_str());
 
-    for (const auto& asset : assets) {
-        std::string name = asset["name"];
+    return true;
+}
 
-        if (name.find(_search_token) != std::string::npos) {
-            download_url = asset["browser_download_url"];
-            _url_asset_id = asset["id"];
-            break;
-        }
+// Makes the version started by lcl_begin_version() live, then drops the versions beyond KEEP_VERSIONS.
+bool lcl_utils::lcl_commit_version()
+{
+    lcl_version_store versions(_directories[_directory_ids::EMULATOR_PATH]);
+    std::string id = _install_id;
+    std::string error;
+    std::error_code ec;
+
+    if (!_install_work.empty() && !std::filesystem::exists(_executable, ec)) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] %s is missing from version %s, keeping the installed one.\n",
+            _executable_name.c_str(), id.c_str());
+        lcl_abort_version();
+        return false;
     }
 
-    if (download_url.empty()) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] No asset found matching token: %s\n", _search_token.c_str());
+    if (_install_work.empty() ? !versions.activate(id, error) : !versions.commit(_install_work, id, error)) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not switch to version %s: %s\n", id.c_str(), error.c_str());
+        lcl_abort_version();
         return false;
     }
 
-    _current_version = std::to_string(_url_asset_id);
-    _new_version = std::to_string(_url_asset_id);
+    // The manifest describes the tree it was written for, a version switched back to is read back instead.
+    if (_install_work.empty()) {
+        std::filesystem::remove(_downloaderDirs[_downloader_ids::MANIFEST_FILE], ec);
+    }
 
-    // write final download url into vector
-    _urls.push_back(download_url);
+    _install_id.clear();
+    _install_work.clear();
+    lcl_set_install_path(versions.path(id).string());
 
-    // export final download URL
-    std::ofstream urlOut(_downloaderDirs[_downloader_ids::URL_FILE]);
+    std::ofstream currentOut(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
+    std::ofstream newOut(_downloaderDirs[_downloader_ids::NEW_VERSION_FILE]);
 
-    if (urlOut.is_open()) {
-        urlOut << _urls[_url_ids::DOWNLOAD_URL] << "\n";
-        urlOut.close();
-        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Download URL saved: %s\n", _urls[_url_ids::DOWNLOAD_URL].c_str());
+    if (currentOut.is_open() && newOut.is_open()) {
+        currentOut << id << "\n";
+        newOut << id << "\n";
     }
     else {
-        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write to URL file: %s\n", _downloaderDirs[_downloader_ids::URL_FILE].c_str());
-        return false;
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not update version files after the install.\n");
     }
 
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Version %s is live: %s\n", id.c_str(), _install_path.c_str());
+    versions.prune(static_cast<size_t>(_keep_versions), _pin_version);
+
     return true;
 }
 
-bool lcl_utils::lcl_download_asset(CURL *curl, CURLcode& res, std::string &url)
+// Drops the working copy, the live version is left as it was.
+void lcl_utils::lcl_abort_version()
 {
-    if (!curl) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to initialize cURL for download.\n");
-        return false;
+    lcl_version_store versions(_directories[_directory_ids::EMULATOR_PATH]);
+
+    if (!_install_work.empty()) {
+        versions.abort(_install_work);
     }
 
-    FILE* outFile = fopen(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE].c_str(), "wb");
+    _install_id.clear();
+    _install_work.clear();
+    lcl_set_install_path(lcl_live_path());
+}
+
+// PIN_VERSION holds the core at one of its kept versions, switched back to without a download.
+// No update is looked for while it is set, a version that is not kept is only warned about.
+bool lcl_utils::lcl_pin_version()
+{
+    lcl_version_store versions(_directories[_directory_ids::EMULATOR_PATH]);
 
-    if (!outFile) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to open file: %s\n",
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE].c_str());
+    if (_pin_version.empty()) {
         return false;
     }
 
-    struct curl_slist* download_headers = nullptr;
-    download_headers = curl_slist_append(download_headers, "User-Agent: curl/7.88.1");
+    if (!versions.installed(_pin_version)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Pinned version %s is not installed, updating as usual.\n", _pin_version.c_str());
+        return false;
+    }
 
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, download_headers);
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, outFile);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, nullptr);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
+    if (versions.live() == _pin_version) {
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Pinned to version %s, not looking for updates.\n", _pin_version.c_str());
+        return true;
+    }
 
-    res = curl_easy_perform(curl);
-    curl_slist_free_all(download_headers);
-    curl_easy_cleanup(curl);
-    fclose(outFile);
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Rolling back to pinned version %s.\n", _pin_version.c_str());
 
-    if (res != CURLE_OK) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to download file: %s\n", curl_easy_strerror(res));
-        return false;
-    }
+    _install_id = _pin_version;
+    _install_work.clear();
+    lcl_commit_version();
 
-    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Download complete: %s\n", 
-        _downloaderDirs[_downloader_ids::DOWNLOADED_FILE].c_str());
     return true;
 }
 
-bool lcl_utils::lcl_core_get()
+// Unpacks the downloaded asset into the version being installed and switches it live. Whatever
+// fails on the way, the live version stays as it was.
+bool lcl_utils::lcl_core_extractor()
 {
-    CURL* curl = curl_easy_init();
-    CURLcode res;
+    if (_install_id.empty()) {
+        return false;
+    }
 
-    if (!lcl_build_download_url(curl, res)) {
-		log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to set URL.\n");
+    // Kept from before, already unpacked while downloading, or updated from range requests.
+    if (!_install_work.empty() && !_stream_installed && !lcl_extract_asset()) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not install version %s, keeping the installed one.\n", _install_id.c_str());
+        lcl_abort_version();
         return false;
     }
 
-    if (!std::filesystem::exists(_executable)) {
-        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] First boot detected, downloading emulator...\n");
+    return lcl_commit_version();
+}
 
-        if (!lcl_download_asset(curl, res, _urls[_url_ids::DOWNLOAD_URL])) {
-			log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to download emulator.\n");
-            return false;
-        }
+// Archive tools unpack into a scratch folder that is merged into the install afterwards: files are
+// replaced rather than written through, and one top level folder is flattened like in-process.
+bool lcl_utils::lcl_extract_with_tool(const std::string& command, const std::string& temp)
+{
+    std::string error;
+    std::error_code ec;
 
-        // Export current version ID in both files.
-        std::ofstream currentOut(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
-        std::ofstream newOut(_downloaderDirs[_downloader_ids::NEW_VERSION_FILE]);
+    std::filesystem::remove_all(temp, ec);
 
-        if (currentOut.is_open() && newOut.is_open()) {
-            currentOut << _current_version << "\n";
-            newOut << _current_version << "\n";
-            currentOut.close();
-            newOut.close();
-        }
-        else {
-            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write version files on first boot.\n");
-        }
+    int status = system(command.c_str());
 
-        return true;
-    }
+    std::filesystem::remove(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE], ec);
 
-    // If it's not the first boot, check for updates.
+#ifdef _WIN32
+    bool failed = status != 0;
+#elif __linux__
+    // unzip and 7z both exit with 1 on warnings, the files are extracted.
+    bool failed = status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) > 1;
+#endif
 
-    std::ifstream currentIn(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
-    std::ofstream newOut(_downloaderDirs[_downloader_ids::NEW_VERSION_FILE]);
+    if (failed) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Archive tool failed (status %d).\n", status);
+        std::filesystem::remove_all(temp, ec);
+        return false;
+    }
 
-    if (!currentIn.is_open() || !newOut.is_open()) {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not read version files.\n");
+    if (!lcl_move_extracted(temp, _install_path, error)) {
+        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not move extracted files into place: %s\n", error.c_str());
+        std::filesystem::remove_all(temp, ec);
         return false;
     }
 
-    std::getline(currentIn, _current_version);
+#ifndef _WIN32
+    std::filesystem::permissions(_executable, std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+        std::filesystem::perms::others_exec, std::filesystem::perm_options::add, ec);
+#endif
 
-    if (newOut.is_open()) {
-        newOut << _new_version << "\n";
-		newOut.close();
-    }
-    else {
-        log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not write new version file.\n");
+    return true;
+}
+
+// Unpacks a downloaded zip or 7z in-process, straight into the version being installed. On failure
+// the archive is left where it was for the archive tools.
+bool lcl_utils::lcl_extract_archive()
+{
+    auto archive = std::filesystem::path(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+    auto working = archive;
+    std::error_code ec;
+
+    // On Linux the archive carries the executable's name, which the install is about to use.
+    working += ".extract";
+    std::filesystem::rename(archive, working, ec);
+
+    if (ec) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not open %s for extraction: %s\n", archive.string().c_str(), ec.message().c_str());
         return false;
     }
 
-    if (_current_version != _new_version) {
-        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] New version detected (current: %s, new: %s). Downloading update...\n",
-            _current_version.c_str(), _new_version.c_str());
+    bool extracted{};
+    std::string error{};
+    lcl_install_manifest installed{};
 
-        if (!lcl_download_asset(curl, res, _urls[_url_ids::DOWNLOAD_URL])) {
-			log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Failed to download update.\n");
-            return false;
-        }
+    // Dropped up front, once anything below touched the tree it no longer describes it.
+    installed.load(_downloaderDirs[_downloader_ids::MANIFEST_FILE]);
+    std::filesystem::remove(_downloaderDirs[_downloader_ids::MANIFEST_FILE], ec);
 
-        // Update versions
-        std::ofstream currentOut(_downloaderDirs[_downloader_ids::CURRENT_VERSION_FILE]);
-        std::ofstream newOut(_downloaderDirs[_downloader_ids::NEW_VERSION_FILE]);
+    if (_archive_extension == ".7z") {
+        lcl_7z_extractor extractor(working, _install_path);
 
-        if (currentOut.is_open() && newOut.is_open()) {
-            currentOut << _new_version << "\n";
-            newOut << _new_version << "\n";
-			currentOut.close();
-            newOut.close();
-        }
-        else {
-            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not update version files after download.\n");
-            return false;
-        }
+        extracted = extractor.run();
+        error = extractor.error();
     }
     else {
-        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Core is already up to date (version: %s).\n", _current_version.c_str());
+        lcl_zip_extractor extractor(working, _install_path);
+
+        // Updates only rewrite the entries whose CRC-32 changed.
+        extractor.delta(std::move(installed));
+        extracted = extractor.run();
+        error = extractor.error();
+
+        if (extracted && !extractor.manifest().save(_downloaderDirs[_downloader_ids::MANIFEST_FILE])) {
+            log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not write the install manifest, the next update reads every file back.\n");
+        }
+    }
+
+    if (!extracted) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] In-process extraction failed (%s), using the archive tools.\n", error.c_str());
+        std::filesystem::rename(working, archive, ec);
         return false;
     }
 
+    std::filesystem::remove(working, ec);
+
+#ifndef _WIN32
+    std::filesystem::permissions(_executable, std::filesystem::perms::owner_exec | std::filesystem::perms::group_exec |
+        std::filesystem::perms::others_exec, std::filesystem::perm_options::add, ec);
+#endif
+
     return true;
 }
 
 #ifdef _WIN32
-bool lcl_utils::lcl_core_extractor()
+bool lcl_utils::lcl_extract_asset()
 {
     std::string command{};
+    auto temp = (std::filesystem::path(_directories[_directory_ids::EMULATOR_PATH]) / ".lcl_extract").string();
 
 	// On windows use PowerShell
     if (_archive_extension == ".zip") {
 		log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: Extracting emulator from ZIP archive.\n");
+
+        if (lcl_extract_archive()) {
+            return true;
+        }
+
         command = std::format(
             "powershell -Command \""
-            "Expand-Archive -Path '{}' -DestinationPath '{}' -Force; "
-            "Remove-Item -Path '{}' -Force; "
-            "$subfolder = Get-ChildItem -Path '{}' -Directory | Select-Object -First 1; "
-            "if ($subfolder) {{ "
-            "Copy-Item -Path \\\"$($subfolder.FullName)\\\\*\\\" -Destination '{}' -Recurse -Force; "
-            "Remove-Item -Path $subfolder.FullName -Recurse -Force; "
-            "}}"
+            "Expand-Archive -Path '{}' -DestinationPath '{}' -Force"
             "\"",
             _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _directories[_directory_ids::EMULATOR_PATH]
+            temp
         );
 
-        system(command.c_str());
-        std::filesystem::remove(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+        return lcl_extract_with_tool(command, temp);
     }
     // Use 7z4PowerShell if 7z
     else if (_archive_extension == ".7z") {
 		log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO]: 7z archive detected.\n");
-        
+
+        if (lcl_extract_archive()) {
+            return true;
+        }
+
         command = std::format(
             "powershell -Command \""
             "if ($null -ne (Get-Module -ListAvailable -Name 7Zip4PowerShell)) {{ exit 0 }} else {{ exit 1 }}\""
@@ -442,39 +1426,37 @@ bool lcl_utils::lcl_core_extractor()
 
         command = std::format(
             "powershell -Command \""
-            "Expand-7zip -ArchiveFileName '{}' -TargetPath '{}'; "
-            "Remove-Item -Path '{}' -Force; "
-            "$subfolder = Get-ChildItem -Path '{}' -Directory | Select-Object -First 1; "
-            "if ($subfolder) {{ "
-            "Copy-Item -Path \\\"$($subfolder.FullName)\\\\*\\\" -Destination '{}' -Recurse -Force; "
-            "Remove-Item -Path $subfolder.FullName -Recurse -Force; "
-            "}}"
+            "Expand-7zip -ArchiveFileName '{}' -TargetPath '{}'"
             "\"",
             _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _directories[_directory_ids::EMULATOR_PATH]
+            temp
         );
 
-        system(command.c_str());
-        std::filesystem::remove(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+        return lcl_extract_with_tool(command, temp);
     } else {
         log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Not an archive, nothing to extract.\n");
         return false;
     }
-
-    return true;
 } 
 
 #elif __linux__
-bool lcl_utils::lcl_core_extractor()
+bool lcl_utils::lcl_extract_asset()
 {
     std::string command{};
+    auto temp = (std::filesystem::path(_directories[_directory_ids::EMULATOR_PATH]) / ".lcl_extract").string();
+
+    // Without a LINUX_ARCHIVE_EXT the asset is an AppImage.
+    if (lcl_asset_is_appimage()) {
+        std::error_code ec;
+
+        // The AppImage is the whole install, it only moves into the version.
+        std::filesystem::rename(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE], _executable, ec);
+
+        if (ec) {
+            log_cb(RETRO_LOG_ERROR, "[LAUNCHER-ERROR] Could not move the AppImage into place: %s\n", ec.message().c_str());
+            return false;
+        }
 
-    // On linux if we don't have neither zip or 7z, we have .appImage by default.
-    if (_archive_extension != ".zip" || _archive_extension != ".7z") {
         command = std::format("chmod +x '{}'", _executable);
         if (system(command.c_str()) == 0) {
             log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Permission set for appImage.\n");
@@ -486,47 +1468,98 @@ bool lcl_utils::lcl_core_extractor()
     }
 
     if (_archive_extension == ".zip") {
-        command = std::format(
-            "unzip -o '{}' -d '{}'; "
-            "rm -f '{}'; "
-            "subfolder=$(find '{}' -mindepth 1 -maxdepth 1 -type d | head -n 1); "
-            "if [ -n \"$subfolder\" ]; then "
-            "mv \"$subfolder\"/* '{}'; "
-            "rm -rf \"$subfolder\"; "
-            "fi; "
-            "chmod +x '{}'",
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _executable
-        );
+        if (lcl_extract_archive()) {
+            return true;
+        }
 
-        system(command.c_str());
-        std::filesystem::remove(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+        command = std::format("unzip -o '{}' -d '{}'", _downloaderDirs[_downloader_ids::DOWNLOADED_FILE], temp);
+
+        return lcl_extract_with_tool(command, temp);
     }
-    else if (_archive_extension != ".7z") {
-        command = std::format(
-            "7z x -o'{}' '{}' -y; "
-            "rm -f '{}'; "
-            "subfolder=$(find '{}' -mindepth 1 -maxdepth 1 -type d | head -n 1); "
-            "if [ -n \"$subfolder\" ]; then "
-            "mv \"$subfolder\"/* '{}'; "
-            "rm -rf \"$subfolder\"; "
-            "fi; "
-            "chmod +x '{}'",
-            _directories[_directory_ids::EMULATOR_PATH],
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _downloaderDirs[_downloader_ids::DOWNLOADED_FILE],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _directories[_directory_ids::EMULATOR_PATH],
-            _executable
-        );
+    else if (_archive_extension == ".7z") {
+        if (lcl_extract_archive()) {
+            return true;
+        }
+
+        command = std::format("7z x -o'{}' '{}' -y", temp, _downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+
+        return lcl_extract_with_tool(command, temp);
+    }
+    return true;
+}
+#endif
 
-        system(command.c_str());
-        std::filesystem::remove(_downloaderDirs[_downloader_ids::DOWNLOADED_FILE]);
+#ifdef __linux__
+// Unpacks the AppImage once into <version>/appdir, so launches under flatpak run its AppRun
+// instead of unpacking the whole squashfs again with --appimage-extract-and-run. It goes live
+// and is pruned together with its version, which is never changed once installed: a launch
+// still running from an older version keeps its tree.
+bool lcl_utils::lcl_prepare_appdir(std::string& appdir)
+{
+    auto target = std::filesystem::path(_install_path) / "appdir";
+    auto temp = std::filesystem::path(_install_path) / std::format(".appdir.{}", getpid());
+    std::vector<std::filesystem::path> stale;
+    std::string command{};
+    std::error_code ec;
+
+    if (!std::filesystem::exists(_executable, ec)) {
+        return false;
+    }
+
+    appdir = target.string();
+
+    if (std::filesystem::exists(target / "AppRun", ec)) {
+        return true;
+    }
+
+    // Left behind by launches that did not finish unpacking.
+    for (const auto& entry : std::filesystem::directory_iterator(_install_path, ec)) {
+        auto name = entry.path().filename().string();
+
+        if (name.starts_with(".appdir.") && kill(std::atoi(name.c_str() + 8), 0) != 0 && errno == ESRCH) {
+            stale.push_back(entry.path());
+        }
+    }
+
+    for (const auto& path : stale) {
+        std::filesystem::remove_all(path, ec);
+    }
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Extracting AppImage into %s.\n", appdir.c_str());
+
+    // Unpacked beside the final folder and renamed to it once complete, so neither a crash nor
+    // another instance launching meanwhile ever sees half a tree.
+    std::filesystem::remove_all(temp, ec);
+    std::filesystem::create_directories(temp / "squashfs-root", ec);
+
+    lcl_squashfs_extractor extractor(_executable, temp / "squashfs-root");
+    bool unpacked = extractor.run();
+
+    // The AppImage's own --appimage-extract only for images the extractor can't read.
+    if (!unpacked) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] In-process AppImage extraction failed (%s), using --appimage-extract.\n", extractor.error().c_str());
+
+        std::filesystem::remove_all(temp, ec);
+        std::filesystem::create_directories(temp, ec);
+        command = std::format("cd '{}' && '{}' --appimage-extract > /dev/null", temp.string(), _executable);
+        unpacked = system(command.c_str()) == 0;
+    }
+
+    if (!unpacked || !std::filesystem::exists(temp / "squashfs-root" / "AppRun", ec)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not extract the AppImage, running it with --appimage-extract-and-run.\n");
+        std::filesystem::remove_all(temp, ec);
+        return false;
     }
+
+    // Fails when another instance got there first, its tree is used then.
+    std::filesystem::rename(temp / "squashfs-root", target, ec);
+    std::filesystem::remove_all(temp, ec);
+
+    if (!std::filesystem::exists(target / "AppRun", ec)) {
+        log_cb(RETRO_LOG_WARN, "[LAUNCHER-WARN] Could not move the extracted AppImage into place.\n");
+        return false;
+    }
+
     return true;
 }
 #endif
@@ -537,10 +1570,30 @@ bool lcl_utils::lcl_core_boot(const struct retro_game_info* info) {
     std::string args {};
     std::string flatpak_args{};
     std::string bios_arg{};
+    std::string executable = _executable;
 
     if (_is_flatpak) {
         flatpak_args = _cfg_section["FLATPAK_ARGS"].as<std::string>();
     }
+
+#ifdef __linux__
+    std::string appdir{};
+    std::string appimage_env{};
+    const std::string extract_and_run = "--appimage-extract-and-run";
+
+    // AppRun from the unpacked tree, what the AppImage runtime would run after unpacking it again.
+    if (_is_flatpak && lcl_asset_is_appimage() && lcl_prepare_appdir(appdir)) {
+        auto pos = flatpak_args.find(extract_and_run);
+
+        if (pos != std::string::npos) {
+            flatpak_args.erase(pos, extract_and_run.size());
+        }
+
+        // Set for the emulator alone, like the runtime does, RetroArch's own environment stays as it is.
+        appimage_env = std::format("APPIMAGE='{}' APPDIR='{}' ", _executable, appdir);
+        executable = (std::filesystem::path(appdir) / "AppRun").string();
+    }
+#endif
     
     // concat flatpak args to the emulator args if available
     args = flatpak_args + " " + _cfg_section["ARGS"].as<std::string>();
@@ -554,12 +1607,12 @@ bool lcl_utils::lcl_core_boot(const struct retro_game_info* info) {
             cmd_win = std::format("cmd /c \"\"{}\"\"", info->path);
             cmd = std::format("wine '{}'", info->path);
         } else {
-            cmd_win = std::format("cmd /c \"\"{}\" {} \"{}\"\"", _executable, args, info->path);
-            cmd = std::format("'{}' {} \"{}\"", _executable, args, info->path);
+            cmd_win = std::format("cmd /c \"\"{}\" {} \"{}\"\"", executable, args, info->path);
+            cmd = std::format("'{}' {} \"{}\"", executable, args, info->path);
         }
     } else {
-        cmd_win = std::format("cmd /c \"\"{}\" {}\"\"", _executable, bios_arg);
-        cmd = std::format("\"{}\" {} {}", _executable, args, bios_arg);
+        cmd_win = std::format("cmd /c \"\"{}\" {}\"\"", executable, bios_arg);
+        cmd = std::format("\"{}\" {} {}", executable, args, bios_arg);
     }
 
 #ifdef _WIN32
@@ -571,6 +1624,7 @@ bool lcl_utils::lcl_core_boot(const struct retro_game_info* info) {
     }
 
 #elif __linux__
+    cmd = appimage_env + cmd;
     log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Booting emulator with command: %s\n", cmd.c_str());
 
     if (system(cmd.c_str()) != 0) {
@@ -591,13 +1645,127 @@ static void fallback_log(enum retro_log_level level, const char* fmt, ...)
     va_end(va);
 }
 
+// LCL.cfg as seen from retro_init, before any content (and lcl_utils instance) exists.
+static bool load_launcher_cfg(ini::IniFile& cfg)
+{
+    auto ini_path = std::filesystem::current_path() / "LCL.cfg";
+
+    if (!std::filesystem::exists(ini_path)) {
+        return false;
+    }
+
+    try {
+        cfg.load(ini_path.string());
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+// Opt-in: resolve, connect and handshake with the release host while the user is still picking content,
+// the update check then reuses the open connection.
+static void start_prewarm()
+{
+    auto base_path = std::filesystem::current_path();
+    ini::IniFile cfg;
+    lcl_release_cache cache;
+
+    if (core_name == "windows" || !load_launcher_cfg(cfg)) {
+        return;
+    }
+
+    if (!cfg.contains("lcl") || !cfg.contains(core_name) || !lcl_cfg_get<bool>(cfg["lcl"], "PREWARM", false)) {
+        return;
+    }
+
+    auto& section = cfg[core_name];
+    std::string api_url = lcl_cfg_get<std::string>(section, "API_URL", "");
+    long long ttl = lcl_cfg_get<long>(section, "UPDATE_CHECK_TTL", 0);
+    bool has_cache = cache.load((base_path / "system" / core_name / "3.ReleaseCache.json").string());
+
+    // Nothing to warm up when the next check will be answered from the release cache.
+    if (api_url.rfind("http", 0) != 0 || (has_cache && ttl > 0 && unix_now() - cache.checked_at < ttl)) {
+        return;
+    }
+
+    lcl_net::instance().load(base_path / "system", base_path / "system" / core_name / "4.NetStats.log",
+        lcl_cfg_get<long>(cfg["lcl"], "DNS_CACHE_TTL", 3600), lcl_cfg_get<bool>(cfg["lcl"], "CURL_VERBOSE", false));
+    // GitHub does not count /rate_limit against the limit, other hosts get a HEAD on their root.
+    auto host_end = api_url.find('/', api_url.find("://") + 3);
+    std::string warm_url = api_url.rfind("https://api.github.com/", 0) == 0 ? "https://api.github.com/rate_limit" :
+        api_url.substr(0, host_end == std::string::npos ? api_url.size() : host_end) + "/";
+
+    lcl_net::instance().prewarm(warm_url);
+}
+
+// Opt-in: serve release metadata and archives of every configured core to the rest of the LAN.
+static void start_mirror()
+{
+    auto base_path = std::filesystem::current_path();
+    ini::IniFile cfg;
+    std::vector<lcl_mirror_source> sources;
+
+    if (!load_launcher_cfg(cfg) || !cfg.contains("lcl") || !lcl_cfg_get<bool>(cfg["lcl"], "MIRROR", false)) {
+        return;
+    }
+
+    auto& global_section = cfg["lcl"];
+
+    for (auto& [section_name, section] : cfg) {
+        std::string provider = lcl_cfg_get<std::string>(section, "PROVIDER", "github");
+        lcl_mirror_source source;
+
+        // Only JSON release feeds can be mirrored, file:// directories are already local.
+        if (section_name == "lcl" || provider == "file") {
+            continue;
+        }
+
+        source.section = section_name;
+        source.api_url = lcl_cfg_get<std::string>(section, "API_URL", "");
+        source.ttl = lcl_cfg_get<long>(section, "UPDATE_CHECK_TTL", 3600);
+
+        if (source.api_url.rfind("http", 0) == 0) {
+            sources.push_back(source);
+        }
+    }
+
+    std::string api_token = lcl_cfg_get<std::string>(global_section, "GITHUB_TOKEN", "");
+
+    if (api_token.empty()) {
+        if (const char* token = std::getenv("GITHUB_TOKEN")) {
+            api_token = token;
+        }
+    }
+
+    lcl_net::instance().load(base_path / "system", base_path / "system" / core_name / "4.NetStats.log",
+        lcl_cfg_get<long>(global_section, "DNS_CACHE_TTL", 3600), lcl_cfg_get<bool>(global_section, "CURL_VERBOSE", false));
+    lcl_mirror::instance().start(base_path / "system" / "LCL.mirror",
+        lcl_cfg_get<std::string>(global_section, "MIRROR_BIND", "0.0.0.0"),
+        lcl_cfg_get<int>(global_section, "MIRROR_PORT", 8787), api_token, sources);
+}
+
 void retro_init(void)
 {
+    g_cancel_update = false;
+    start_prewarm();
+    start_mirror();
+
     frame_buf = (uint32_t*)calloc(320 * 240, sizeof(uint32_t));
 }
 
 void retro_deinit(void)
 {
+    g_cancel_update = true;
+
+    if (g_update_thread.joinable()) {
+        g_update_thread.join();
+    }
+
+    lcl_mirror::instance().stop();
+    lcl_net::instance().cleanup();
+
     free(frame_buf);
     frame_buf = NULL;
 }
@@ -701,7 +1869,7 @@ void retro_run(void)
 
 bool retro_load_game(const struct retro_game_info* info)
 {
-    auto core_obj = std::make_unique<lcl_utils>();
+    auto core_obj = std::make_shared<lcl_utils>();
 
     if (!core_obj->lcl_check_config_file()) {
         return false;
@@ -716,14 +1884,48 @@ bool retro_load_game(const struct retro_game_info* info)
 
     core_obj->lcl_setup_config_params();
 
-    // if first boot download emulator, else check for updates
-    if (core_obj->lcl_setup_dirs()) {
+    // A staging download of the previous game stops before anything waits for a lock, it resumes next time.
+    g_cancel_update = true;
+
+    if (g_update_thread.joinable()) {
+        g_update_thread.join();
+    }
+
+    g_cancel_update = false;
+
+    // Launch-first boots what is installed instead of waiting for another instance's update.
+    // Whoever held the lock may have installed meanwhile, so first boot is decided after it.
+    if (!core_obj->lcl_lock_update(!core_obj->lcl_background_updates() || !core_obj->lcl_core_installed())) {
+        core_obj->lcl_setup_dirs();
+    } else if (core_obj->lcl_setup_dirs()) {
+        // if first boot download emulator, else check for updates
         core_obj->lcl_core_get();
         core_obj->lcl_core_extractor();
-    } else if (core_obj->lcl_core_get()) {
-        core_obj->lcl_core_extractor();
+        core_obj->lcl_unlock_update();
+    } else if (core_obj->lcl_pin_version()) {
+        // Held at PIN_VERSION, switched back to it if needed and never updated.
+        core_obj->lcl_unlock_update();
+    } else if (core_obj->lcl_background_updates()) {
+        // Launch-first: install what was staged last time, boot, and look for the next update meanwhile.
+        core_obj->lcl_apply_staged_update();
+        core_obj->lcl_unlock_update();
+
+        // The worker gets its own copy, the emulator boots from core_obj while it runs.
+        auto stage_obj = std::make_shared<lcl_utils>(*core_obj);
+
+        g_update_thread = std::thread([stage_obj]() {
+            stage_obj->lcl_core_stage_update();
+        });
+    } else {
+        if (core_obj->lcl_core_get()) {
+            core_obj->lcl_core_extractor();
+        }
+
+        core_obj->lcl_unlock_update();
     }
 
+    lcl_net::instance().save();
+
     core_obj->lcl_core_boot(info);
 
     return true;
@@ -0,0 +1,275 @@
+#include "lcl_versions.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+extern retro_log_printf_t log_cb;
+
+// Hard links every file under source into target (copies where links fail), symlinks are recreated.
+static bool clone_tree(const std::filesystem::path& source, const std::filesystem::path& target,
+    const std::vector<std::string>& skip, std::error_code& ec) {
+    std::filesystem::create_directories(target, ec);
+
+    if (ec) {
+        return false;
+    }
+
+    for (const auto& entry : std::filesystem::directory_iterator(source, ec)) {
+        auto name = entry.path().filename().string();
+        auto destination = target / entry.path().filename();
+        auto status = entry.symlink_status(ec);
+
+        if (ec) {
+            return false;
+        }
+
+        if (std::find(skip.begin(), skip.end(), name) != skip.end()) {
+            continue;
+        }
+
+        if (std::filesystem::is_symlink(status)) {
+            std::filesystem::copy_symlink(entry.path(), destination, ec);
+        } else if (std::filesystem::is_directory(status)) {
+            clone_tree(entry.path(), destination, {}, ec);
+        } else if (std::filesystem::is_regular_file(status)) {
+            std::filesystem::create_hard_link(entry.path(), destination, ec);
+
+            if (ec) {
+                ec.clear();
+                std::filesystem::copy_file(entry.path(), destination, ec);
+            }
+        }
+
+        if (ec) {
+            return false;
+        }
+    }
+
+    return !ec;
+}
+
+lcl_version_store::lcl_version_store(std::filesystem::path root)
+    : _root(std::move(root)) {
+    _versions = _root / "versions";
+}
+
+std::filesystem::path lcl_version_store::path(const std::string& id) const {
+    return _versions / id;
+}
+
+bool lcl_version_store::installed(const std::string& id) const {
+    std::error_code ec;
+
+    return !id.empty() && id[0] != '.' && std::filesystem::is_directory(path(id), ec);
+}
+
+std::string lcl_version_store::live() const {
+    std::error_code ec;
+    std::string id;
+
+#ifdef _WIN32
+    std::ifstream in(_root / "current.txt");
+
+    std::getline(in, id);
+#else
+    id = std::filesystem::read_symlink(_root / "current", ec).filename().string();
+#endif
+
+    return installed(id) ? id : std::string();
+}
+
+// Working directories of interrupted installs and versions whose deletion did not finish.
+// Only called with the update lock held, nothing else uses them.
+void lcl_version_store::cleanup() {
+    std::error_code ec;
+    std::vector<std::filesystem::path> leftovers;
+
+    for (const auto& entry : std::filesystem::directory_iterator(_versions, ec)) {
+        if (entry.path().filename().string().starts_with(".")) {
+            leftovers.push_back(entry.path());
+        }
+    }
+
+    for (const auto& leftover : leftovers) {
+        std::filesystem::remove_all(leftover, ec);
+    }
+}
+
+bool lcl_version_store::begin(std::filesystem::path& work, const std::vector<std::string>& skip, std::string& error) {
+    std::error_code ec;
+    std::string live_id = live();
+
+    cleanup();
+    work = _versions / ".install";
+
+    if (live_id.empty()) {
+        std::filesystem::create_directories(work, ec);
+    } else {
+        clone_tree(path(live_id), work, skip, ec);
+    }
+
+    if (ec) {
+        error = "could not prepare " + work.string() + ": " + ec.message();
+        std::filesystem::remove_all(work, ec);
+        return false;
+    }
+
+    return true;
+}
+
+bool lcl_version_store::commit(const std::filesystem::path& work, const std::string& id, std::string& error) {
+    std::error_code ec;
+    auto target = path(id);
+    auto replaced = _versions / ("." + id + ".replaced");
+
+    // Reinstalling a version that is still there (a repair): the old copy steps aside first.
+    if (std::filesystem::exists(target, ec)) {
+        std::filesystem::remove_all(replaced, ec);
+        std::filesystem::rename(target, replaced, ec);
+
+        if (ec) {
+            error = "could not replace " + target.string() + ": " + ec.message();
+            return false;
+        }
+    }
+
+    std::filesystem::rename(work, target, ec);
+
+    if (ec) {
+        error = "could not move " + work.string() + " into place: " + ec.message();
+        return false;
+    }
+
+    std::filesystem::remove_all(replaced, ec);
+
+    return activate(id, error);
+}
+
+void lcl_version_store::abort(const std::filesystem::path& work) {
+    std::error_code ec;
+
+    std::filesystem::remove_all(work, ec);
+}
+
+bool lcl_version_store::activate(const std::string& id, std::string& error) {
+    std::error_code ec;
+
+#ifdef _WIN32
+    auto pointer = _root / "current.txt";
+    auto temp = _root / ".current.txt";
+    std::ofstream out(temp, std::ios::trunc);
+
+    if (!(out << id << "\n")) {
+        error = "could not write " + temp.string();
+        return false;
+    }
+
+    out.close();
+
+    // std::filesystem::rename() does not replace an existing file on every Windows runtime.
+    if (!MoveFileExW(temp.wstring().c_str(), pointer.wstring().c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ec = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+    }
+#else
+    auto pointer = _root / "current";
+    auto temp = _root / ".current";
+
+    std::filesystem::remove(temp, ec);
+    std::filesystem::create_directory_symlink(std::filesystem::path("versions") / id, temp, ec);
+
+    if (!ec) {
+        std::filesystem::rename(temp, pointer, ec);
+    }
+#endif
+
+    if (ec) {
+        error = "could not make " + id + " live: " + ec.message();
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+
+    // When it went live, prune() keeps the most recent ones.
+    std::filesystem::last_write_time(path(id), std::filesystem::file_time_type::clock::now(), ec);
+
+    return true;
+}
+
+bool lcl_version_store::adopt(const std::string& id, const std::vector<std::string>& skip, std::string& error) {
+    std::error_code ec;
+    auto work = _versions / ".install";
+    auto skipped = skip;
+    std::vector<std::filesystem::path> adopted;
+
+    skipped.insert(skipped.end(), { "versions", "current", ".current", "current.txt", ".current.txt" });
+
+    for (const auto& entry : std::filesystem::directory_iterator(_root, ec)) {
+        if (std::find(skipped.begin(), skipped.end(), entry.path().filename().string()) == skipped.end()) {
+            adopted.push_back(entry.path());
+        }
+    }
+
+    cleanup();
+
+    // Linked over and made live before the old files go, an interruption leaves one working install either way.
+    if (ec || !clone_tree(_root, work, skipped, ec)) {
+        error = "could not copy the installed files: " + ec.message();
+        std::filesystem::remove_all(work, ec);
+        return false;
+    }
+
+    if (!commit(work, id, error)) {
+        std::filesystem::remove_all(work, ec);
+        return false;
+    }
+
+    for (const auto& path : adopted) {
+        std::filesystem::remove_all(path, ec);
+    }
+
+    return true;
+}
+
+void lcl_version_store::prune(size_t keep, const std::string& pinned) {
+    std::error_code ec;
+    std::string live_id = live();
+    std::vector<std::pair<std::filesystem::file_time_type, std::string>> versions;
+
+    cleanup();
+
+    for (const auto& entry : std::filesystem::directory_iterator(_versions, ec)) {
+        auto id = entry.path().filename().string();
+
+        if (installed(id) && id != live_id && id != pinned) {
+            versions.emplace_back(std::filesystem::last_write_time(entry.path(), ec), id);
+        }
+    }
+
+    std::sort(versions.begin(), versions.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    size_t slots = keep > 0 && !live_id.empty() ? keep - 1 : keep;
+
+    for (size_t i = slots; i < versions.size(); i++) {
+        auto removed = _versions / ("." + versions[i].second + ".removed");
+
+        // Renamed out of the way first: on Windows that fails while the version is running,
+        // which leaves it whole instead of half deleted.
+        std::filesystem::rename(path(versions[i].second), removed, ec);
+
+        if (ec) {
+            log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Version %s is in use, kept for now.\n", versions[i].second.c_str());
+            continue;
+        }
+
+        std::filesystem::remove_all(removed, ec);
+        log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] Removed old version %s.\n", versions[i].second.c_str());
+    }
+}
@@ -0,0 +1,703 @@
+#include "lcl_zsync.hpp"
+#include "lcl_net.hpp"
+#include "lcl_sha256.hpp"
+#include "libretro.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <system_error>
+
+extern retro_log_printf_t log_cb;
+
+static uint32_t rotl32(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// MD4 of one block, what zsync uses to confirm a rolling checksum match.
+static void md4(const unsigned char* data, size_t size, unsigned char digest[16]) {
+    static const int R1[4] = { 3, 7, 11, 19 };
+    static const int R2[4] = { 3, 5, 9, 13 };
+    static const int R3[4] = { 3, 9, 11, 15 };
+    static const int K3[16] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+    uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    unsigned char tail[128] = {};
+    size_t full = size & ~size_t(63);
+    size_t rest = size - full;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+
+    std::memcpy(tail, data + full, rest);
+    tail[rest] = 0x80;
+
+    size_t tail_size = rest < 56 ? 64 : 128;
+
+    for (int i = 0; i < 8; i++) {
+        tail[tail_size - 8 + i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+
+    for (size_t offset = 0; offset < full + tail_size; offset += 64) {
+        const unsigned char* block = offset < full ? data + offset : tail + (offset - full);
+        uint32_t x[16];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+        for (int i = 0; i < 16; i++) {
+            x[i] = static_cast<uint32_t>(block[i * 4]) | (static_cast<uint32_t>(block[i * 4 + 1]) << 8) |
+                (static_cast<uint32_t>(block[i * 4 + 2]) << 16) | (static_cast<uint32_t>(block[i * 4 + 3]) << 24);
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint32_t f = (b & c) | (~b & d);
+            uint32_t t = rotl32(a + f + x[i], R1[i % 4]);
+            a = d; d = c; c = b; b = t;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint32_t g = (b & c) | (b & d) | (c & d);
+            uint32_t t = rotl32(a + g + x[(i % 4) * 4 + i / 4] + 0x5A827999, R2[i % 4]);
+            a = d; d = c; c = b; b = t;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint32_t h = b ^ c ^ d;
+            uint32_t t = rotl32(a + h + x[K3[i]] + 0x6ED9EBA1, R3[i % 4]);
+            a = d; d = c; c = b; b = t;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        digest[i] = static_cast<unsigned char>(state[i / 4] >> (8 * (i % 4)));
+    }
+}
+
+// Incremental SHA-1, only for the whole file check zsync control files carry.
+class sha1 {
+public:
+    void update(const unsigned char* data, size_t size) {
+        _length += size;
+
+        while (size > 0) {
+            size_t take = std::min(size, sizeof(_buffer) - _buffered);
+
+            std::memcpy(_buffer + _buffered, data, take);
+            _buffered += take;
+            data += take;
+            size -= take;
+
+            if (_buffered == sizeof(_buffer)) {
+                compress(_buffer);
+                _buffered = 0;
+            }
+        }
+    }
+
+    std::string finish() {
+        uint64_t bits = _length * 8;
+        unsigned char pad = 0x80;
+        unsigned char zero = 0;
+        unsigned char length[8];
+        char hex[41];
+
+        update(&pad, 1);
+
+        while (_buffered != 56) {
+            update(&zero, 1);
+        }
+
+        for (int i = 0; i < 8; i++) {
+            length[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        }
+
+        update(length, sizeof(length));
+
+        for (int i = 0; i < 5; i++) {
+            std::snprintf(hex + i * 8, 9, "%08x", _state[i]);
+        }
+
+        return std::string(hex, 40);
+    }
+
+private:
+    void compress(const unsigned char* block) {
+        uint32_t w[80];
+        uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3], e = _state[4];
+
+        for (int i = 0; i < 16; i++) {
+            w[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) |
+                (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | static_cast<uint32_t>(block[i * 4 + 3]);
+        }
+
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        for (int i = 0; i < 80; i++) {
+            uint32_t f = i < 20 ? ((b & c) | (~b & d)) + 0x5A827999 :
+                i < 40 ? (b ^ c ^ d) + 0x6ED9EBA1 :
+                i < 60 ? ((b & c) | (b & d) | (c & d)) + 0x8F1BBCDC :
+                (b ^ c ^ d) + 0xCA62C1D6;
+            uint32_t t = rotl32(a, 5) + f + e + w[i];
+
+            e = d; d = c; c = rotl32(b, 30); b = a; a = t;
+        }
+
+        _state[0] += a;
+        _state[1] += b;
+        _state[2] += c;
+        _state[3] += d;
+        _state[4] += e;
+    }
+
+    uint32_t _state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    unsigned char _buffer[64] = {};
+    size_t _buffered = 0;
+    uint64_t _length = 0;
+};
+
+// zsync's rolling checksum: a is the byte sum, b weighs each byte by its distance to the block end.
+static void block_rsum(const unsigned char* data, size_t size, uint16_t& a, uint16_t& b) {
+    a = 0;
+    b = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        a = static_cast<uint16_t>(a + data[i]);
+        b = static_cast<uint16_t>(b + (size - i) * data[i]);
+    }
+}
+
+static void roll_rsum(uint16_t& a, uint16_t& b, unsigned char out, unsigned char in, uint32_t size) {
+    a = static_cast<uint16_t>(a + in - out);
+    b = static_cast<uint16_t>(b + a - size * out);
+}
+
+static size_t append_control(char* data, size_t size, size_t nmemb, void* userdata) {
+    auto* control = static_cast<std::string*>(userdata);
+
+    control->append(data, size * nmemb);
+
+    return size * nmemb;
+}
+
+bool lcl_zsync_make_control(const std::filesystem::path& file, const std::string& url, std::string& control) {
+    std::ifstream in(file, std::ios::binary);
+    std::error_code ec;
+    uint64_t length = std::filesystem::file_size(file, ec);
+
+    if (!in.is_open() || ec || length == 0) {
+        return false;
+    }
+
+    // zsyncmake's choices: 2 KiB blocks below 100 MB, and hash lengths from the file size so
+    // false matches stay unlikely.
+    double size = static_cast<double>(length);
+    uint32_t block_size = length < 100000000 ? 2048 : 4096;
+    int seq_matches = length > block_size ? 2 : 1;
+    int rsum_bytes = std::clamp(static_cast<int>(std::ceil(((std::log(size) + std::log(static_cast<double>(block_size))) /
+        std::log(2.0) - 8.6) / seq_matches / 8)), 2, 4);
+    int checksum_bytes = static_cast<int>(std::ceil((20 + (std::log(size) + std::log(1 + size / block_size)) / std::log(2.0)) / seq_matches / 8));
+
+    checksum_bytes = std::max(checksum_bytes, static_cast<int>((7.9 + (20 + std::log(1 + size / block_size) / std::log(2.0))) / 8));
+
+    std::vector<unsigned char> block(block_size);
+    std::string checksums;
+    sha1 whole;
+
+    for (uint64_t offset = 0; offset < length; offset += block_size) {
+        size_t take = static_cast<size_t>(std::min<uint64_t>(block_size, length - offset));
+        unsigned char digest[16];
+        uint16_t a = 0;
+        uint16_t b = 0;
+
+        std::fill(block.begin(), block.end(), 0);
+
+        if (!in.read(reinterpret_cast<char*>(block.data()), take)) {
+            return false;
+        }
+
+        whole.update(block.data(), take);
+        block_rsum(block.data(), block_size, a, b);
+        md4(block.data(), block_size, digest);
+
+        unsigned char rsum[4] = { static_cast<unsigned char>(a >> 8), static_cast<unsigned char>(a),
+            static_cast<unsigned char>(b >> 8), static_cast<unsigned char>(b) };
+
+        checksums.append(reinterpret_cast<const char*>(rsum + 4 - rsum_bytes), rsum_bytes);
+        checksums.append(reinterpret_cast<const char*>(digest), checksum_bytes);
+    }
+
+    control = std::format("zsync: 0.6.2\nFilename: {}\nBlocksize: {}\nLength: {}\nHash-Lengths: {},{},{}\nURL: {}\nSHA-1: {}\n\n",
+        file.filename().string(), block_size, length, seq_matches, rsum_bytes, checksum_bytes, url, whole.finish()) + checksums;
+
+    return true;
+}
+
+lcl_zsync_client::lcl_zsync_client(std::string control_url, std::string url, std::filesystem::path seed, std::filesystem::path target,
+    const lcl_download_options& options, const std::atomic<bool>& cancel)
+    : _control_url(std::move(control_url)), _url(std::move(url)), _seed(std::move(seed)), _target(std::move(target)),
+      _options(options), _cancel(cancel), _length(0), _block_size(0), _blocks(0), _seq_matches(1), _rsum_bytes(4),
+      _checksum_bytes(16), _a_mask(0xFFFF), _filter_bits(16), _known_count(0) {
+    _part_path = _target;
+    _part_path += ".zsync-part";
+}
+
+void lcl_zsync_client::expect_sha256(const std::string& digest) {
+    _expected_sha256 = lcl_sha256::from_digest(digest);
+}
+
+bool lcl_zsync_client::fail(std::string error) {
+    if (_error.empty()) {
+        _error = std::move(error);
+    }
+
+    return false;
+}
+
+bool lcl_zsync_client::fetch_control(CURL* curl, CURLcode& res) {
+    struct curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "User-Agent: curl/7.88.1");
+
+    _control.clear();
+
+    curl_easy_setopt(curl, CURLOPT_URL, _control_url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXFILESIZE_LARGE, static_cast<curl_off_t>(MAX_CONTROL_SIZE));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, append_control);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &_control);
+    lcl_apply_transfer_limits(curl, _options, _cancel);
+
+    res = lcl_net::instance().perform(curl, "zsync");
+
+    curl_slist_free_all(headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 0L);
+    curl_easy_setopt(curl, CURLOPT_MAXFILESIZE_LARGE, static_cast<curl_off_t>(0));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, nullptr);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
+
+    return res == CURLE_OK || fail(std::string("could not fetch the control file: ") + curl_easy_strerror(res));
+}
+
+// "Key: value" lines up to an empty one, then the checksums of every block.
+bool lcl_zsync_client::parse_control() {
+    size_t position = 0;
+    bool plain_url = false;
+    bool compressed_url = false;
+
+    for (;;) {
+        size_t end = _control.find('\n', position);
+
+        if (end == std::string::npos) {
+            return fail("truncated control file");
+        }
+
+        std::string line = _control.substr(position, end - position);
+        position = end + 1;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line.empty()) {
+            break;
+        }
+
+        size_t colon = line.find(':');
+
+        if (colon == std::string::npos) {
+            return fail("malformed control file");
+        }
+
+        std::string key = line.substr(0, colon);
+        std::string value = line.substr(colon + 1);
+
+        value.erase(0, value.find_first_not_of(' '));
+
+        if (key == "Blocksize") {
+            _block_size = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        } else if (key == "Length") {
+            _length = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "Hash-Lengths") {
+            if (std::sscanf(value.c_str(), "%u,%u,%u", &_seq_matches, &_rsum_bytes, &_checksum_bytes) != 3) {
+                return fail("malformed Hash-Lengths");
+            }
+        } else if (key == "SHA-1") {
+            _sha1 = value;
+            std::transform(_sha1.begin(), _sha1.end(), _sha1.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        } else if (key == "URL") {
+            plain_url = true;
+        } else if (key == "Z-URL") {
+            compressed_url = true;
+        }
+    }
+
+    // Blocks of a recompressed (gzip) target don't line up with the asset, the full download is as good.
+    if (compressed_url && !plain_url) {
+        return fail("only a compressed target is published");
+    }
+
+    if (_block_size < 256 || _block_size > 16 * 1024 * 1024 || (_block_size & (_block_size - 1)) != 0 || _length == 0 ||
+        _seq_matches < 1 || _seq_matches > 2 || _rsum_bytes < 2 || _rsum_bytes > 4 || _checksum_bytes < 3 ||
+        _checksum_bytes > 16 || _sha1.size() != 40) {
+        return fail("unsupported control file");
+    }
+
+    uint64_t blocks = (_length + _block_size - 1) / _block_size;
+    size_t record = _rsum_bytes + _checksum_bytes;
+
+    if (blocks > 0xFFFFFFFFULL || (_control.size() - position) / record < blocks) {
+        return fail("truncated block checksums");
+    }
+
+    _blocks = static_cast<uint32_t>(blocks);
+    _a_mask = _rsum_bytes < 3 ? 0 : _rsum_bytes == 3 ? 0xFF : 0xFFFF;
+    _rsums.resize(_blocks);
+    _checksums.resize(static_cast<size_t>(_blocks) * _checksum_bytes);
+
+    // The trailing rsum_bytes of a (big endian) then b, the leading checksum_bytes of the MD4.
+    for (uint32_t i = 0; i < _blocks; i++) {
+        const auto* data = reinterpret_cast<const unsigned char*>(_control.data() + position + static_cast<size_t>(i) * record);
+        unsigned char rsum[4] = {};
+
+        std::memcpy(rsum + 4 - _rsum_bytes, data, _rsum_bytes);
+        _rsums[i] = { static_cast<uint16_t>((rsum[0] << 8) | rsum[1]), static_cast<uint16_t>((rsum[2] << 8) | rsum[3]) };
+        std::memcpy(_checksums.data() + static_cast<size_t>(i) * _checksum_bytes, data + _rsum_bytes, _checksum_bytes);
+    }
+
+    _control.clear();
+    _control.shrink_to_fit();
+
+    return true;
+}
+
+// With two sequential matches the key covers a pair of blocks, which keeps short rsums selective.
+uint64_t lcl_zsync_client::block_key(_rsum first, _rsum second) const {
+    uint64_t key = (static_cast<uint64_t>(first.a & _a_mask) << 16) | first.b;
+
+    if (_seq_matches > 1) {
+        key = (key << 32) | (static_cast<uint64_t>(second.a & _a_mask) << 16) | second.b;
+    }
+
+    return key;
+}
+
+static uint64_t filter_slot(uint64_t key, size_t bits) {
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+}
+
+void lcl_zsync_client::index_blocks() {
+    uint32_t last = _seq_matches > 1 ? _blocks - 1 : _blocks;
+
+    _filter_bits = 16;
+
+    while (_filter_bits < 26 && (size_t(1) << _filter_bits) < static_cast<size_t>(_blocks) * 16) {
+        _filter_bits++;
+    }
+
+    _index.clear();
+    _filter.assign((size_t(1) << _filter_bits) / 64, 0);
+    _known.assign(_blocks, false);
+    _known_count = 0;
+
+    for (uint32_t i = 0; i < last; i++) {
+        uint64_t key = block_key(_rsums[i], i + 1 < _blocks ? _rsums[i + 1] : _rsum{});
+        uint64_t slot = filter_slot(key, _filter_bits);
+
+        _index.emplace_back(key, i);
+        _filter[slot / 64] |= uint64_t(1) << (slot % 64);
+    }
+
+    std::sort(_index.begin(), _index.end());
+}
+
+bool lcl_zsync_client::write_block(FILE* output, uint32_t block, const unsigned char* data) {
+    uint64_t offset = static_cast<uint64_t>(block) * _block_size;
+    size_t size = static_cast<size_t>(std::min<uint64_t>(_block_size, _length - offset));
+
+    if (_known[block]) {
+        return true;
+    }
+
+    if (!lcl_seek_file(output, offset) || fwrite(data, 1, size, output) != size) {
+        return fail("could not write " + _part_path.string());
+    }
+
+    _known[block] = true;
+    _known_count++;
+
+    return true;
+}
+
+// Blocks whose key matches the window are confirmed by their MD4, a window can hold several
+// identical blocks of the target (padding, zeroes) and fills all of them.
+bool lcl_zsync_client::match(const unsigned char* window, FILE* output) {
+    uint16_t a0, b0, a1 = 0, b1 = 0;
+
+    block_rsum(window, _block_size, a0, b0);
+
+    if (_seq_matches > 1) {
+        block_rsum(window + _block_size, _block_size, a1, b1);
+    }
+
+    uint64_t key = block_key({ a0, b0 }, { a1, b1 });
+    auto found = std::equal_range(_index.begin(), _index.end(), std::make_pair(key, uint32_t(0)),
+        [](const auto& left, const auto& right) { return left.first < right.first; });
+    unsigned char first[16];
+    unsigned char second[16];
+    bool matched = false;
+
+    if (found.first == found.second) {
+        return false;
+    }
+
+    md4(window, _block_size, first);
+
+    if (_seq_matches > 1) {
+        md4(window + _block_size, _block_size, second);
+    }
+
+    for (auto it = found.first; it != found.second; ++it) {
+        uint32_t block = it->second;
+
+        if (std::memcmp(first, _checksums.data() + static_cast<size_t>(block) * _checksum_bytes, _checksum_bytes) != 0 ||
+            (_seq_matches > 1 && std::memcmp(second, _checksums.data() + static_cast<size_t>(block + 1) * _checksum_bytes, _checksum_bytes) != 0)) {
+            continue;
+        }
+
+        if (!write_block(output, block, window) || (_seq_matches > 1 && !write_block(output, block + 1, window + _block_size))) {
+            return false;
+        }
+
+        matched = true;
+    }
+
+    return matched;
+}
+
+// One pass over the installed file. The rolling checksums advance a byte at a time and jump a
+// whole block after a match, as zsync does; the bit filter keeps the lookup off most offsets.
+bool lcl_zsync_client::scan_seed(FILE* output) {
+    std::ifstream in(_seed, std::ios::binary);
+    size_t window = static_cast<size_t>(_block_size) * _seq_matches;
+    std::vector<unsigned char> buffer(SEED_CHUNK + window + 1);
+    size_t filled = 0;
+    size_t p = 0;
+    bool eof = false;
+    bool fresh = true;
+    uint16_t a0 = 0, b0 = 0, a1 = 0, b1 = 0;
+
+    if (!in.is_open()) {
+        return fail("could not open " + _seed.string());
+    }
+
+    for (;;) {
+        if (filled - p < window + 1 && !eof) {
+            std::memmove(buffer.data(), buffer.data() + p, filled - p);
+            filled -= p;
+            p = 0;
+
+            in.read(reinterpret_cast<char*>(buffer.data() + filled), static_cast<std::streamsize>(buffer.size() - filled));
+            filled += static_cast<size_t>(in.gcount());
+            eof = in.gcount() == 0 || in.eof();
+
+            if (_cancel.load()) {
+                return fail("cancelled");
+            }
+
+            continue;
+        }
+
+        if (filled - p < window) {
+            break;
+        }
+
+        const unsigned char* data = buffer.data() + p;
+
+        if (fresh) {
+            block_rsum(data, _block_size, a0, b0);
+
+            if (_seq_matches > 1) {
+                block_rsum(data + _block_size, _block_size, a1, b1);
+            }
+
+            fresh = false;
+        }
+
+        uint64_t slot = filter_slot(block_key({ a0, b0 }, { a1, b1 }), _filter_bits);
+
+        if ((_filter[slot / 64] >> (slot % 64) & 1) != 0 && match(data, output)) {
+            p += _block_size;
+            fresh = true;
+            continue;
+        }
+
+        if (!_error.empty()) {
+            return false;
+        }
+
+        if (filled - p == window) {
+            break;
+        }
+
+        roll_rsum(a0, b0, data[0], data[_block_size], _block_size);
+
+        if (_seq_matches > 1) {
+            roll_rsum(a1, b1, data[_block_size], data[window], _block_size);
+        }
+
+        p++;
+    }
+
+    return true;
+}
+
+// Byte ranges of the blocks still unknown, merged until the request count is bounded.
+std::vector<std::pair<uint64_t, uint64_t>> lcl_zsync_client::missing_ranges() const {
+    std::vector<std::pair<uint64_t, uint64_t>> blocks;
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+    for (uint32_t i = 0; i < _blocks; i++) {
+        if (_known[i]) {
+            continue;
+        }
+
+        uint64_t first = static_cast<uint64_t>(i) * _block_size;
+        uint64_t last = std::min<uint64_t>(first + _block_size, _length);
+
+        if (!blocks.empty() && blocks.back().second == first) {
+            blocks.back().second = last;
+        } else {
+            blocks.emplace_back(first, last);
+        }
+    }
+
+    for (uint64_t gap = MERGE_GAP; ; gap *= 2) {
+        ranges.clear();
+
+        for (const auto& range : blocks) {
+            if (!ranges.empty() && range.first - ranges.back().second <= gap) {
+                ranges.back().second = range.second;
+            } else {
+                ranges.push_back(range);
+            }
+        }
+
+        if (ranges.size() <= MAX_REQUESTS) {
+            return ranges;
+        }
+    }
+}
+
+bool lcl_zsync_client::verify() {
+    std::ifstream in(_part_path, std::ios::binary);
+    std::vector<char> buffer(1024 * 1024);
+    lcl_sha256 sha256;
+    sha1 digest;
+
+    while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || in.gcount() > 0) {
+        digest.update(reinterpret_cast<const unsigned char*>(buffer.data()), static_cast<size_t>(in.gcount()));
+
+        if (!_expected_sha256.empty()) {
+            sha256.update(buffer.data(), static_cast<size_t>(in.gcount()));
+        }
+    }
+
+    if (!in.eof()) {
+        return fail("could not read " + _part_path.string());
+    }
+
+    if (digest.finish() != _sha1) {
+        return fail("SHA-1 mismatch");
+    }
+
+    return _expected_sha256.empty() || sha256.finish() == _expected_sha256 || fail("SHA-256 mismatch");
+}
+
+bool lcl_zsync_client::run(CURL* curl, CURLcode& res) {
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::error_code ec;
+    uint64_t control_size = 0;
+    uint64_t needed = 0;
+
+    res = CURLE_OK;
+
+    if (!fetch_control(curl, res)) {
+        return false;
+    }
+
+    control_size = _control.size();
+
+    if (!parse_control()) {
+        return false;
+    }
+
+    index_blocks();
+
+    std::filesystem::remove(_part_path, ec);
+    FILE* output = fopen(_part_path.string().c_str(), "w+b");
+    bool ok = output != nullptr || fail("could not create " + _part_path.string());
+
+    ok = ok && scan_seed(output);
+
+    if (ok) {
+        ranges = missing_ranges();
+
+        for (const auto& [first, last] : ranges) {
+            needed += last - first;
+        }
+
+        // Past this point the segmented download of the whole file is the faster way.
+        if (needed > _length / 4 * 3) {
+            ok = fail(std::format("only {} of {} blocks are in the installed file", _known_count, _blocks));
+        }
+    }
+
+    lcl_range_fetcher fetcher(_url, output, _options, _cancel);
+
+    fetcher.expect_size(_length);
+
+    for (size_t i = 0; ok && i < ranges.size(); i++) {
+        ok = fetcher.fetch(curl, res, ranges[i].first, ranges[i].second) ||
+            fail(std::string("range request failed: ") + curl_easy_strerror(res));
+    }
+
+    if (output) {
+        ok = fclose(output) == 0 && ok;
+    }
+
+    if (ok) {
+        std::filesystem::resize_file(_part_path, _length, ec);
+        ok = verify();
+    }
+
+    if (ok) {
+        std::filesystem::rename(_part_path, _target, ec);
+        ok = !ec || fail("could not replace " + _target.string() + ": " + ec.message());
+    }
+
+    if (!ok) {
+        std::filesystem::remove(_part_path, ec);
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    uint64_t transferred = control_size + fetcher.received();
+
+    log_cb(RETRO_LOG_INFO, "[LAUNCHER-INFO] zsync: %u of %u blocks reused from the installed file, %llu bytes transferred "
+        "instead of %llu (%.1f%%) in %u range requests, %.2f s.\n",
+        _known_count, _blocks, static_cast<unsigned long long>(transferred), static_cast<unsigned long long>(_length),
+        100.0 * transferred / _length, fetcher.requests(), seconds);
+
+    return true;
+}
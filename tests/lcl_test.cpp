@@ -0,0 +1,54 @@
+#include "lcl_test.hpp"
+#include "libretro.h"
+
+#include <cstdarg>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+bool lcl_test_failed = false;
+
+// Launcher messages go to stderr, ctest shows them next to a failed check.
+static void test_log(enum retro_log_level level, const char* fmt, ...) {
+    va_list args;
+
+    (void)level;
+    va_start(args, fmt);
+    std::vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+retro_log_printf_t log_cb = test_log;
+
+std::filesystem::path lcl_test_dir(const std::string& name) {
+    std::error_code ec;
+    auto dir = std::filesystem::absolute(std::filesystem::path("lcl_test") / name, ec);
+
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+
+    return dir;
+}
+
+std::string lcl_test_read(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void lcl_test_write(const std::filesystem::path& path, const std::string& content) {
+    std::error_code ec;
+
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+std::string lcl_test_file_url(const std::filesystem::path& path) {
+    std::string url = "file://";
+
+#ifdef _WIN32
+    url += "/";
+#endif
+
+    return url + path.generic_string();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// Shared helpers of the launcher tests. Every test is one executable, a failed check is printed
+// and makes main() return non zero once the rest of the checks ran.
+
+#define LCL_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			lcl_test_failed = true; \
+		} \
+	} while (0)
+
+extern bool lcl_test_failed;
+
+// Empty scratch directory of one test under the working directory, recreated on every run.
+std::filesystem::path lcl_test_dir(const std::string& name);
+
+std::string lcl_test_read(const std::filesystem::path& path);
+void lcl_test_write(const std::filesystem::path& path, const std::string& content);
+
+// file:// url of a local path.
+std::string lcl_test_file_url(const std::filesystem::path& path);
@@ -0,0 +1,203 @@
+#include "lcl_test_server.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define LCL_INVALID_SOCKET INVALID_SOCKET
+#define lcl_close_socket closesocket
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int socket_t;
+#define LCL_INVALID_SOCKET (-1)
+#define lcl_close_socket close
+#endif
+
+static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+// Polled with a short timeout so the destructor can stop the server, also while a client keeps a
+// connection open without sending anything.
+static bool wait_readable(socket_t socket, const std::atomic<bool>& stop) {
+    while (!stop.load()) {
+        fd_set readable;
+        timeval timeout{ 0, 50000 };
+
+        FD_ZERO(&readable);
+        FD_SET(socket, &readable);
+
+        if (select(static_cast<int>(socket) + 1, &readable, nullptr, nullptr, &timeout) > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const char* reason(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 206: return "Partial Content";
+    case 304: return "Not Modified";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 429: return "Too Many Requests";
+    default: return status >= 500 ? "Server Error" : "Status";
+    }
+}
+
+lcl_test_server::lcl_test_server(handler on_request)
+    : _on_request(std::move(on_request)), _listener(-1), _port(0), _stop(false) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+
+    socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    if (listener == LCL_INVALID_SOCKET ||
+        bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 16) != 0 ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        std::abort();
+    }
+
+    _listener = static_cast<long long>(listener);
+    _port = ntohs(address.sin_port);
+    _thread = std::thread(&lcl_test_server::serve, this);
+}
+
+lcl_test_server::~lcl_test_server() {
+    _stop = true;
+    _thread.join();
+    lcl_close_socket(static_cast<socket_t>(_listener));
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+std::string lcl_test_server::url(const std::string& path) const {
+    return "http://127.0.0.1:" + std::to_string(_port) + path;
+}
+
+std::vector<lcl_test_request> lcl_test_server::requests() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _requests;
+}
+
+void lcl_test_server::serve() {
+    socket_t listener = static_cast<socket_t>(_listener);
+
+    while (wait_readable(listener, _stop)) {
+        socket_t client = accept(listener, nullptr, nullptr);
+
+        if (client != LCL_INVALID_SOCKET) {
+            answer(static_cast<long long>(client));
+            lcl_close_socket(client);
+        }
+    }
+}
+
+void lcl_test_server::answer(long long client_handle) {
+    socket_t client = static_cast<socket_t>(client_handle);
+    lcl_test_request request;
+    std::string data;
+    char buffer[4096];
+    size_t header_end = std::string::npos;
+
+    while (header_end == std::string::npos) {
+        int received = wait_readable(client, _stop) ? recv(client, buffer, sizeof(buffer), 0) : 0;
+
+        if (received <= 0) {
+            return;
+        }
+
+        data.append(buffer, received);
+        header_end = data.find("\r\n\r\n");
+    }
+
+    // "GET /path HTTP/1.1", then one "Name: value" per line.
+    size_t line_end = data.find("\r\n");
+    std::string request_line = data.substr(0, line_end);
+    size_t first_space = request_line.find(' ');
+    size_t second_space = request_line.find(' ', first_space + 1);
+
+    request.method = request_line.substr(0, first_space);
+    request.path = request_line.substr(first_space + 1, second_space - first_space - 1);
+
+    for (size_t start = line_end + 2; start < header_end;) {
+        size_t end = data.find("\r\n", start);
+        std::string line = data.substr(start, end - start);
+        size_t colon = line.find(':');
+
+        if (colon != std::string::npos) {
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            request.headers[lowercase(line.substr(0, colon))] = value == std::string::npos ? "" : line.substr(value);
+        }
+
+        start = end + 2;
+    }
+
+    size_t body_size = request.headers.count("content-length") ? std::strtoull(request.headers["content-length"].c_str(), nullptr, 10) : 0;
+
+    request.body = data.substr(header_end + 4);
+
+    while (request.body.size() < body_size) {
+        int received = wait_readable(client, _stop) ? recv(client, buffer, sizeof(buffer), 0) : 0;
+
+        if (received <= 0) {
+            break;
+        }
+
+        request.body.append(buffer, received);
+    }
+
+    lcl_test_response response = _on_request(request);
+
+    // Recorded before answering: the client may look at requests() as soon as it has the response.
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _requests.push_back(request);
+    }
+
+    std::string head = "HTTP/1.1 " + std::to_string(response.status) + " " + reason(response.status) + "\r\n";
+
+    for (const auto& [name, value] : response.headers) {
+        head += name + ": " + value + "\r\n";
+    }
+
+    head += "Content-Length: " + std::to_string(response.body.size()) + "\r\nConnection: close\r\n\r\n";
+
+    // A HEAD answer announces the body without sending it.
+    std::string out = request.method == "HEAD" ? head : head + response.body;
+
+    for (size_t sent = 0; sent < out.size();) {
+        int count = send(client, out.data() + sent, static_cast<int>(out.size() - sent), 0);
+
+        if (count <= 0) {
+            break;
+        }
+
+        sent += count;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local HTTP stand-in for GitHub and asset hosts. Listens on 127.0.0.1 at a free port and answers
+// every request, one at a time and with Connection: close, with what the handler returns.
+struct lcl_test_request {
+	std::string method;
+	std::string path;
+	std::map<std::string, std::string> headers;  // names in lowercase
+	std::string body;
+};
+
+struct lcl_test_response {
+	int status = 200;
+	std::vector<std::pair<std::string, std::string>> headers;
+	std::string body;
+};
+
+class lcl_test_server {
+public:
+	using handler = std::function<lcl_test_response(const lcl_test_request&)>;
+
+	explicit lcl_test_server(handler on_request);
+	~lcl_test_server();
+
+	lcl_test_server(const lcl_test_server&) = delete;
+	lcl_test_server& operator=(const lcl_test_server&) = delete;
+
+	// "http://127.0.0.1:<port>" followed by path.
+	std::string url(const std::string& path) const;
+
+	// Requests answered so far.
+	std::vector<lcl_test_request> requests();
+
+private:
+	void serve();
+	void answer(long long client);
+
+	handler _on_request;
+	long long _listener;
+	int _port;
+	std::atomic<bool> _stop;
+	std::mutex _lock;
+	std::vector<lcl_test_request> _requests;
+	std::thread _thread;
+};
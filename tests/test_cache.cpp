@@ -0,0 +1,63 @@
+#include "lcl_test.hpp"
+#include "lcl_cache.hpp"
+#include "lcl_sha256.hpp"
+
+#include <string>
+#include <system_error>
+
+// An archive the index lost track of counts toward the cap and goes first.
+static void orphans_are_evicted() {
+    auto dir = lcl_test_dir("cache_orphans");
+    auto root = dir / "LCL.cache";
+    auto download = dir / "emulator.zip";
+    auto target = dir / "installed.zip";
+    std::string orphan_hash;
+    std::string download_hash;
+    std::error_code ec;
+
+    lcl_test_write(dir / "orphan", std::string(800, 'o'));
+    lcl_sha256::file((dir / "orphan").string(), orphan_hash);
+    std::filesystem::create_directories(root, ec);
+    std::filesystem::rename(dir / "orphan", root / orphan_hash, ec);
+    lcl_test_write(root / "index.json.tmp", "{");
+
+    lcl_test_write(download, std::string(400, 'd'));
+    lcl_sha256::file(download.string(), download_hash);
+
+    lcl_archive_cache cache(root, 1000);
+
+    LCL_CHECK(cache.store(download, "", "https://example.invalid/emulator.zip"));
+    LCL_CHECK(!std::filesystem::exists(root / orphan_hash, ec));
+    LCL_CHECK(std::filesystem::exists(root / download_hash, ec));
+    LCL_CHECK(!std::filesystem::exists(root / "index.json.tmp", ec));
+    LCL_CHECK(lcl_test_read(root / "index.json").find(orphan_hash) == std::string::npos);
+
+    LCL_CHECK(cache.fetch("", "https://example.invalid/emulator.zip", target));
+    LCL_CHECK(lcl_test_read(target) == std::string(400, 'd'));
+}
+
+// Found again after the index is gone, by digest.
+static void lost_index_is_rebuilt() {
+    auto dir = lcl_test_dir("cache_index");
+    auto root = dir / "LCL.cache";
+    auto download = dir / "emulator.zip";
+    std::string hash;
+    std::error_code ec;
+
+    lcl_test_write(download, "emulator");
+    lcl_sha256::file(download.string(), hash);
+
+    lcl_archive_cache cache(root, 1000);
+
+    LCL_CHECK(cache.store(download, "sha256:" + hash, ""));
+    std::filesystem::remove(root / "index.json", ec);
+    LCL_CHECK(cache.fetch("sha256:" + hash, "", dir / "again.zip"));
+    LCL_CHECK(lcl_test_read(dir / "again.zip") == "emulator");
+}
+
+int main() {
+    orphans_are_evicted();
+    lost_index_is_rebuilt();
+
+    return lcl_test_failed ? 1 : 0;
+}
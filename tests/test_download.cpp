@@ -0,0 +1,52 @@
+#include "lcl_test.hpp"
+#include "lcl_download.hpp"
+
+#include <atomic>
+#include <system_error>
+
+#include "curl/curl.h"
+
+// PROVIDER=file: assets are file:// urls. There is no HTTP status to probe, the downloader has to
+// read them in a single stream instead of retrying until it gives up.
+static void file_url_installs() {
+    auto dir = lcl_test_dir("download_file");
+    auto source = dir / "source" / "emulator.zip";
+    auto target = dir / "system" / "emulator.zip";
+    std::string content;
+    std::atomic<bool> cancel(false);
+    lcl_download_options options;
+    std::error_code ec;
+    CURLcode res = CURLE_OK;
+
+    for (int i = 0; i < 300000; i++) {
+        content += static_cast<char>('a' + i % 23);
+    }
+
+    lcl_test_write(source, content);
+    std::filesystem::create_directories(target.parent_path(), ec);
+    options.retries = 1;
+
+    CURL* curl = curl_easy_init();
+    lcl_downloader downloader(lcl_test_file_url(source), target.string(), options, cancel);
+
+    LCL_CHECK(downloader.run(curl, res));
+    LCL_CHECK(res == CURLE_OK);
+    LCL_CHECK(lcl_test_read(target) == content);
+    LCL_CHECK(!std::filesystem::exists(target.string() + ".part", ec));
+
+    // A missing file fails right away.
+    lcl_downloader missing(lcl_test_file_url(dir / "source" / "missing.zip"), (dir / "system" / "missing.zip").string(), options, cancel);
+
+    LCL_CHECK(!missing.run(curl, res));
+    LCL_CHECK(!std::filesystem::exists(dir / "system" / "missing.zip", ec));
+
+    curl_easy_cleanup(curl);
+}
+
+int main() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    file_url_installs();
+    curl_global_cleanup();
+
+    return lcl_test_failed ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+#include "lcl_test.hpp"
+#include "lcl_extract.hpp"
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "libdeflate.h"
+
+// Stored zip entry made on Unix, the mode goes into the upper half of the external attributes.
+struct zip_entry {
+    std::string name;
+    std::string data;
+    uint32_t mode;
+};
+
+static void put16(std::string& out, uint32_t value) {
+    out += static_cast<char>(value & 0xff);
+    out += static_cast<char>((value >> 8) & 0xff);
+}
+
+static void put32(std::string& out, uint32_t value) {
+    put16(out, value & 0xffff);
+    put16(out, value >> 16);
+}
+
+static std::string make_zip(const std::vector<zip_entry>& entries) {
+    std::string local;
+    std::string central;
+
+    for (const auto& entry : entries) {
+        uint32_t crc = libdeflate_crc32(0, entry.data.data(), entry.data.size());
+        uint32_t offset = static_cast<uint32_t>(local.size());
+        uint32_t size = static_cast<uint32_t>(entry.data.size());
+
+        put32(local, 0x04034b50);
+        for (uint32_t value : { 20u, 0u, 0u, 0u, 0x21u }) put16(local, value);
+        for (uint32_t value : { crc, size, size }) put32(local, value);
+        put16(local, static_cast<uint32_t>(entry.name.size()));
+        put16(local, 0);
+        local += entry.name + entry.data;
+
+        put32(central, 0x02014b50);
+        for (uint32_t value : { (3u << 8) | 20u, 20u, 0u, 0u, 0u, 0x21u }) put16(central, value);
+        for (uint32_t value : { crc, size, size }) put32(central, value);
+        put16(central, static_cast<uint32_t>(entry.name.size()));
+        for (uint32_t value : { 0u, 0u, 0u, 0u }) put16(central, value);
+        put32(central, entry.mode << 16);
+        put32(central, offset);
+        central += entry.name;
+    }
+
+    std::string end;
+
+    put32(end, 0x06054b50);
+    for (uint32_t value : { 0u, 0u, static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size()) }) put16(end, value);
+    put32(end, static_cast<uint32_t>(central.size()));
+    put32(end, static_cast<uint32_t>(local.size()));
+    put16(end, 0);
+
+    return local + central + end;
+}
+
+static bool extract(const std::string& name, const std::vector<zip_entry>& entries, std::filesystem::path& target) {
+    auto dir = lcl_test_dir(name);
+    auto archive = dir / "core.zip";
+
+    target = dir / "install";
+    lcl_test_write(archive, make_zip(entries));
+
+    lcl_zip_extractor extractor(archive, target);
+
+    return extractor.run();
+}
+
+// Fed through the ring the way a download does, then moved into place like lcl_stream_install().
+static bool stream(const std::string& name, const std::vector<zip_entry>& entries, std::filesystem::path& target) {
+    auto dir = lcl_test_dir(name);
+    std::string archive = make_zip(entries);
+    lcl_ring_buffer ring(archive.size());
+    lcl_zip_stream zip(ring, dir / "extract");
+    std::string error;
+
+    target = dir / "install";
+    ring.write(archive.data(), archive.size());
+    ring.close();
+
+    return zip.run() && lcl_move_extracted(dir / "extract", target, error);
+}
+
+int main() {
+    std::filesystem::path relative;
+    std::filesystem::path target;
+    std::error_code ec;
+
+    // Resolved from the folder of the link.
+    LCL_CHECK(lcl_safe_link_target("../lib/libfoo.so.1", "bin/foo", relative));
+    LCL_CHECK(relative == "../lib/libfoo.so.1");
+    LCL_CHECK(lcl_safe_link_target("libfoo.so.1", "lib/libfoo.so", relative));
+    LCL_CHECK(lcl_safe_link_target("..", "bin/root", relative));
+    LCL_CHECK(lcl_safe_link_target("..\\lib\\foo", "bin/foo", relative));
+    LCL_CHECK(relative == "../lib/foo");
+
+    // Out of the install, absolute, or only inside once an inner "dir/.." is taken literally.
+    LCL_CHECK(!lcl_safe_link_target("../lib/foo", "foo", relative));
+    LCL_CHECK(!lcl_safe_link_target("../../etc/passwd", "bin/foo", relative));
+    LCL_CHECK(!lcl_safe_link_target("/usr/lib/foo", "bin/foo", relative));
+    LCL_CHECK(!lcl_safe_link_target("C:/Windows", "bin/foo", relative));
+    LCL_CHECK(!lcl_safe_link_target("lib/../../..", "bin/foo", relative));
+    LCL_CHECK(!lcl_safe_link_target("", "bin/foo", relative));
+
+#ifndef _WIN32
+    // An AppImage style layout installs with its links pointing across folders.
+    LCL_CHECK(extract("extract_links", {
+        { "lib/libfoo.so.1", "library", 0100644 },
+        { "lib/libfoo.so", "libfoo.so.1", 0120777 },
+        { "bin/foo", "../lib/libfoo.so.1", 0120777 }
+    }, target));
+    LCL_CHECK(std::filesystem::read_symlink(target / "bin/foo", ec) == "../lib/libfoo.so.1");
+    LCL_CHECK(lcl_test_read(target / "bin/foo") == "library");
+    LCL_CHECK(lcl_test_read(target / "lib/libfoo.so") == "library");
+
+    // One link leaving the install fails it.
+    LCL_CHECK(!extract("extract_escape", {
+        { "lib/libfoo.so.1", "library", 0100644 },
+        { "bin/foo", "../../outside", 0120777 }
+    }, target));
+    LCL_CHECK(!std::filesystem::exists(std::filesystem::symlink_status(target / "bin/foo", ec)));
+
+    // Each link stays inside on its own, together they climb out: sub/e/f would resolve to sub/e/..
+    // through the link sub/e, one above the install.
+    LCL_CHECK(!extract("extract_chain", {
+        { "sub/e", "..", 0120777 },
+        { "sub/e/f", "..", 0120777 }
+    }, target));
+    LCL_CHECK(!std::filesystem::is_symlink(std::filesystem::symlink_status(target / "sub/e/f", ec)));
+
+    // Nor is anything written through a link already in the install.
+    {
+        auto dir = lcl_test_dir("extract_existing_link");
+        auto outside = dir / "outside";
+
+        target = dir / "install";
+        std::filesystem::create_directories(outside, ec);
+        std::filesystem::create_directories(target, ec);
+        std::filesystem::create_directory_symlink(outside, target / "lib", ec);
+        lcl_test_write(dir / "core.zip", make_zip({
+            { "bin/emu", "#!/bin/sh\n", 0100755 },
+            { "lib/libfoo.so.1", "library", 0100644 }
+        }));
+
+        lcl_zip_extractor extractor(dir / "core.zip", target);
+
+        LCL_CHECK(!extractor.run());
+        LCL_CHECK(!std::filesystem::exists(outside / "libfoo.so.1", ec));
+    }
+
+    // Streamed installs only learn modes and links from the central directory, past every entry.
+    LCL_CHECK(stream("stream_links", {
+        { "emu-1.0/", "", 040755 },
+        { "emu-1.0/lib/libfoo.so.1", "library", 0100644 },
+        { "emu-1.0/bin/emu", "#!/bin/sh\n", 0100755 },
+        { "emu-1.0/bin/foo", "../lib/libfoo.so.1", 0120777 }
+    }, target));
+    LCL_CHECK(std::filesystem::is_symlink(std::filesystem::symlink_status(target / "bin/foo", ec)));
+    LCL_CHECK(lcl_test_read(target / "bin/foo") == "library");
+    LCL_CHECK((std::filesystem::status(target / "bin/emu", ec).permissions() & std::filesystem::perms::owner_exec) != std::filesystem::perms::none);
+    LCL_CHECK((std::filesystem::status(target / "lib/libfoo.so.1", ec).permissions() & std::filesystem::perms::owner_exec) == std::filesystem::perms::none);
+
+    // Inside the folder that is dropped, outside the install once it is.
+    LCL_CHECK(!stream("stream_escape", {
+        { "emu-1.0/bin/emu", "#!/bin/sh\n", 0100755 },
+        { "emu-1.0/bin/up", "../../emu-1.0/bin/emu", 0120777 }
+    }, target));
+#endif
+
+    return lcl_test_failed ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+#include "lcl_test.hpp"
+#include "lcl_test_server.hpp"
+#include "lcl_net.hpp"
+
+#include "curl/curl.h"
+
+// Pre-warming is one HEAD to the url it is given, its answer is not rate limit bookkeeping.
+int main() {
+    auto dir = lcl_test_dir("prewarm");
+    long long wait_seconds = 0;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    lcl_net::instance().load(dir, dir / "NetStats.log", 0, false);
+
+    {
+        lcl_test_server github([](const lcl_test_request&) {
+            lcl_test_response response;
+
+            response.status = 403;
+            response.headers = { { "x-ratelimit-remaining", "0" }, { "x-ratelimit-reset", "4102444800" } };
+            return response;
+        });
+
+        lcl_net::instance().prewarm(github.url("/rate_limit"));
+        lcl_net::instance().wait_prewarm();
+
+        auto requests = github.requests();
+
+        LCL_CHECK(requests.size() == 1);
+        LCL_CHECK(!requests.empty() && requests[0].method == "HEAD" && requests[0].path == "/rate_limit");
+        LCL_CHECK(!requests.empty() && !requests[0].headers.count("authorization"));
+        LCL_CHECK(lcl_net::instance().rate_limit_allows("core", wait_seconds));
+    }
+
+    lcl_net::instance().cleanup();
+    curl_global_cleanup();
+
+    return lcl_test_failed ? 1 : 0;
+}
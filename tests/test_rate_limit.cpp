@@ -0,0 +1,100 @@
+#include "lcl_test.hpp"
+#include "lcl_test_server.hpp"
+#include "lcl_net.hpp"
+
+#include <chrono>
+#include <string>
+
+#include "curl/curl.h"
+
+static long long unix_now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// One GET through the shared handles, the answer is fed to the rate limit bookkeeping like the
+// release lookups do.
+static long request(const std::string& resource, const std::string& url) {
+    CURL* curl = lcl_net::instance().easy();
+    lcl_http_headers headers;
+    long code = 0;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, lcl_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
+
+    lcl_net::instance().perform(curl, "test");
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    curl_easy_cleanup(curl);
+
+    lcl_net::instance().rate_limit_update(resource, code, headers);
+
+    return code;
+}
+
+int main() {
+    auto dir = lcl_test_dir("rate_limit");
+    long long wait_seconds = 0;
+    long long reset = unix_now() + 600;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    lcl_net::instance().load(dir, dir / "NetStats.log", 0, false);
+
+    {
+        lcl_test_server github([reset](const lcl_test_request& request) {
+            lcl_test_response response;
+
+            if (request.path == "/exhausted") {
+                response.status = 403;
+                response.headers = { { "x-ratelimit-remaining", "0" }, { "x-ratelimit-reset", std::to_string(reset) } };
+            } else if (request.path == "/throttled") {
+                response.status = 429;
+                response.headers = { { "retry-after", "30" } };
+            } else {
+                response.headers = { { "x-ratelimit-remaining", "59" }, { "x-ratelimit-reset", std::to_string(reset) } };
+            }
+
+            return response;
+        });
+
+        // Nothing known yet.
+        LCL_CHECK(lcl_net::instance().rate_limit_allows("core", wait_seconds));
+
+        // Answered with quota left.
+        LCL_CHECK(request("core", github.url("/ok")) == 200);
+        LCL_CHECK(lcl_net::instance().rate_limit_allows("core", wait_seconds));
+        LCL_CHECK(wait_seconds == 0);
+
+        // Quota used up: no request before the reset, plus some jitter.
+        LCL_CHECK(request("core", github.url("/exhausted")) == 403);
+        LCL_CHECK(!lcl_net::instance().rate_limit_allows("core", wait_seconds));
+        LCL_CHECK(wait_seconds >= 600 - 5 && wait_seconds <= 600 + 50);
+
+        // Secondary limit: retry-after is honoured, per resource.
+        LCL_CHECK(request("graphql", github.url("/throttled")) == 429);
+        LCL_CHECK(!lcl_net::instance().rate_limit_allows("graphql", wait_seconds));
+        LCL_CHECK(wait_seconds >= 30 && wait_seconds <= 40);
+        LCL_CHECK(!lcl_net::instance().rate_limit_allows("core", wait_seconds));
+
+        // Shared with the other cores through the state file.
+        LCL_CHECK(lcl_test_read(dir / "LCL.RateLimit.json").find("graphql") != std::string::npos);
+    }
+
+    // Nobody answers on port 1: a failed transport is no rate limit answer.
+    std::string unreachable = "http://127.0.0.1:1/";
+
+    LCL_CHECK(request("search", unreachable) == 0);
+    LCL_CHECK(lcl_net::instance().rate_limit_allows("search", wait_seconds));
+    LCL_CHECK(wait_seconds == 0);
+
+    // Nor does it lift a backoff already in place.
+    LCL_CHECK(request("graphql", unreachable) == 0);
+    LCL_CHECK(!lcl_net::instance().rate_limit_allows("graphql", wait_seconds));
+
+    lcl_net::instance().cleanup();
+    curl_global_cleanup();
+
+    return lcl_test_failed ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#include "lcl_test.hpp"
+#include "lcl_test_server.hpp"
+#include "lcl_release.hpp"
+
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "curl/curl.h"
+
+using json = nlohmann::json;
+
+static const std::string DIGEST = "sha256:2c26b46b68ffc68ff99b453c1d30413413422d706483bfa0f98a5e886266e7ae";
+
+static size_t write_response(char* data, size_t size, size_t count, void* userdata) {
+    static_cast<std::string*>(userdata)->append(data, size * count);
+    return size * count;
+}
+
+// Posts the batched query the way the launcher does and returns the response body.
+static long post(const std::string& url, const std::string& body, std::string& response) {
+    CURL* curl = curl_easy_init();
+    struct curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    long code = 0;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_response);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+
+    curl_easy_perform(curl);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    return code;
+}
+
+int main() {
+    std::vector<lcl_release_target> targets = {
+        { "azahar", "azahar-emu", "azahar", "linux" },
+        { "gone", "someone", "deleted", "linux" },
+        { "duckstation", "stenzek", "duckstation", "x64.AppImage" }
+    };
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // Stand-in for api.github.com/graphql: answers with the shape GitHub gives, a repository
+    // that does not exist is null next to an error, the others still come back.
+    lcl_test_server github([](const lcl_test_request& request) {
+        lcl_test_response response;
+        json body = json::parse(request.body, nullptr, false);
+
+        if (request.method != "POST" || body.is_discarded() || !body.contains("query")) {
+            response.status = 400;
+            return response;
+        }
+
+        response.body = json{
+            { "data", {
+                { "r0", { { "latestRelease", {
+                    { "tagName", "2123.1" },
+                    { "releaseAssets", { { "nodes", json::array({
+                        { { "databaseId", 11 }, { "name", "azahar-windows.zip" }, { "downloadUrl", "https://example/w.zip" }, { "digest", nullptr } },
+                        { { "databaseId", 12 }, { "name", "azahar-linux.AppImage" }, { "downloadUrl", "https://example/l.AppImage" }, { "digest", DIGEST } },
+                        { { "databaseId", 13 }, { "name", "azahar-linux.AppImage.zsync" }, { "downloadUrl", "https://example/l.AppImage.zsync" }, { "digest", nullptr } }
+                    }) } } }
+                } } } },
+                { "r1", nullptr },
+                { "r2", { { "latestRelease", {
+                    { "tagName", "v0.1-9000" },
+                    { "releaseAssets", { { "nodes", json::array({
+                        { { "databaseId", 21 }, { "name", "DuckStation-x64.AppImage" }, { "downloadUrl", "https://example/d.AppImage" }, { "digest", nullptr } }
+                    }) } } }
+                } } } }
+            } },
+            { "errors", json::array({ { { "message", "Could not resolve to a Repository with the name 'someone/deleted'." } } }) }
+        }.dump();
+
+        return response;
+    });
+
+    std::string query = lcl_build_graphql_query(targets);
+    std::string response;
+
+    LCL_CHECK(post(github.url("/graphql"), query, response) == 200);
+
+    // One aliased repository per target, asking for the digests too.
+    auto requests = github.requests();
+    LCL_CHECK(requests.size() == 1);
+
+    if (requests.size() == 1) {
+        std::string sent = json::parse(requests[0].body, nullptr, false).value("query", "");
+
+        LCL_CHECK(sent.find("r0: repository(owner: \"azahar-emu\", name: \"azahar\")") != std::string::npos);
+        LCL_CHECK(sent.find("r1: repository(owner: \"someone\", name: \"deleted\")") != std::string::npos);
+        LCL_CHECK(sent.find("r2: repository(owner: \"stenzek\", name: \"duckstation\")") != std::string::npos);
+        LCL_CHECK(sent.find("digest") != std::string::npos);
+    }
+
+    std::vector<std::pair<std::string, lcl_release_cache>> releases;
+    std::string error;
+
+    LCL_CHECK(lcl_parse_graphql_releases(response, targets, releases, error));
+    LCL_CHECK(error.find("someone/deleted") != std::string::npos);
+    LCL_CHECK(releases.size() == 2);
+
+    if (releases.size() == 2) {
+        const auto& [azahar_section, azahar] = releases[0];
+        const auto& [duckstation_section, duckstation] = releases[1];
+
+        LCL_CHECK(azahar_section == "azahar");
+        LCL_CHECK(azahar.tag == "2123.1");
+        LCL_CHECK(azahar.search_token == "linux");
+        LCL_CHECK(azahar.asset.id == 12);
+        LCL_CHECK(azahar.asset.name == "azahar-linux.AppImage");
+        LCL_CHECK(azahar.asset.download_url == "https://example/l.AppImage");
+        LCL_CHECK(azahar.asset.digest == DIGEST);
+        LCL_CHECK(azahar.asset.zsync_url == "https://example/l.AppImage.zsync");
+
+        // No digest published: left empty, the download is checked by size alone.
+        LCL_CHECK(duckstation_section == "duckstation");
+        LCL_CHECK(duckstation.asset.id == 21);
+        LCL_CHECK(duckstation.asset.digest.empty());
+        LCL_CHECK(duckstation.asset.zsync_url.empty());
+    }
+
+    // Saved whole, through a temp file that does not stay behind.
+    if (!releases.empty()) {
+        auto dir = lcl_test_dir("release_cache");
+        auto path = (dir / "3.ReleaseCache.json").string();
+        lcl_release_cache loaded;
+
+        lcl_test_write(path, "{\"tag_name\": \"old\"}");
+        LCL_CHECK(releases[0].second.save(path));
+        LCL_CHECK(loaded.load(path));
+        LCL_CHECK(loaded.tag == "2123.1");
+        LCL_CHECK(loaded.asset.digest == DIGEST);
+        LCL_CHECK(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 1);
+    }
+
+    // Nothing usable at all.
+    releases.clear();
+    error.clear();
+    LCL_CHECK(!lcl_parse_graphql_releases("{\"errors\":[{\"message\":\"Bad credentials\"}]}", targets, releases, error));
+    LCL_CHECK(error == "Bad credentials");
+    LCL_CHECK(!lcl_parse_graphql_releases("<html>", targets, releases, error));
+    LCL_CHECK(releases.empty());
+
+    curl_global_cleanup();
+
+    return lcl_test_failed ? 1 : 0;
+}
@@ -0,0 +1,277 @@
+#include "lcl_test.hpp"
+#include "lcl_squashfs.hpp"
+
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "libdeflate.h"
+
+static void put16(std::string& out, uint32_t value) {
+    out += static_cast<char>(value & 0xff);
+    out += static_cast<char>((value >> 8) & 0xff);
+}
+
+static void put32(std::string& out, uint32_t value) {
+    put16(out, value & 0xffff);
+    put16(out, value >> 16);
+}
+
+static void put64(std::string& out, uint64_t value) {
+    put32(out, static_cast<uint32_t>(value));
+    put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+// Small squashfs 4.0 image, gzip compressed the way mksquashfs writes it: every data block and the
+// single inode and directory metadata block are compressed unless that does not make them smaller.
+// Files have no fragments, inodes are written children first so every reference is known.
+class squashfs_image {
+public:
+    static constexpr uint32_t BLOCK_SIZE = 4096;
+
+    struct entry {
+        std::string name;
+        uint32_t inode;
+        uint16_t type;
+    };
+
+    squashfs_image() : _compressor(libdeflate_alloc_compressor(6)) {}
+    ~squashfs_image() { libdeflate_free_compressor(_compressor); }
+
+    entry file(const std::string& name, uint32_t mode, const std::string& content) {
+        std::string sizes;
+        uint32_t start = static_cast<uint32_t>(SUPERBLOCK_SIZE + _data.size());
+
+        for (size_t offset = 0; offset < content.size(); offset += BLOCK_SIZE) {
+            std::string block = content.substr(offset, BLOCK_SIZE);
+            std::string packed = compress(block);
+
+            if (packed.size() < block.size()) {
+                put32(sizes, static_cast<uint32_t>(packed.size()));
+                _data += packed;
+            } else {
+                put32(sizes, static_cast<uint32_t>(block.size()) | (1u << 24));
+                _data += block;
+            }
+        }
+
+        uint32_t inode = header(2, mode);
+
+        put32(_inodes, start);
+        put32(_inodes, 0xFFFFFFFF);
+        put32(_inodes, 0);
+        put32(_inodes, static_cast<uint32_t>(content.size()));
+        _inodes += sizes;
+
+        return { name, inode, 2 };
+    }
+
+    entry symlink(const std::string& name, const std::string& target) {
+        uint32_t inode = header(3, 0777);
+
+        put32(_inodes, 1);
+        put32(_inodes, static_cast<uint32_t>(target.size()));
+        _inodes += target;
+
+        return { name, inode, 3 };
+    }
+
+    entry directory(const std::string& name, uint32_t mode, const std::vector<entry>& entries) {
+        uint32_t listing = static_cast<uint32_t>(_directories.size());
+
+        put32(_directories, static_cast<uint32_t>(entries.size() - 1));
+        put32(_directories, 0);
+        put32(_directories, _count + 1);
+
+        for (const auto& item : entries) {
+            put16(_directories, item.inode);
+            put16(_directories, 0);
+            put16(_directories, item.type);
+            put16(_directories, static_cast<uint32_t>(item.name.size() - 1));
+            _directories += item.name;
+        }
+
+        uint32_t inode = header(1, mode);
+
+        put32(_inodes, 0);
+        put32(_inodes, 2);
+        put16(_inodes, static_cast<uint32_t>(_directories.size()) - listing + 3);
+        put16(_inodes, listing);
+        put32(_inodes, 0);
+
+        return { name, inode, 1 };
+    }
+
+    std::string finish(const entry& root) {
+        std::string image;
+        std::string inodes = metadata(_inodes);
+        std::string directories = metadata(_directories);
+        uint64_t inode_table = SUPERBLOCK_SIZE + _data.size();
+        uint64_t directory_table = inode_table + inodes.size();
+        uint64_t bytes_used = directory_table + directories.size();
+
+        put32(image, 0x73717368);
+        put32(image, _count);
+        put32(image, 0);
+        put32(image, BLOCK_SIZE);
+        put32(image, 0);
+        put16(image, 1);
+        put16(image, 12);
+        put16(image, 0);
+        put16(image, 1);
+        put16(image, 4);
+        put16(image, 0);
+        put64(image, root.inode);
+        put64(image, bytes_used);
+        put64(image, bytes_used);
+        put64(image, UINT64_MAX);
+        put64(image, inode_table);
+        put64(image, directory_table);
+        put64(image, UINT64_MAX);
+        put64(image, UINT64_MAX);
+
+        return image + _data + inodes + directories;
+    }
+
+private:
+    static constexpr size_t SUPERBLOCK_SIZE = 96;
+
+    uint32_t header(uint16_t type, uint32_t mode) {
+        uint32_t inode = static_cast<uint32_t>(_inodes.size());
+
+        put16(_inodes, type);
+        put16(_inodes, mode);
+        put16(_inodes, 0);
+        put16(_inodes, 0);
+        put32(_inodes, 0);
+        put32(_inodes, ++_count);
+
+        return inode;
+    }
+
+    std::string compress(const std::string& data) {
+        std::string packed(libdeflate_zlib_compress_bound(_compressor, data.size()), '\0');
+
+        packed.resize(libdeflate_zlib_compress(_compressor, data.data(), data.size(), packed.data(), packed.size()));
+
+        return packed;
+    }
+
+    std::string metadata(const std::string& data) {
+        std::string block;
+        std::string packed = compress(data);
+
+        if (packed.size() < data.size()) {
+            put16(block, static_cast<uint32_t>(packed.size()));
+            return block + packed;
+        }
+
+        put16(block, static_cast<uint32_t>(data.size()) | 0x8000);
+        return block + data;
+    }
+
+    libdeflate_compressor* _compressor;
+    std::string _data;
+    std::string _inodes;
+    std::string _directories;
+    uint32_t _count = 0;
+};
+
+// An AppImage: an ELF runtime whose section header table ends where the image starts.
+static std::string appimage(const std::string& image) {
+    std::string runtime("\x7f" "ELF\x02\x01\x01", 7);
+
+    runtime.resize(0x28, '\0');
+    put64(runtime, 64);
+    runtime.resize(0x3A, '\0');
+    put16(runtime, 64);
+    put16(runtime, 0);
+    runtime.resize(64, '\0');
+
+    return runtime + image;
+}
+
+static std::string library() {
+    std::string data;
+
+    // Compressible and more than two blocks, the last one partial.
+    for (int i = 0; data.size() < 2 * squashfs_image::BLOCK_SIZE + 1000; i++) {
+        data += "symbol_" + std::to_string(i * 7919 % 1000) + ";";
+    }
+
+    return data;
+}
+
+static std::filesystem::perms permissions(const std::filesystem::path& path) {
+    std::error_code ec;
+
+    return std::filesystem::symlink_status(path, ec).permissions() & std::filesystem::perms::mask;
+}
+
+int main() {
+    auto dir = lcl_test_dir("squashfs");
+    const std::string apprun = "#!/bin/sh\nexec \"$APPDIR/usr/bin/emu\" \"$@\"\n";
+    const std::string emu = std::string("\x7f" "ELF", 4) + std::string(100, '\x90');
+    const std::string lib = library();
+    std::error_code ec;
+
+    squashfs_image image;
+    auto bin = image.directory("bin", 0755, { image.file("emu", 0755, emu) });
+    auto libs = image.directory("lib", 0755, { image.file("libemu.so.1", 0644, lib), image.symlink("libemu.so", "libemu.so.1") });
+    auto usr = image.directory("usr", 0755, { bin, libs });
+    auto root = image.directory("", 0755, { image.file("AppRun", 0755, apprun), usr });
+    std::string squashfs = image.finish(root);
+
+    lcl_test_write(dir / "emu.squashfs", squashfs);
+    lcl_test_write(dir / "emu.AppImage", appimage(squashfs));
+
+    // A bare image and the same image behind an AppImage runtime unpack to the same tree.
+    for (const char* name : { "emu.squashfs", "emu.AppImage" }) {
+        auto target = dir / (std::string(name) + ".root");
+        lcl_squashfs_extractor extractor(dir / name, target);
+
+        std::filesystem::create_directories(target, ec);
+        LCL_CHECK(extractor.run());
+        LCL_CHECK(extractor.error().empty());
+
+        LCL_CHECK(lcl_test_read(target / "AppRun") == apprun);
+        LCL_CHECK(lcl_test_read(target / "usr/bin/emu") == emu);
+        LCL_CHECK(lcl_test_read(target / "usr/lib/libemu.so.1") == lib);
+        LCL_CHECK(std::filesystem::is_symlink(target / "usr/lib/libemu.so", ec));
+        LCL_CHECK(std::filesystem::read_symlink(target / "usr/lib/libemu.so", ec) == "libemu.so.1");
+        LCL_CHECK(lcl_test_read(target / "usr/lib/libemu.so") == lib);
+#ifndef _WIN32
+        LCL_CHECK(permissions(target / "AppRun") == static_cast<std::filesystem::perms>(0755));
+        LCL_CHECK(permissions(target / "usr/bin/emu") == static_cast<std::filesystem::perms>(0755));
+        LCL_CHECK(permissions(target / "usr/lib/libemu.so.1") == static_cast<std::filesystem::perms>(0644));
+#endif
+    }
+
+    // Names are single components, one that climbs out of target fails the whole image.
+    {
+        squashfs_image unsafe;
+        auto escape = unsafe.file("..", 0644, "outside");
+        std::string bad = unsafe.finish(unsafe.directory("", 0755, { escape }));
+        auto target = dir / "unsafe.root";
+        lcl_squashfs_extractor extractor(dir / "unsafe.squashfs", target);
+
+        lcl_test_write(dir / "unsafe.squashfs", bad);
+        std::filesystem::create_directories(target, ec);
+        LCL_CHECK(!extractor.run());
+        LCL_CHECK(!extractor.error().empty());
+        LCL_CHECK(std::filesystem::is_empty(target, ec));
+    }
+
+    // Anything that is not a squashfs image is refused.
+    {
+        lcl_test_write(dir / "plain.bin", std::string(4096, 'x'));
+
+        lcl_squashfs_extractor extractor(dir / "plain.bin", dir / "plain.root");
+
+        LCL_CHECK(!extractor.run());
+    }
+
+    return lcl_test_failed ? 1 : 0;
+}
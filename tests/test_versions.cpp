@@ -0,0 +1,110 @@
+#include "lcl_test.hpp"
+#include "lcl_lock.hpp"
+#include "lcl_versions.hpp"
+
+#include <chrono>
+#include <string>
+#include <system_error>
+
+// Installs version id with emu holding content, the way lcl_begin_version() and
+// lcl_commit_version() do: seeded from the live version, the changed file replaced, not rewritten.
+static bool install(lcl_version_store& versions, const std::string& id, const std::string& content) {
+    std::filesystem::path work;
+    std::string error;
+    std::error_code ec;
+
+    if (!versions.begin(work, {}, error)) {
+        return false;
+    }
+
+    std::filesystem::remove(work / "emu", ec);
+    lcl_test_write(work / "emu", content);
+
+    return versions.commit(work, id, error);
+}
+
+// What a launch would run.
+static std::string launched(const std::filesystem::path& root) {
+#ifdef _WIN32
+    std::string id = lcl_test_read(root / "current.txt");
+
+    id.erase(id.find_last_not_of("\r\n") + 1);
+    return lcl_test_read(root / "versions" / id / "emu");
+#else
+    return lcl_test_read(root / "current" / "emu");
+#endif
+}
+
+int main() {
+    auto root = lcl_test_dir("versions");
+    lcl_version_store versions(root);
+    std::string error;
+    std::error_code ec;
+
+    LCL_CHECK(versions.live().empty());
+
+    // First install goes live.
+    LCL_CHECK(install(versions, "100", "one"));
+    LCL_CHECK(versions.live() == "100");
+    LCL_CHECK(launched(root) == "one");
+
+    // The update goes live in one swap and leaves the previous tree as it was.
+    LCL_CHECK(install(versions, "200", "two"));
+    LCL_CHECK(versions.live() == "200");
+    LCL_CHECK(launched(root) == "two");
+    LCL_CHECK(lcl_test_read(versions.path("100") / "emu") == "one");
+#ifndef _WIN32
+    LCL_CHECK(std::filesystem::read_symlink(root / "current", ec) == std::filesystem::path("versions") / "200");
+    LCL_CHECK(!std::filesystem::exists(std::filesystem::symlink_status(root / ".current", ec)));
+#endif
+
+    // Switching back needs no install.
+    LCL_CHECK(versions.activate("100", error));
+    LCL_CHECK(versions.live() == "100");
+    LCL_CHECK(launched(root) == "one");
+    LCL_CHECK(versions.activate("200", error));
+
+    // KEEP_VERSIONS=1 keeps the live version alone.
+    versions.prune(1, "");
+    LCL_CHECK(!versions.installed("100"));
+    LCL_CHECK(versions.installed("200"));
+    LCL_CHECK(launched(root) == "two");
+
+    // A pinned version survives pruning, older unpinned ones go first.
+    LCL_CHECK(install(versions, "300", "three"));
+    LCL_CHECK(install(versions, "400", "four"));
+    versions.prune(1, "200");
+    LCL_CHECK(versions.installed("200"));
+    LCL_CHECK(!versions.installed("300"));
+    LCL_CHECK(versions.installed("400"));
+    LCL_CHECK(versions.live() == "400");
+    LCL_CHECK(launched(root) == "four");
+
+    // KEEP_VERSIONS=2 keeps the most recently live one next to it.
+    LCL_CHECK(install(versions, "500", "five"));
+    LCL_CHECK(versions.activate("400", error) && versions.activate("500", error));
+    versions.prune(2, "");
+    LCL_CHECK(versions.installed("400"));
+    LCL_CHECK(versions.installed("500"));
+    LCL_CHECK(!versions.installed("200"));
+    LCL_CHECK(launched(root) == "five");
+
+    // Leftovers of an interrupted install are cleared by the next one.
+    std::filesystem::create_directories(root / "versions" / ".install" / "stale", ec);
+    LCL_CHECK(install(versions, "600", "six"));
+    LCL_CHECK(!std::filesystem::exists(versions.path("600") / "stale", ec));
+    LCL_CHECK(launched(root) == "six");
+
+    // The update lock is held by one owner at a time.
+    {
+        lcl_file_lock first;
+        lcl_file_lock second;
+
+        LCL_CHECK(first.acquire(root / ".update.lock", std::chrono::milliseconds(0)));
+        LCL_CHECK(!second.acquire(root / ".update.lock", std::chrono::milliseconds(0)));
+        first.release();
+        LCL_CHECK(second.acquire(root / ".update.lock", std::chrono::milliseconds(0)));
+    }
+
+    return lcl_test_failed ? 1 : 0;
+}
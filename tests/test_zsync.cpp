@@ -0,0 +1,101 @@
+#include "lcl_test.hpp"
+#include "lcl_test_server.hpp"
+#include "lcl_sha256.hpp"
+#include "lcl_zsync.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <system_error>
+
+#include "curl/curl.h"
+
+// Incompressible content, the same on every run.
+static std::string generate(size_t size, uint32_t seed) {
+    std::string data(size, '\0');
+
+    for (auto& c : data) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        c = static_cast<char>(seed);
+    }
+
+    return data;
+}
+
+int main() {
+    auto dir = lcl_test_dir("zsync");
+    std::string installed = generate(1 << 20, 1);
+    std::string updated = installed;
+    std::string control;
+    std::string digest;
+    std::atomic<unsigned long long> served{ 0 };
+    std::error_code ec;
+
+    // A new release: some bytes inserted near the start, a stretch changed further on.
+    updated.insert(300000, generate(1000, 2));
+    updated.replace(700000, 5000, generate(5000, 3));
+
+    lcl_test_write(dir / "installed.AppImage", installed);
+    lcl_test_write(dir / "new.AppImage", updated);
+    LCL_CHECK(lcl_zsync_make_control(dir / "new.AppImage", "emu.AppImage", control));
+    LCL_CHECK(lcl_sha256::file((dir / "new.AppImage").string(), digest));
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    {
+        lcl_test_server host([&](const lcl_test_request& request) {
+            lcl_test_response response;
+            unsigned long long first = 0;
+            unsigned long long last = 0;
+
+            if (request.path == "/emu.AppImage.zsync") {
+                response.body = control;
+            } else if (request.path != "/emu.AppImage") {
+                response.status = 404;
+            } else if (std::sscanf(request.headers.count("range") ? request.headers.at("range").c_str() : "", "bytes=%llu-%llu", &first, &last) == 2 &&
+                first <= last && last < updated.size()) {
+                response.status = 206;
+                response.headers = { { "Content-Range", "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(updated.size()) } };
+                response.body = updated.substr(first, last - first + 1);
+            } else {
+                response.body = updated;
+            }
+
+            served += response.body.size();
+            return response;
+        });
+
+        std::atomic<bool> cancel{ false };
+        lcl_download_options options;
+        CURLcode res = CURLE_OK;
+        CURL* curl = curl_easy_init();
+        auto target = dir / "emu.AppImage";
+
+        // Rebuilt from the installed copy, only the changed blocks come over the network.
+        lcl_zsync_client client(host.url("/emu.AppImage.zsync"), host.url("/emu.AppImage"), dir / "installed.AppImage", target, options, cancel);
+
+        client.expect_sha256("sha256:" + digest);
+        LCL_CHECK(client.run(curl, res));
+        LCL_CHECK(lcl_test_read(target) == updated);
+        LCL_CHECK(lcl_test_read(dir / "installed.AppImage") == installed);
+        LCL_CHECK(served.load() - control.size() < updated.size() / 10);
+
+        // A published digest that does not match leaves target alone.
+        lcl_test_write(target, "previous");
+
+        lcl_zsync_client mismatch(host.url("/emu.AppImage.zsync"), host.url("/emu.AppImage"), dir / "installed.AppImage", target, options, cancel);
+
+        mismatch.expect_sha256("sha256:" + std::string(64, '0'));
+        LCL_CHECK(!mismatch.run(curl, res));
+        LCL_CHECK(lcl_test_read(target) == "previous");
+
+        curl_easy_cleanup(curl);
+    }
+
+    curl_global_cleanup();
+
+    return lcl_test_failed ? 1 : 0;
+}
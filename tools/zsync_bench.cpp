@@ -0,0 +1,131 @@
+// Measures what a zsync update of a single file asset transfers compared to a full download.
+//
+//   zsync_bench <installed file> <new file>
+//
+// The control file is made for the new file the way zsyncmake does, both are served by a local
+// HTTP server that honours ranges, and lcl_zsync_client rebuilds the new file from a copy of the
+// installed one. Every byte the server sends is counted, the result is compared with the new file.
+//
+// The numbers in the zsync commit came from two zstd squashfs images (AppImage payloads) of the
+// same 65 MB tree, the second with about 2% of its files changed and one file added near the
+// start, e.g. made with "mksquashfs <tree> v1.AppImage -comp zstd -noappend".
+
+#include "lcl_net.hpp"
+#include "lcl_test_server.hpp"
+#include "lcl_zsync.hpp"
+#include "libretro.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+static void bench_log(enum retro_log_level level, const char* fmt, ...) {
+    va_list args;
+
+    // The per request timings would drown the summary.
+    if (level < RETRO_LOG_INFO || std::strncmp(fmt, "[LAUNCHER-STATS]", 16) == 0) {
+        return;
+    }
+
+    va_start(args, fmt);
+    std::vprintf(fmt, args);
+    va_end(args);
+}
+
+retro_log_printf_t log_cb = bench_log;
+
+static std::string read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s <installed file> <new file>\n", argv[0]);
+        return 2;
+    }
+
+    std::filesystem::path installed = argv[1];
+    std::filesystem::path updated = argv[2];
+    std::string name = updated.filename().string();
+    std::string content = read_file(updated);
+    std::string control;
+    std::atomic<unsigned long long> served_control{ 0 };
+    std::atomic<unsigned long long> served_ranges{ 0 };
+    std::atomic<unsigned> requests{ 0 };
+    std::error_code ec;
+
+    if (content.empty() || !std::filesystem::is_regular_file(installed, ec) || !lcl_zsync_make_control(updated, name, control)) {
+        std::fprintf(stderr, "could not read %s or %s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    lcl_test_server server([&](const lcl_test_request& request) {
+        lcl_test_response response;
+        unsigned long long first = 0;
+        unsigned long long last = 0;
+
+        if (request.path == "/" + name + ".zsync") {
+            response.body = control;
+            served_control += control.size();
+        } else if (request.path != "/" + name) {
+            response.status = 404;
+        } else if (std::sscanf(request.headers.count("range") ? request.headers.at("range").c_str() : "", "bytes=%llu-%llu", &first, &last) == 2 &&
+            first <= last && last < content.size()) {
+            response.status = 206;
+            response.headers = { { "Content-Range", "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(content.size()) } };
+            response.body = content.substr(first, last - first + 1);
+            served_ranges += response.body.size();
+            requests++;
+        } else {
+            response.body = content;
+            served_ranges += content.size();
+        }
+
+        return response;
+    });
+
+    auto work = std::filesystem::temp_directory_path() / "lcl_zsync_bench";
+    auto seed = work / "installed";
+    auto target = work / name;
+    std::atomic<bool> cancel{ false };
+    lcl_download_options options;
+    CURLcode res = CURLE_OK;
+
+    std::filesystem::remove_all(work, ec);
+    std::filesystem::create_directories(work, ec);
+    std::filesystem::copy_file(installed, seed, ec);
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    CURL* curl = curl_easy_init();
+    lcl_zsync_client client(server.url("/" + name + ".zsync"), server.url("/" + name), seed, target, options, cancel);
+    auto started = std::chrono::steady_clock::now();
+    bool ok = client.run(curl, res);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    curl_easy_cleanup(curl);
+    curl_global_cleanup();
+
+    bool identical = ok && read_file(target) == content;
+    unsigned long long transferred = served_control + served_ranges;
+
+    std::printf("new file:           %zu bytes\n", content.size());
+    std::printf("control file:       %llu bytes\n", served_control.load());
+    std::printf("ranges:             %llu bytes in %u requests\n", served_ranges.load(), requests.load());
+    std::printf("transferred:        %llu bytes, %.1f%% of a full download\n", transferred, 100.0 * transferred / content.size());
+    std::printf("time:               %.2f s\n", seconds);
+    std::printf("result:             %s\n", !ok ? client.error().c_str() : identical ? "identical to the new file" : "DIFFERS from the new file");
+
+    std::filesystem::remove_all(work, ec);
+
+    return identical ? 0 : 1;
+}